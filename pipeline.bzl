@@ -60,14 +60,163 @@ du -hs $@
 # parse the info
 gdalinfo -json -mm $< > $@
 
-# assert there is only one band
-# first print helpful messages because the failure message is not helpful
-echo "checking that number of bands is 1..."
-jq ".bands | length" $@
-test `jq ".bands | length" $@` -eq 1
+# assert there is only one band, which reading the JSON checks
+$(location //src/meshtools:height_range) $@
 """,
+        tools = [
+            "//src/meshtools:height_range",
+        ],
+    )
+
+    # mesh it, either in one piece or, for rasters too large for one hmm
+    # process, as overlapping tiles that are stitched back together.
+    # triangulate_args, e.g. "--triangles=2000000 --max_error=0.000001", use
+    # the in-tree float triangulator instead of a 16-bit PNG and hmm.
+    unscaled_stl_name = "{name}_unscaled_stl".format(**topo)
+    if "tiles" in topo:
+        if "triangulate_args" in topo:
+            fail("tiles are only supported with hmm_args for {name}".format(**topo))
+        for arg in topo["hmm_args"].split(" "):
+            if arg in ["-b", "--base", "--blur"] or arg.startswith("--base=") or arg.startswith("--blur="):
+                fail("{arg} is not supported with tiles for {name}".format(arg = arg, **topo))
+        _mesh_tiles(topo, resized_name, gdalinfo_name, unscaled_stl_name)
+    elif "triangulate_args" in topo:
+        _mesh_float(topo, resized_name, gdalinfo_name, unscaled_stl_name)
+    else:
+        _mesh_whole(topo, resized_name, gdalinfo_name, unscaled_stl_name)
+
+    # scale to the output coordinates
+    if topo["output_scaling"] not in ["llh2ecef", "llh2gnomonic", "ned", "polar_stereographic", "transverse_mercator"]:
+        fail("Unknown output_scaling: {output_scaling} for {name}".format(**topo))
+
+    # projection center for llh2ecef, polar_stereographic and transverse_mercator, default raster center
+    center_lat_long_deg = None
+    if "llh2ecef_center_lat_long_deg" in topo:
+        center_lat_long_deg = topo["llh2ecef_center_lat_long_deg"]
+    if "center_lat_long_deg" in topo:
+        center_lat_long_deg = topo["center_lat_long_deg"]
+    convert_terrain(topo["name"], gdalinfo_name, unscaled_stl_name, topo["output_scaling"], topo["target_size"], topo["z_exag"], center_lat_long_deg)
+
+    # optionally decimate in output units, e.g. decimate_args = "--max_error=0.01"
+    if "decimate_args" in topo:
+        native.genrule(
+            name = "{name}_decimated_stl".format(**topo),
+            srcs = ["{name}.stl".format(**topo)],
+            outs = [
+                "{name}_decimated.stl".format(**topo),
+                "{name}_decimated_stats.json".format(**topo),
+            ],
+            cmd = """\
+$(location //src/meshtools:decimate_stl) $(location {name}.stl) $(location {name}_decimated.stl) {decimate_args} \
+    --stats=$(location {name}_decimated_stats.json)
+
+# print file size
+du -hs $(location {name}_decimated.stl)
+""".format(**topo),
+            tools = [
+                "//src/meshtools:decimate_stl",
+            ],
+        )
+
+    # the steps below work on the decimated surface if there is one
+    surface_name = "{name}_decimated".format(**topo) if "decimate_args" in topo else topo["name"]
+
+    # optionally close the (decimated) surface into a printable solid, e.g.
+    # solid_base_thickness = 5 for a base 5 output units below the lowest point
+    if "solid_base_thickness" in topo:
+        native.genrule(
+            name = "{name}_solid_stl".format(**topo),
+            srcs = ["{}.stl".format(surface_name)],
+            outs = [
+                "{name}_solid.stl".format(**topo),
+                "{name}_solid_stats.json".format(**topo),
+            ],
+            cmd = """\
+$(location //src/meshtools:solidify_stl) $(location {surface}.stl) $(location {name}_solid.stl) {solid_base_thickness} \
+    --stats=$(location {name}_solid_stats.json)
+
+# print file size
+du -hs $(location {name}_solid.stl)
+""".format(surface = surface_name, **topo),
+            tools = [
+                "//src/meshtools:solidify_stl",
+            ],
+        )
+
+    # optionally slice the (decimated) surface into contours in output units, so
+    # they line up with the printed geometry, e.g. contour_args = "--interval=0.5"
+    # for a line every 0.5 output units, or "--levels=1,2.5,4"
+    if "contour_args" in topo:
+        native.genrule(
+            name = "{name}_mesh_contour".format(**topo),
+            srcs = ["{}.stl".format(surface_name)],
+            outs = [
+                "{name}_mesh_contour.dxf".format(**topo),
+                "{name}_mesh_contour.svg".format(**topo),
+                "{name}_mesh_contour_stats.json".format(**topo),
+            ],
+            cmd = """\
+$(location //src/meshtools:contour_mesh) $(location {surface}.stl) \
+    $(location {name}_mesh_contour.dxf) $(location {name}_mesh_contour.svg) {contour_args} \
+    --stats=$(location {name}_mesh_contour_stats.json)
+""".format(surface = surface_name, **topo),
+            tools = [
+                "//src/meshtools:contour_mesh",
+            ],
+        )
+
+    # optionally make a contour of the raster, in its own units; contour_args
+    # above gives contours in output units
+    if "contour_level" in topo:
+        # TODO(greg): translate this when the STL X-Y are rescaled
+        native.genrule(
+            name = "{name}_contour".format(**topo),
+            srcs = [
+                # region_of_interest_name, # use the full DEM
+                resized_name,  # use the resized DEM
+            ],
+            outs = [
+                #'{name}_contour.shp'.format(name),
+                #'{name}_contour.shx'.format(name),
+                #'{name}_contour.dbf'.format(name),
+                #'{name}_contour.prj'.format(name),
+                "{name}_contour.dxf".format(**topo),
+            ],
+            #cmd = "gdal_contour -fl 0 $< $(location :contour.shp)",
+            cmd = "gdal_contour -fl {contour_level} $< $@".format(**topo),
+        )
+
+    native.sh_test(
+        name = "{name}_validate".format(**topo),
+        srcs = ["validate_mesh.sh"],
+        data = [
+            unscaled_stl_name,
+            "//src/meshtools:validate_mesh",
+        ],
+        args = [
+            "$(location //src/meshtools:validate_mesh)",
+            "$(location {stl_name})".format(stl_name = unscaled_stl_name),
+        ],
     )
 
+    # the solid must also be closed
+    if "solid_base_thickness" in topo:
+        native.sh_test(
+            name = "{name}_solid_validate".format(**topo),
+            srcs = ["validate_mesh.sh"],
+            data = [
+                "{name}_solid.stl".format(**topo),
+                "//src/meshtools:validate_mesh",
+            ],
+            args = [
+                "$(location //src/meshtools:validate_mesh)",
+                "$(location {name}_solid.stl)".format(**topo),
+                "--closed",
+            ],
+        )
+
+def _mesh_whole(topo, resized_name, gdalinfo_name, unscaled_stl_name):
+    """convert the whole raster to one PNG and triangulate it with hmm"""
     # convert to PNG
     png_name = "{name}_png".format(**topo)
     native.genrule(
@@ -80,15 +229,16 @@ test `jq ".bands | length" $@` -eq 1
         # use gdalinfo to scale to proper min/max
         cmd = """\
 gdal_translate -of PNG -ot UInt16 -scale \
-  `jq ".bands[0].computedMin" $(location {gdalinfo})` \
-  `jq ".bands[0].computedMax" $(location {gdalinfo})` \
+  `$(location //src/meshtools:height_range) $(location {gdalinfo})` \
   0 65535 $(location {resized_name}) $@
 du -hs $@
 """.format(gdalinfo = gdalinfo_name, resized_name = resized_name),
+        tools = [
+            "//src/meshtools:height_range",
+        ],
     )
 
     # mesh it
-    unscaled_stl_name = "{name}_unscaled_stl".format(**topo)
     native.genrule(
         name = unscaled_stl_name,
         srcs = [
@@ -101,194 +251,137 @@ du -hs $@
 $(location @hmm//:hmm) $(location {png}) $@ --zscale 1.0 {hmm_args}
 echo "--------------------------------------"
 
-# print dimensions
-$(location //src/meshtools:print_stl_dimensions) $@
-
-echo "--------------------------------------"
 # print file size
 du -hs $@
-""".format(png = png_name, gdalinfo = gdalinfo_name, **topo),
+""".format(png = png_name, **topo),
         tools = [
             "@hmm",
-            "//src/meshtools:print_stl_dimensions",
         ],
     )
 
-    # convert to ECEF
-    if topo["output_scaling"] == "llh2ecef":
-        center_lat_long_deg = None
-        if "llh2ecef_center_lat_long_deg" in topo:
-            center_lat_long_deg = topo["llh2ecef_center_lat_long_deg"]
-        convert_to_ecef(topo["name"], gdalinfo_name, unscaled_stl_name, topo["target_size"], topo["z_exag"], center_lat_long_deg)
-    elif topo["output_scaling"] == "llh2gnomonic":
-        convert_to_gnomonic(topo["name"], gdalinfo_name, unscaled_stl_name, topo["target_size"], topo["z_exag"])
-    elif topo["output_scaling"] == "ned":
-        scale_simple(topo["name"], gdalinfo_name, unscaled_stl_name, topo["target_size"], topo["z_exag"])
-    else:
-        fail("Unknown output_scaling: {output_scaling} for {name}".format(**topo))
+def _mesh_float(topo, resized_name, gdalinfo_name, unscaled_stl_name):
+    """triangulate the float heights of the raster directly, without quantizing them"""
 
-    # optionally make a contour
-    if "contour_level" in topo:
-        # TODO(greg): translate this when the STL X-Y are rescaled
-        native.genrule(
-            name = "{name}_contour".format(**topo),
-            srcs = [
-                # region_of_interest_name, # use the full DEM
-                resized_name,  # use the resized DEM
-            ],
-            outs = [
-                #'{name}_contour.shp'.format(name),
-                #'{name}_contour.shx'.format(name),
-                #'{name}_contour.dbf'.format(name),
-                #'{name}_contour.prj'.format(name),
-                "{name}_contour.dxf".format(**topo),
-            ],
-            #cmd = "gdal_contour -fl 0 $< $(location :contour.shp)",
-            cmd = "gdal_contour -fl {contour_level} $< $@".format(**topo),
-        )
-
-    native.sh_test(
-        name = "{name}_stl_roundtrip".format(**topo),
-        srcs = ["roundtrip_stl.sh"],
-        data = [
-            unscaled_stl_name,
-            "//src/meshtools:roundtrip_stl",
-        ],
-        args = [
-            "$(location //src/meshtools:roundtrip_stl)",
-            "$(location {stl_name})".format(stl_name = unscaled_stl_name),
-        ],
+    # ENVI is raw native-endian pixels plus a .hdr sidecar, which is not needed
+    float_name = "{name}_float32".format(**topo)
+    native.genrule(
+        name = float_name,
+        srcs = [resized_name],
+        outs = [float_name + ".f32"],
+        cmd = "gdal_translate -of ENVI -ot Float32 $< $@",
     )
 
-def convert_to_ecef(name, gdalinfo_name, unscaled_stl_name, target_size, z_exag, center_lat_long_deg):
-    ecef_stl_name = "{}_stl".format(name)
-    maybe_center_lat_long_deg = ""
-    if center_lat_long_deg != None:
-        maybe_center_lat_long_deg = str(center_lat_long_deg[0]) + " " + str(center_lat_long_deg[1])
     native.genrule(
-        name = ecef_stl_name,
-        srcs = [unscaled_stl_name, gdalinfo_name],
-        outs = ["{}.stl".format(name)],
+        name = unscaled_stl_name,
+        srcs = [
+            float_name,
+            gdalinfo_name,
+        ],
+        outs = ["{name}_unscaled.stl".format(**topo)],
         cmd = """\
-# we expect the geoTransform to be something like:
-#   [
-#     -128.000416666665,
-#     0.00083333333,
-#     0,
-#     37.000416662664996,
-#     0,
-#     -0.00083333333
-#   ]
-# Make sure those numbers are 0
-test `jq ".geoTransform[2]" $(location {gdalinfo})` -eq 0
-test `jq ".geoTransform[4]" $(location {gdalinfo})` -eq 0
-
-$(location //src/meshtools:llh2ecef) $(location {input_stl}) $@ \
-    `jq ".geoTransform[0]" $(location {gdalinfo})` \
-    `jq ".geoTransform[1]" $(location {gdalinfo})` \
-    `jq ".geoTransform[3]" $(location {gdalinfo})` \
-    `jq ".geoTransform[5]" $(location {gdalinfo})` \
-    `jq ".size[0]" $(location {gdalinfo})` \
-    `jq ".size[1]" $(location {gdalinfo})` \
-    `jq ".bands[0].computedMin" $(location {gdalinfo})` \
-    `jq ".bands[0].computedMax" $(location {gdalinfo})` \
-    {target_size} {z_exag} {maybe_center_lat_long_deg}
-
-# print new dimensions
-$(location //src/meshtools:print_stl_dimensions) $@
-""".format(gdalinfo = gdalinfo_name, input_stl = unscaled_stl_name, target_size = target_size, z_exag = z_exag, maybe_center_lat_long_deg = maybe_center_lat_long_deg),
+$(location //src/meshtools:triangulate_dem) $(location {raster}) $(location {gdalinfo}) $@ {triangulate_args}
+
+# print file size
+du -hs $@
+""".format(raster = float_name, gdalinfo = gdalinfo_name, **topo),
         tools = [
-            "//src/meshtools:llh2ecef",
-            "//src/meshtools:print_stl_dimensions",
+            "//src/meshtools:triangulate_dem",
         ],
     )
 
-def convert_to_gnomonic(name, gdalinfo_name, unscaled_stl_name, target_size, z_exag):
-    gnomonic_stl_name = "{}_stl".format(name)
+def _mesh_tiles(topo, resized_name, gdalinfo_name, unscaled_stl_name):
+    """triangulate tiles = [tiles_x, tiles_y] overlapping tiles separately and stitch them
+
+    Every tile is scaled to PNG with the global min/max so heights agree across
+    seams, and the tiles are meshed by independent genrules. hmm_args apply to
+    each tile, so --triangles is a per-tile budget. --base and --blur are not
+    supported: every tile would get its own walls, and blurring each tile on
+    its own changes the heights along the seams.
+    """
+    tiles_x = topo["tiles"][0]
+    tiles_y = topo["tiles"][1]
+    tile_stl_names = []
+    for j in range(tiles_y):
+        for i in range(tiles_x):
+            tile_name = "{name}_tile_{i}_{j}".format(i = i, j = j, **topo)
+            native.genrule(
+                name = tile_name + "_png",
+                srcs = [
+                    resized_name,
+                    gdalinfo_name,
+                ],
+                outs = [tile_name + ".png"],
+                cmd = """\
+gdal_translate -of PNG -ot UInt16 -scale \
+  `$(location //src/meshtools:height_range) $(location {gdalinfo})` \
+  0 65535 \
+  -srcwin `$(location //src/meshtools:tile_window) $(location {gdalinfo}) {tiles_x} {tiles_y} {i} {j}` \
+  $(location {resized_name}) $@
+""".format(gdalinfo = gdalinfo_name, resized_name = resized_name, tiles_x = tiles_x, tiles_y = tiles_y, i = i, j = j),
+                tools = [
+                    "//src/meshtools:height_range",
+                    "//src/meshtools:tile_window",
+                ],
+            )
+            native.genrule(
+                name = tile_name + "_stl",
+                srcs = [tile_name + "_png"],
+                outs = [tile_name + ".stl"],
+                cmd = "$(location @hmm//:hmm) $< $@ --zscale 1.0 {hmm_args}".format(**topo),
+                tools = [
+                    "@hmm",
+                ],
+            )
+            tile_stl_names.append(tile_name + "_stl")
+
     native.genrule(
-        name = gnomonic_stl_name,
-        srcs = [unscaled_stl_name, gdalinfo_name],
-        outs = ["{}.stl".format(name)],
+        name = unscaled_stl_name,
+        srcs = [gdalinfo_name] + tile_stl_names,
+        outs = ["{name}_unscaled.stl".format(**topo)],
         cmd = """\
-# we expect the geoTransform to be something like:
-#   [
-#     -128.000416666665,
-#     0.00083333333,
-#     0,
-#     37.000416662664996,
-#     0,
-#     -0.00083333333
-#   ]
-# Make sure those numbers are 0
-test `jq ".geoTransform[2]" $(location {gdalinfo})` -eq 0
-test `jq ".geoTransform[4]" $(location {gdalinfo})` -eq 0
-
-$(location //src/meshtools:llh2gnomonic) $(location {input_stl}) $@ \
-    `jq ".geoTransform[0]" $(location {gdalinfo})` \
-    `jq ".geoTransform[1]" $(location {gdalinfo})` \
-    `jq ".geoTransform[3]" $(location {gdalinfo})` \
-    `jq ".geoTransform[5]" $(location {gdalinfo})` \
-    `jq ".size[0]" $(location {gdalinfo})` \
-    `jq ".size[1]" $(location {gdalinfo})` \
-    `jq ".bands[0].computedMin" $(location {gdalinfo})` \
-    `jq ".bands[0].computedMax" $(location {gdalinfo})` \
-    {target_size} \
-    {z_exag}
-
-# print new dimensions
-$(location //src/meshtools:print_stl_dimensions) $@
-""".format(gdalinfo = gdalinfo_name, input_stl = unscaled_stl_name, target_size = target_size, z_exag = z_exag),
+$(location //src/meshtools:stitch_tiles) $(location {gdalinfo}) {tiles_x} {tiles_y} $@ {tiles}
+
+# print file size
+du -hs $@
+""".format(
+            gdalinfo = gdalinfo_name,
+            tiles_x = tiles_x,
+            tiles_y = tiles_y,
+            tiles = " ".join(["$(location {})".format(tile) for tile in tile_stl_names]),
+        ),
         tools = [
-            "//src/meshtools:llh2gnomonic",
-            "//src/meshtools:print_stl_dimensions",
+            "//src/meshtools:stitch_tiles",
         ],
     )
 
-def scale_simple(name, gdalinfo_name, unscaled_stl_name, target_size, z_exag):
+def convert_terrain(name, gdalinfo_name, unscaled_stl_name, output_scaling, target_size, z_exag, center_lat_long_deg):
+    """scale the unscaled mesh to output_scaling in one process, reading the gdalinfo JSON directly
+
+    Also writes {name}_stats.json, the per-stage timing and memory report.
+    """
     stl_name = "{}_stl".format(name)
+    maybe_center_lat_long_deg = ""
+    if center_lat_long_deg != None:
+        maybe_center_lat_long_deg = str(center_lat_long_deg[0]) + " " + str(center_lat_long_deg[1])
     native.genrule(
         name = stl_name,
-        srcs = [
-            unscaled_stl_name,
-            gdalinfo_name,
+        srcs = [unscaled_stl_name, gdalinfo_name],
+        outs = [
+            "{}.stl".format(name),
+            "{}_stats.json".format(name),
         ],
-        outs = ["{}.stl".format(name)],
         cmd = """\
-# we expect the geoTransform to be something like:
-#   [
-#     538298.4796000001952052,
-#     2.0,
-#     0.0,
-#     4194645.001800000667572,
-#     0.0,
-#     -2.0
-#   ],
-
-# Make sure those numbers are 0
-test `jq ".geoTransform[2]" $(location {gdalinfo})` -eq 0
-test `jq ".geoTransform[4]" $(location {gdalinfo})` -eq 0
-
-
-# scale mesh
-$(location //src/meshtools:size_stl) \
-    $(location {unscaled_stl}) \
-    $@ \
-    `jq ".geoTransform[1]" $(location {gdalinfo})` \
-    `jq ".geoTransform[5]" $(location {gdalinfo})` \
-    `jq ".bands[0].computedMin" $(location {gdalinfo})` \
-    `jq ".bands[0].computedMax" $(location {gdalinfo})` \
-    {target_size} \
-    {z_exag}
-
-
-# print new dimensions
-$(location //src/meshtools:print_stl_dimensions) $@
+$(location //src/meshtools:terrain_pipeline) \
+    $(location {input_stl}) \
+    $(location {gdalinfo}) \
+    $(location {name}.stl) \
+    {output_scaling} {target_size} {z_exag} {maybe_center_lat_long_deg} \
+    --stats=$(location {name}_stats.json)
 
 # print file size
-du -hs $@
-""".format(gdalinfo = gdalinfo_name, unscaled_stl = unscaled_stl_name, target_size = target_size, z_exag = z_exag),
+du -hs $(location {name}.stl)
+""".format(name = name, gdalinfo = gdalinfo_name, input_stl = unscaled_stl_name, output_scaling = output_scaling, target_size = target_size, z_exag = z_exag, maybe_center_lat_long_deg = maybe_center_lat_long_deg),
         tools = [
-            "//src/meshtools:size_stl",
-            "//src/meshtools:print_stl_dimensions",
+            "//src/meshtools:terrain_pipeline",
         ],
     )
@@ -0,0 +1,493 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <glm/glm.hpp>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "src/meshtools/geodetic.hpp"
+#include "src/meshtools/hash.hpp"
+#include "src/meshtools/mapped_file.hpp"
+#include "src/meshtools/mesh_format.hpp"
+#include "src/meshtools/mesh_stats.hpp"
+#include "src/meshtools/normals.hpp"
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/ply.hpp"
+#include "src/meshtools/reorder.hpp"
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/stl.hpp"
+#include "src/meshtools/terrain.hpp"
+#include "src/meshtools/threemf.hpp"
+#include "src/meshtools/topology.hpp"
+#include "src/meshtools/weld.hpp"
+
+// Benchmark the meshtools stages on deterministic synthetic terrain meshes and
+// write the results as JSON, so runs on different commits can be compared.
+//
+// Usage: ./bench [--sizes=1000000,10000000,50000000] [--shapes=grid,hmm]
+//                [--orders=input,reordered] [--repetitions=N] [--tmpdir=DIR]
+//                [--output=results.json]
+//
+// Every stage runs in its own forked process, so allocation counts and peak
+// RSS are per stage. Seconds is the fastest of the repetitions. The
+// "reordered" order runs the stages again after ReorderMesh, to show what
+// locality buys each stage, and write_3mf's file size is the deflated size.
+
+// Count heap allocations made through operator new.
+static std::atomic<uint64_t> g_allocations{0};
+static std::atomic<uint64_t> g_allocated_bytes{0};
+
+void *operator new(const size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  void *pointer = std::malloc(size == 0 ? 1 : size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+void *operator new[](const size_t size) { return operator new(size); }
+// Not inlined, so the compiler does not pair operator new with a bare free.
+__attribute__((noinline)) void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { operator delete(pointer); }
+void operator delete(void *pointer, size_t) noexcept { operator delete(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { operator delete(pointer); }
+
+// Read a "VmXXX:   1234 kB" line from /proc/self/status, in bytes.
+static uint64_t ReadProcStatus(const std::string &field) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind(field + ":", 0) == 0) {
+      return 1024 * std::stoull(line.substr(field.size() + 1));
+    }
+  }
+  return 0;
+}
+
+// Reset the peak RSS high water mark to the current RSS.
+static void ResetPeakRss() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+}
+
+static uint64_t FileSize(const std::string &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(st.st_size);
+}
+
+static uint64_t SplitMix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+static float UnitFloat(const uint64_t x) {
+  return static_cast<float>(SplitMix64(x) >> 40) * (1.0f / 16777216.0f);
+}
+
+// An unscaled hmm-style mesh: x and y are pixel coordinates, z is in [0, 1].
+struct SyntheticMesh {
+  std::string shape;
+  int32_t width = 0;
+  int32_t height = 0;
+  std::vector<glm::vec3> points;
+  std::vector<glm::ivec3> triangles;
+};
+
+// A triangulated heightmap of about `num_triangles` triangles.
+//
+// "grid" is every pixel, triangles in raster order. "hmm" mimics hmm output:
+// vertices still sit on the pixel grid but rows and columns are spaced
+// irregularly, diagonals flip at random and the triangles are shuffled, so
+// triangle sizes vary and neighbouring triangles are far apart in the file.
+static SyntheticMesh GenerateMesh(const std::string &shape, const uint64_t num_triangles) {
+  const bool hmm = shape == "hmm";
+  const uint64_t cells = static_cast<uint64_t>(std::ceil(std::sqrt(static_cast<double>(num_triangles) / 2)));
+  const uint64_t n = cells + 1;
+
+  std::vector<int32_t> columns(n);
+  int32_t position = 0;
+  for (uint64_t i = 0; i < n; i++) {
+    columns[i] = position;
+    position += hmm ? 1 + static_cast<int32_t>(SplitMix64(i) % 8) : 1;
+  }
+
+  SyntheticMesh mesh;
+  mesh.shape = shape;
+  mesh.width = columns.back();
+  mesh.height = columns.back();
+  mesh.points.resize(n * n);
+  ParallelFor(n, 256, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    const float scale = 6.2831853f / static_cast<float>(std::max(1, mesh.width));
+    for (uint64_t y = begin; y < end; y++) {
+      for (uint64_t x = 0; x < n; x++) {
+        const float px = static_cast<float>(columns[x]);
+        const float py = static_cast<float>(columns[y]);
+        const float ridge = 0.5f + 0.25f * std::sin(3 * scale * px) * std::cos(2 * scale * py);
+        mesh.points[y * n + x] = {px, py, ridge + 0.25f * UnitFloat(y * n + x)};
+      }
+    }
+  });
+
+  mesh.triangles.resize(2 * cells * cells);
+  ParallelFor(cells, 256, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t y = begin; y < end; y++) {
+      for (uint64_t x = 0; x < cells; x++) {
+        const int32_t v00 = static_cast<int32_t>(y * n + x);
+        const int32_t v10 = v00 + 1;
+        const int32_t v01 = v00 + static_cast<int32_t>(n);
+        const int32_t v11 = v01 + 1;
+        glm::ivec3 *cell = &mesh.triangles[2 * (y * cells + x)];
+        if (hmm && (SplitMix64(~(y * cells + x)) & 1)) {
+          cell[0] = {v00, v10, v01};
+          cell[1] = {v10, v11, v01};
+        } else {
+          cell[0] = {v00, v10, v11};
+          cell[1] = {v00, v11, v01};
+        }
+      }
+    }
+  });
+
+  if (hmm) {
+    std::mt19937_64 rng(0);
+    for (uint64_t t = mesh.triangles.size() - 1; t > 0; t--) {
+      std::swap(mesh.triangles[t], mesh.triangles[rng() % (t + 1)]);
+    }
+  }
+  return mesh;
+}
+
+// A georeference for the synthetic raster: one arc second pixels near the
+// Grand Canyon, heights from 700 to 2800 m. For ned, the same area as 30 m
+// UTM pixels.
+static HeightmapGeoreference SyntheticGeoreference(const SyntheticMesh &mesh, const OutputScaling output_scaling) {
+  HeightmapGeoreference georeference;
+  if (output_scaling == OutputScaling::kNed) {
+    georeference.lon0_deg = 322000.0;
+    georeference.dlon_deg_dpixel = 30.0;
+    georeference.lat0_deg = 4096000.0;
+    georeference.dlat_deg_dpixel = -30.0;
+  } else {
+    georeference.lon0_deg = -113.0;
+    georeference.dlon_deg_dpixel = 1.0 / 3600;
+    georeference.lat0_deg = 37.0;
+    georeference.dlat_deg_dpixel = -1.0 / 3600;
+  }
+  georeference.n_lon = mesh.width;
+  georeference.n_lat = mesh.height;
+  georeference.min_height = 700;
+  georeference.max_height = 2800;
+  georeference.z_exag = 1;
+  return georeference;
+}
+
+// What one stage measured, sent from the child process back to the parent.
+struct StageResult {
+  double seconds = 0;
+  uint64_t allocations = 0;
+  uint64_t allocated_bytes = 0;
+  uint64_t peak_rss_bytes = 0;
+  uint64_t file_bytes = 0;
+  uint64_t num_vertices = 0;
+  uint64_t num_triangles = 0;
+  uint64_t output_hash = 0;
+};
+
+// Per stage callbacks. `setup` runs untimed, `run` is measured, then `finish`
+// fills in the output hash and sizes.
+struct Stage {
+  std::string name;
+  std::function<void()> setup;
+  std::function<void()> run;
+  std::function<void(StageResult *)> finish;
+};
+
+static StageResult RunStageInChild(const Stage &stage) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    fprintf(stderr, "Error creating pipe\n");
+    std::exit(1);
+  }
+  fflush(stdout);
+  fflush(stderr);
+  const pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    stage.setup();
+    ResetPeakRss();
+    const uint64_t rss_before = ReadProcStatus("VmRSS");
+    const uint64_t allocations_before = g_allocations;
+    const uint64_t allocated_bytes_before = g_allocated_bytes;
+    const auto start = std::chrono::steady_clock::now();
+    stage.run();
+    StageResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.allocations = g_allocations - allocations_before;
+    result.allocated_bytes = g_allocated_bytes - allocated_bytes_before;
+    const uint64_t peak_rss = ReadProcStatus("VmHWM");
+    result.peak_rss_bytes = peak_rss > rss_before ? peak_rss - rss_before : 0;
+    stage.finish(&result);
+    const bool ok = write(fds[1], &result, sizeof(result)) == static_cast<ssize_t>(sizeof(result));
+    std::_Exit(ok ? 0 : 1);
+  }
+  close(fds[1]);
+  StageResult result;
+  const bool ok = read(fds[0], &result, sizeof(result)) == static_cast<ssize_t>(sizeof(result));
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "Benchmark stage %s failed\n", stage.name.c_str());
+    std::exit(1);
+  }
+  return result;
+}
+
+static std::vector<std::string> SplitCommas(const std::string &list) {
+  std::vector<std::string> items;
+  size_t begin = 0;
+  while (begin <= list.size()) {
+    const size_t end = std::min(list.find(',', begin), list.size());
+    if (end > begin) {
+      items.push_back(list.substr(begin, end - begin));
+    }
+    begin = end + 1;
+  }
+  return items;
+}
+
+int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  std::vector<uint64_t> sizes = {1000000, 10000000, 50000000};
+  std::vector<std::string> shapes = {"grid", "hmm"};
+  std::vector<std::string> orders = {"input", "reordered"};
+  uint32_t repetitions = 1;
+  const char *tmpdir_env = std::getenv("TEST_TMPDIR") ? std::getenv("TEST_TMPDIR") : std::getenv("TMPDIR");
+  std::string tmpdir = tmpdir_env ? tmpdir_env : "/tmp";
+  std::string output_path;
+  for (int32_t k = 1; k < argc; k++) {
+    const std::string arg = argv[k];
+    const size_t equals = arg.find('=');
+    const std::string flag = arg.substr(0, equals);
+    const std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+    if (flag == "--sizes" && !value.empty()) {
+      sizes.clear();
+      for (const std::string &size : SplitCommas(value)) {
+        sizes.push_back(std::stoull(size));
+      }
+    } else if (flag == "--shapes" && !value.empty()) {
+      shapes = SplitCommas(value);
+    } else if (flag == "--orders" && !value.empty()) {
+      orders = SplitCommas(value);
+    } else if (flag == "--repetitions" && !value.empty()) {
+      repetitions = static_cast<uint32_t>(std::max(1, std::stoi(value)));
+    } else if (flag == "--tmpdir" && !value.empty()) {
+      tmpdir = value;
+    } else if (flag == "--output" && !value.empty()) {
+      output_path = value;
+    } else {
+      fprintf(stderr, "Usage: ./bench [--sizes=N,...] [--shapes=grid,hmm] [--orders=input,reordered] "
+                      "[--repetitions=N] [--tmpdir=DIR] [--output=results.json]\n");
+      std::exit(1);
+    }
+  }
+  for (const std::string &shape : shapes) {
+    if (shape != "grid" && shape != "hmm") {
+      fprintf(stderr, "Unknown shape %s, expected grid or hmm\n", shape.c_str());
+      std::exit(1);
+    }
+  }
+  for (const std::string &order : orders) {
+    if (order != "input" && order != "reordered") {
+      fprintf(stderr, "Unknown order %s, expected input or reordered\n", order.c_str());
+      std::exit(1);
+    }
+  }
+
+  const std::string prefix = tmpdir + "/meshtools_bench_" + std::to_string(getpid());
+  const std::string stl_path = prefix + ".stl";
+  const std::string ply_path = prefix + ".ply";
+  const std::string mesh_path = prefix + ".mesh";
+  const std::string threemf_path = prefix + ".3mf";
+
+  char hostname[256] = {0};
+  gethostname(hostname, sizeof(hostname) - 1);
+
+  std::string json = "{\n";
+  json += "  \"host\": \"" + std::string(hostname) + "\",\n";
+  json += "  \"compiler\": \"" + std::string(__VERSION__) + "\",\n";
+  json += "  \"threads\": " + std::to_string(NumThreads()) + ",\n";
+  json += "  \"simd\": \"" + std::string(FaceNormalsIsa()) + "\",\n";
+  json += "  \"repetitions\": " + std::to_string(repetitions) + ",\n";
+  json += "  \"results\": [";
+  bool first_result = true;
+
+  fprintf(stderr, "%-6s %10s %-9s %-14s %9s %9s %9s %12s %10s %16s\n", "shape", "triangles", "order", "stage",
+          "seconds", "Mtri/s", "MB/s", "allocations", "peak MB", "output hash");
+  for (const std::string &shape : shapes) {
+    for (const uint64_t size : sizes) {
+      SyntheticMesh mesh = GenerateMesh(shape, size);
+
+      for (const std::string &order : {std::string("input"), std::string("reordered")}) {
+        if (std::find(orders.begin(), orders.end(), order) == orders.end()) {
+          continue;
+        }
+        // Stages run on the input order first, so the mesh is only reordered
+        // once.
+        if (order == "reordered") {
+          ReorderMesh(&mesh.points, &mesh.triangles);
+        }
+
+        // State for a stage, living in the forked child.
+        std::vector<glm::vec3> points;
+        std::vector<glm::ivec3> triangles;
+        std::unique_ptr<MappedFile> mapped;
+        HalfEdgeMesh half_edges;
+        MeshStats mesh_stats;
+        auto nothing = [] {};
+        auto copy_points = [&] {
+          points = mesh.points;
+          triangles = mesh.triangles;
+        };
+        auto hash_file = [&](const std::string &path) {
+          return [&, path](StageResult *result) {
+            const MappedFile file(path);
+            result->file_bytes = file.size();
+            result->output_hash = ParallelHashBytes(file.data(), file.size());
+            result->num_vertices = mesh.points.size();
+            result->num_triangles = mesh.triangles.size();
+          };
+        };
+        auto hash_mesh = [&](const std::string &path) {
+          return [&, path](StageResult *result) {
+            result->file_bytes = path.empty() ? 0 : FileSize(path);
+            result->output_hash = MeshContentHash(points.data(), points.size(), triangles.data(), triangles.size());
+            result->num_vertices = points.size();
+            result->num_triangles = triangles.size();
+          };
+        };
+        auto map_stl = [&] {
+          mapped = std::make_unique<MappedFile>(stl_path);
+          // Fault the mapping in so the weld is timed on its own.
+          ParallelHashBytes(mapped->data(), mapped->size());
+        };
+
+        std::vector<Stage> stages = {
+            {"write_stl", nothing, [&] { WriteBinaryStl(stl_path, mesh.points, mesh.triangles); },
+             hash_file(stl_path)},
+            {"read_stl", nothing, [&] { ReadBinarySTL(stl_path, points, triangles); }, hash_mesh(stl_path)},
+            {"mesh_stats", nothing, [&] { mesh_stats = MeshFileStats(stl_path, true); },
+             [&](StageResult *result) {
+               result->file_bytes = FileSize(stl_path);
+               result->output_hash = HashBytes(&mesh_stats, sizeof(mesh_stats));
+               result->num_triangles = mesh_stats.num_triangles;
+             }},
+            {"weld", map_stl,
+             [&] {
+               WeldVertices(ParseBinaryStl(mapped->data(), mapped->size()).Corners(), WeldMethod::kGrid, &points,
+                            &triangles);
+             },
+             hash_mesh("")},
+            {"half_edges", nothing, [&] { half_edges = BuildHalfEdges(mesh.points.size(), mesh.triangles); },
+             [&](StageResult *result) {
+               result->output_hash =
+                   ParallelHashBytes(half_edges.twins.data(), half_edges.twins.size() * sizeof(int32_t));
+               result->num_vertices = mesh.points.size();
+               result->num_triangles = mesh.triangles.size();
+             }},
+            {"save_ply", nothing, [&] { SavePly(ply_path, mesh.points, mesh.triangles); }, hash_file(ply_path)},
+            {"load_ply", nothing, [&] { LoadPly(ply_path, &points, &triangles); }, hash_mesh(ply_path)},
+            {"write_mesh", nothing, [&] { WriteMesh(mesh_path, mesh.points, mesh.triangles); }, hash_file(mesh_path)},
+            {"read_mesh", nothing, [&] { ReadMesh(mesh_path, points, triangles); }, hash_mesh(mesh_path)},
+            {"write_3mf", nothing, [&] { WriteThreeMf(threemf_path, mesh.points, mesh.triangles); },
+             hash_file(threemf_path)},
+        };
+        // What terrain_pipeline does for each output_scaling.
+        for (const OutputScaling output_scaling :
+             {OutputScaling::kEnu, OutputScaling::kGnomonic, OutputScaling::kNed,
+              OutputScaling::kPolarStereographic, OutputScaling::kTransverseMercator}) {
+          const HeightmapGeoreference georeference = SyntheticGeoreference(mesh, output_scaling);
+          stages.push_back({OutputScalingName(output_scaling), copy_points,
+                            [&, output_scaling, georeference] {
+                              const Bounds bounds =
+                                  ProjectHeightmap(output_scaling, georeference, georeference.CenterLatDeg(),
+                                                   georeference.CenterLonDeg(), &points);
+                              ScaleToTargetSize(output_scaling, bounds, 100.0, &points);
+                            },
+                            hash_mesh("")});
+        }
+        if (order == "input") {
+          stages.push_back({"reorder_mesh", copy_points, [&] { ReorderMesh(&points, &triangles); }, hash_mesh("")});
+        }
+
+        for (const Stage &stage : stages) {
+          StageResult best;
+          for (uint32_t repetition = 0; repetition < repetitions; repetition++) {
+            const StageResult result = RunStageInChild(stage);
+            if (repetition == 0 || result.seconds < best.seconds) {
+              best = result;
+            }
+          }
+          const double mtri_per_s = static_cast<double>(mesh.triangles.size()) / best.seconds * 1e-6;
+          const double mb_per_s = static_cast<double>(best.file_bytes) / best.seconds / (1024.0 * 1024.0);
+          fprintf(stderr, "%-6s %10llu %-9s %-14s %9.3f %9.2f %9.1f %12llu %10.1f %16llx\n", shape.c_str(),
+                  static_cast<unsigned long long>(mesh.triangles.size()), order.c_str(), stage.name.c_str(),
+                  best.seconds, mtri_per_s, mb_per_s, static_cast<unsigned long long>(best.allocations),
+                  static_cast<double>(best.peak_rss_bytes) / (1024.0 * 1024.0),
+                  static_cast<unsigned long long>(best.output_hash));
+
+          char hash[17];
+          snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(best.output_hash));
+          char line[1024];
+          snprintf(line, sizeof(line),
+                   "%s\n    {\"shape\": \"%s\", \"input_triangles\": %llu, \"order\": \"%s\", \"stage\": \"%s\", "
+                   "\"seconds\": %.6f, "
+                   "\"mtri_per_s\": %.3f, \"file_bytes\": %llu, \"mb_per_s\": %.3f, \"allocations\": %llu, "
+                   "\"allocated_bytes\": %llu, \"peak_rss_bytes\": %llu, \"output_vertices\": %llu, "
+                   "\"output_triangles\": %llu, \"output_hash\": \"%s\"}",
+                   first_result ? "" : ",", shape.c_str(), static_cast<unsigned long long>(mesh.triangles.size()),
+                   order.c_str(), stage.name.c_str(), best.seconds, mtri_per_s, static_cast<unsigned long long>(best.file_bytes), mb_per_s,
+                   static_cast<unsigned long long>(best.allocations),
+                   static_cast<unsigned long long>(best.allocated_bytes),
+                   static_cast<unsigned long long>(best.peak_rss_bytes),
+                   static_cast<unsigned long long>(best.num_vertices),
+                   static_cast<unsigned long long>(best.num_triangles), hash);
+          json += line;
+          first_result = false;
+        }
+        std::remove(stl_path.c_str());
+        std::remove(ply_path.c_str());
+        std::remove(mesh_path.c_str());
+        std::remove(threemf_path.c_str());
+      }
+    }
+  }
+  json += "\n  ]\n}\n";
+
+  if (output_path.empty()) {
+    fputs(json.c_str(), stdout);
+  } else {
+    FILE *output = fopen(output_path.c_str(), "w");
+    if (output == NULL || fputs(json.c_str(), output) < 0 || fclose(output) != 0) {
+      fprintf(stderr, "Error writing %s\n", output_path.c_str());
+      std::exit(1);
+    }
+  }
+}
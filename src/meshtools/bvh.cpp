@@ -0,0 +1,433 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+
+namespace {
+
+constexpr uint32_t kNumBins = 16;
+// Leaves are split by SAH down to this size, and always above kMaxLeafSize.
+constexpr uint32_t kMinLeafSize = 2;
+constexpr uint32_t kMaxLeafSize = 8;
+// Subtrees smaller than this are not worth a thread.
+constexpr uint32_t kMinParallelSubtree = 1 << 15;
+// Past this depth, splits fall back to the object median so the traversal
+// stacks below can't overflow, whatever the triangle distribution.
+constexpr uint32_t kMaxSahDepth = 48;
+constexpr uint32_t kTraversalStackSize = 96;
+
+struct Box {
+  glm::vec3 min = glm::vec3(FLT_MAX);
+  glm::vec3 max = glm::vec3(-FLT_MAX);
+
+  void Grow(const glm::vec3 &point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+  void Grow(const Box &box) {
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+  }
+  float HalfArea() const {
+    const glm::vec3 extent = max - min;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+  }
+};
+
+struct TriangleRef {
+  Box box;
+  glm::vec3 centroid;
+  uint32_t triangle;
+};
+
+class BvhBuilder {
+ public:
+  BvhBuilder(std::vector<TriangleRef> *refs, const uint32_t spawn_depth) : refs_(*refs), spawn_depth_(spawn_depth) {}
+
+  // Append the subtree over refs [begin, end) to `nodes`. Second child
+  // indices are relative to the start of `nodes`.
+  void Build(const uint32_t begin, const uint32_t end, const uint32_t depth, std::vector<BvhNode> *nodes) {
+    Box bounds;
+    Box centroid_bounds;
+    for (uint32_t i = begin; i < end; i++) {
+      bounds.Grow(refs_[i].box);
+      centroid_bounds.Grow(refs_[i].centroid);
+    }
+    const uint32_t node = static_cast<uint32_t>(nodes->size());
+    nodes->push_back({bounds.min, begin, bounds.max, end - begin});
+    const uint32_t count = end - begin;
+    if (count <= kMinLeafSize) {
+      return;
+    }
+
+    const uint32_t mid = Split(begin, end, depth, bounds, centroid_bounds);
+    if (mid == begin) {
+      return;
+    }
+    (*nodes)[node].count = 0;
+    if (depth < spawn_depth_ && count >= kMinParallelSubtree) {
+      std::vector<BvhNode> right;
+      std::thread thread([this, mid, end, depth, &right] { Build(mid, end, depth + 1, &right); });
+      Build(begin, mid, depth + 1, nodes);
+      thread.join();
+      const uint32_t offset = static_cast<uint32_t>(nodes->size());
+      (*nodes)[node].first = offset;
+      for (BvhNode &child : right) {
+        if (child.count == 0) {
+          child.first += offset;
+        }
+      }
+      nodes->insert(nodes->end(), right.begin(), right.end());
+    } else {
+      Build(begin, mid, depth + 1, nodes);
+      (*nodes)[node].first = static_cast<uint32_t>(nodes->size());
+      Build(mid, end, depth + 1, nodes);
+    }
+  }
+
+ private:
+  // Partition [begin, end) and return the start of the second child, or
+  // `begin` to make a leaf.
+  uint32_t Split(const uint32_t begin, const uint32_t end, const uint32_t depth,
+                 const Box &bounds, const Box &centroid_bounds) {
+    const uint32_t count = end - begin;
+    const glm::vec3 extent = centroid_bounds.max - centroid_bounds.min;
+    if (depth >= kMaxSahDepth) {
+      int axis = 0;
+      if (extent.y > extent[axis]) axis = 1;
+      if (extent.z > extent[axis]) axis = 2;
+      const uint32_t mid = begin + count / 2;
+      std::nth_element(refs_.begin() + begin, refs_.begin() + mid, refs_.begin() + end,
+                       [axis](const TriangleRef &a, const TriangleRef &b) {
+                         return a.centroid[axis] < b.centroid[axis];
+                       });
+      return mid;
+    }
+
+    // Binned SAH over each axis the centroids spread along. Costs are in
+    // units of one triangle test, with one more for the extra traversal step.
+    float best_cost = FLT_MAX;
+    int best_axis = -1;
+    uint32_t best_bin = 0;
+    for (int axis = 0; axis < 3; axis++) {
+      if (!(extent[axis] > 0)) {
+        continue;
+      }
+      const float scale = static_cast<float>(kNumBins) / extent[axis];
+      const float origin = centroid_bounds.min[axis];
+      Box bin_boxes[kNumBins];
+      uint32_t bin_counts[kNumBins] = {};
+      for (uint32_t i = begin; i < end; i++) {
+        const uint32_t bin = BinOf(refs_[i].centroid[axis], origin, scale);
+        bin_boxes[bin].Grow(refs_[i].box);
+        bin_counts[bin]++;
+      }
+      // Sweep from the right, then evaluate each split from the left.
+      float right_areas[kNumBins];
+      uint32_t right_counts[kNumBins];
+      Box right_box;
+      uint32_t right_count = 0;
+      for (uint32_t bin = kNumBins - 1; bin > 0; bin--) {
+        right_box.Grow(bin_boxes[bin]);
+        right_count += bin_counts[bin];
+        right_areas[bin] = right_box.HalfArea();
+        right_counts[bin] = right_count;
+      }
+      Box left_box;
+      uint32_t left_count = 0;
+      for (uint32_t bin = 0; bin + 1 < kNumBins; bin++) {
+        left_box.Grow(bin_boxes[bin]);
+        left_count += bin_counts[bin];
+        if (left_count == 0 || right_counts[bin + 1] == 0) {
+          continue;
+        }
+        const float cost = left_box.HalfArea() * static_cast<float>(left_count) +
+                           right_areas[bin + 1] * static_cast<float>(right_counts[bin + 1]);
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_bin = bin;
+        }
+      }
+    }
+
+    const float area = bounds.HalfArea();
+    const bool sah_split = best_axis >= 0 && area + best_cost < area * static_cast<float>(count);
+    if (!sah_split) {
+      if (count <= kMaxLeafSize) {
+        return begin;
+      }
+      if (best_axis < 0) {
+        // Every centroid is the same point, so any order is as good.
+        return begin + count / 2;
+      }
+    }
+    const float scale = static_cast<float>(kNumBins) / extent[best_axis];
+    const float origin = centroid_bounds.min[best_axis];
+    const auto middle = std::partition(refs_.begin() + begin, refs_.begin() + end,
+                                       [&](const TriangleRef &ref) {
+                                         return BinOf(ref.centroid[best_axis], origin, scale) <= best_bin;
+                                       });
+    return static_cast<uint32_t>(middle - refs_.begin());
+  }
+
+  static uint32_t BinOf(const float value, const float origin, const float scale) {
+    const float bin = (value - origin) * scale;
+    return bin < static_cast<float>(kNumBins) ? static_cast<uint32_t>(bin) : kNumBins - 1;
+  }
+
+  std::vector<TriangleRef> &refs_;
+  const uint32_t spawn_depth_;
+};
+
+// Entry distance of the ray into the node box, or FLT_MAX on a miss.
+float EnterBox(const BvhNode &node, const glm::vec3 &origin, const glm::vec3 &inverse_direction, const float t_max) {
+  const glm::vec3 t0 = (node.min - origin) * inverse_direction;
+  const glm::vec3 t1 = (node.max - origin) * inverse_direction;
+  const glm::vec3 near = glm::min(t0, t1);
+  const glm::vec3 far = glm::max(t0, t1);
+  const float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+  const float exit = std::min(std::min(far.x, far.y), std::min(far.z, t_max));
+  return enter <= exit ? enter : FLT_MAX;
+}
+
+// Möller-Trumbore, accepting hits from both sides.
+bool IntersectTriangle(const glm::vec3 *corners, const glm::vec3 &origin, const glm::vec3 &direction,
+                       const float t_max, float *t) {
+  const glm::vec3 edge1 = corners[1] - corners[0];
+  const glm::vec3 edge2 = corners[2] - corners[0];
+  const glm::vec3 p = glm::cross(direction, edge2);
+  const float determinant = glm::dot(edge1, p);
+  if (determinant == 0) {
+    return false;
+  }
+  const float inverse_determinant = 1.0f / determinant;
+  const glm::vec3 s = origin - corners[0];
+  const float u = glm::dot(s, p) * inverse_determinant;
+  if (u < 0 || u > 1) {
+    return false;
+  }
+  const glm::vec3 q = glm::cross(s, edge1);
+  const float v = glm::dot(direction, q) * inverse_determinant;
+  if (v < 0 || u + v > 1) {
+    return false;
+  }
+  const float hit_t = glm::dot(edge2, q) * inverse_determinant;
+  if (hit_t < 0 || hit_t > t_max) {
+    return false;
+  }
+  *t = hit_t;
+  return true;
+}
+
+// Twice the signed area of (a, b, p) in xy. Differences of floats are exact
+// in double, so the sign is reliable for points on shared edges.
+double Orient2d(const glm::vec3 &a, const glm::vec3 &b, const double px, const double py) {
+  return (double{b.x} - double{a.x}) * (py - double{a.y}) - (double{b.y} - double{a.y}) * (px - double{a.x});
+}
+
+}  // namespace
+
+Bvh BuildBvh(const std::vector<glm::vec3> &points, const std::vector<glm::ivec3> &triangles) {
+  const ScopedStage stage("build_bvh");
+  Bvh bvh;
+  if (triangles.empty()) {
+    return bvh;
+  }
+  std::vector<TriangleRef> refs(triangles.size());
+  ParallelFor(triangles.size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t i = begin; i < end; i++) {
+      TriangleRef &ref = refs[i];
+      for (int corner = 0; corner < 3; corner++) {
+        ref.box.Grow(points[static_cast<size_t>(triangles[i][corner])]);
+      }
+      ref.centroid = (ref.box.min + ref.box.max) * 0.5f;
+      ref.triangle = static_cast<uint32_t>(i);
+    }
+  });
+
+  // Spawn down to a depth with a few subtrees per thread, for balance.
+  uint32_t spawn_depth = 1;
+  while ((1u << spawn_depth) < NumThreads()) {
+    spawn_depth++;
+  }
+  BvhBuilder builder(&refs, NumThreads() > 1 ? spawn_depth + 1 : 0);
+  bvh.nodes.reserve(2 * triangles.size() / kMinLeafSize);
+  builder.Build(0, static_cast<uint32_t>(refs.size()), 0, &bvh.nodes);
+  bvh.nodes.shrink_to_fit();
+
+  bvh.corners.resize(3 * triangles.size());
+  bvh.triangle_ids.resize(triangles.size());
+  ParallelFor(triangles.size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t i = begin; i < end; i++) {
+      const glm::ivec3 &triangle = triangles[refs[i].triangle];
+      for (int corner = 0; corner < 3; corner++) {
+        bvh.corners[3 * i + static_cast<uint64_t>(corner)] = points[static_cast<size_t>(triangle[corner])];
+      }
+      bvh.triangle_ids[i] = static_cast<int32_t>(refs[i].triangle);
+    }
+  });
+  StatsAdd("bvh_nodes", bvh.nodes.size());
+  return bvh;
+}
+
+RayHit IntersectRay(const Bvh &bvh, const glm::vec3 &origin, const glm::vec3 &direction, float t_max) {
+  RayHit hit;
+  if (bvh.nodes.empty()) {
+    return hit;
+  }
+  // Keep axis parallel rays finite, so a box face through the origin gives
+  // 0 rather than 0 * inf.
+  glm::vec3 inverse_direction;
+  for (int axis = 0; axis < 3; axis++) {
+    inverse_direction[axis] = std::fabs(direction[axis]) < 1e-30f ? std::copysign(1e30f, direction[axis])
+                                                                   : 1.0f / direction[axis];
+  }
+  if (EnterBox(bvh.nodes[0], origin, inverse_direction, t_max) == FLT_MAX) {
+    return hit;
+  }
+  uint32_t stack[kTraversalStackSize];
+  uint32_t stack_size = 0;
+  uint32_t node_index = 0;
+  uint32_t best = UINT32_MAX;
+  while (true) {
+    const BvhNode &node = bvh.nodes[node_index];
+    if (node.count > 0) {
+      for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        if (IntersectTriangle(&bvh.corners[3 * size_t{i}], origin, direction, t_max, &t_max)) {
+          best = i;
+        }
+      }
+    } else {
+      // Visit the nearer child first and come back for the other.
+      uint32_t near = node_index + 1;
+      uint32_t far = node.first;
+      float near_t = EnterBox(bvh.nodes[near], origin, inverse_direction, t_max);
+      float far_t = EnterBox(bvh.nodes[far], origin, inverse_direction, t_max);
+      if (far_t < near_t) {
+        std::swap(near, far);
+        std::swap(near_t, far_t);
+      }
+      if (near_t != FLT_MAX) {
+        if (far_t != FLT_MAX) {
+          assert(stack_size < kTraversalStackSize);
+          stack[stack_size++] = far;
+        }
+        node_index = near;
+        continue;
+      }
+    }
+    if (stack_size == 0) {
+      break;
+    }
+    node_index = stack[--stack_size];
+  }
+  if (best != UINT32_MAX) {
+    hit.triangle = bvh.triangle_ids[best];
+    hit.t = t_max;
+    hit.point = origin + direction * t_max;
+  }
+  return hit;
+}
+
+HeightHit HeightAt(const Bvh &bvh, const float x, const float y) {
+  HeightHit hit;
+  if (bvh.nodes.empty()) {
+    return hit;
+  }
+  const auto covers = [x, y](const BvhNode &node) {
+    return node.min.x <= x && x <= node.max.x && node.min.y <= y && y <= node.max.y;
+  };
+  if (!covers(bvh.nodes[0])) {
+    return hit;
+  }
+  uint32_t stack[kTraversalStackSize];
+  uint32_t stack_size = 0;
+  uint32_t node_index = 0;
+  uint32_t best = UINT32_MAX;
+  double best_z = -DBL_MAX;
+  while (true) {
+    const BvhNode &node = bvh.nodes[node_index];
+    if (double{node.max.z} < best_z) {
+      // Nothing in here can be higher.
+    } else if (node.count > 0) {
+      for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        const glm::vec3 *corners = &bvh.corners[3 * size_t{i}];
+        const double area = Orient2d(corners[0], corners[1], corners[2].x, corners[2].y);
+        if (area == 0) {
+          continue;
+        }
+        const double w0 = Orient2d(corners[1], corners[2], x, y);
+        const double w1 = Orient2d(corners[2], corners[0], x, y);
+        const double w2 = Orient2d(corners[0], corners[1], x, y);
+        const bool inside = area > 0 ? (w0 >= 0 && w1 >= 0 && w2 >= 0) : (w0 <= 0 && w1 <= 0 && w2 <= 0);
+        if (!inside) {
+          continue;
+        }
+        const double z = (w0 * double{corners[0].z} + w1 * double{corners[1].z} + w2 * double{corners[2].z}) / area;
+        if (z > best_z) {
+          best_z = z;
+          best = i;
+        }
+      }
+    } else {
+      // Visit the higher child first, so the other is more likely pruned.
+      uint32_t high = node_index + 1;
+      uint32_t low = node.first;
+      if (bvh.nodes[low].max.z > bvh.nodes[high].max.z) {
+        std::swap(high, low);
+      }
+      const bool high_covers = covers(bvh.nodes[high]);
+      const bool low_covers = covers(bvh.nodes[low]);
+      if (high_covers || low_covers) {
+        if (high_covers && low_covers) {
+          assert(stack_size < kTraversalStackSize);
+          stack[stack_size++] = low;
+        }
+        node_index = high_covers ? high : low;
+        continue;
+      }
+    }
+    if (stack_size == 0) {
+      break;
+    }
+    node_index = stack[--stack_size];
+  }
+  if (best != UINT32_MAX) {
+    hit.triangle = bvh.triangle_ids[best];
+    hit.z = static_cast<float>(best_z);
+  }
+  return hit;
+}
+
+void IntersectRays(const Bvh &bvh,
+                   const std::vector<glm::vec3> &origins,
+                   const std::vector<glm::vec3> &directions,
+                   std::vector<RayHit> *hits) {
+  const ScopedStage stage("intersect_rays");
+  assert(origins.size() == directions.size());
+  hits->assign(origins.size(), RayHit{});
+  ParallelFor(origins.size(), 1024, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t i = begin; i < end; i++) {
+      (*hits)[i] = IntersectRay(bvh, origins[i], directions[i]);
+    }
+  });
+  StatsAdd("rays_intersected", origins.size());
+}
+
+void HeightsAt(const Bvh &bvh, const std::vector<glm::vec2> &xy, std::vector<HeightHit> *hits) {
+  const ScopedStage stage("heights_at");
+  hits->assign(xy.size(), HeightHit{});
+  ParallelFor(xy.size(), 1024, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t i = begin; i < end; i++) {
+      (*hits)[i] = HeightAt(bvh, xy[i].x, xy[i].y);
+    }
+  });
+  StatsAdd("heights_queried", xy.size());
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Bounding volume hierarchy over the triangles of a mesh, for height and ray
+// queries against the generated surface.
+
+// 32 bytes, two per cache line. Nodes are stored depth first, so the first
+// child of an inner node is the next node.
+struct BvhNode {
+  glm::vec3 min;
+  // Leaf: first triangle in Bvh order. Inner node: index of the second child.
+  uint32_t first = 0;
+  glm::vec3 max;
+  // Triangles in a leaf, 0 for inner nodes.
+  uint32_t count = 0;
+};
+
+struct Bvh {
+  std::vector<BvhNode> nodes;
+  // Corners of every triangle in leaf order, so leaves read contiguous memory.
+  std::vector<glm::vec3> corners;
+  // Index into the original triangles of each triangle in leaf order.
+  std::vector<int32_t> triangle_ids;
+};
+
+// Build with a binned surface area heuristic. Large subtrees are built on
+// their own threads and spliced together in a fixed order, so the layout
+// only depends on the mesh. Triangles must index into `points`.
+Bvh BuildBvh(const std::vector<glm::vec3> &points, const std::vector<glm::ivec3> &triangles);
+
+struct RayHit {
+  // Original triangle index, or -1 on a miss.
+  int32_t triangle = -1;
+  // Distance along the ray in units of the direction's length.
+  float t = 0;
+  glm::vec3 point = glm::vec3(0);
+};
+
+// Closest hit of origin + t * direction with t in [0, t_max], from either
+// side of a triangle.
+RayHit IntersectRay(const Bvh &bvh, const glm::vec3 &origin, const glm::vec3 &direction,
+                    float t_max = 3.4e38f);
+
+struct HeightHit {
+  // Original triangle index, or -1 if no triangle covers the point.
+  int32_t triangle = -1;
+  float z = 0;
+};
+
+// Highest surface z above the point (x, y), over every triangle whose xy
+// projection contains it, edges included. Vertical triangles are skipped.
+HeightHit HeightAt(const Bvh &bvh, float x, float y);
+
+// The batched forms answer queries in parallel, replacing `hits`.
+void IntersectRays(const Bvh &bvh,
+                   const std::vector<glm::vec3> &origins,
+                   const std::vector<glm::vec3> &directions,
+                   std::vector<RayHit> *hits);
+void HeightsAt(const Bvh &bvh, const std::vector<glm::vec2> &xy, std::vector<HeightHit> *hits);
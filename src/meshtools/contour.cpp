@@ -0,0 +1,325 @@
+#include "contour.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+
+#include "src/meshtools/mesh_io.hpp"
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+
+namespace {
+
+constexpr uint32_t kNoSegment = UINT32_MAX;
+
+// Where one level crosses one triangle, from the mesh edge it leaves the
+// higher corner on to the edge it comes back on. Edges are keyed by their
+// vertex indices, lower first, so both triangles on an edge agree on it and
+// a segment's `to` is the next segment's `from`.
+struct Segment {
+  uint64_t from;
+  uint64_t to;
+};
+
+uint64_t EdgeKey(const int32_t a, const int32_t b) {
+  return static_cast<uint64_t>(std::min(a, b)) << 32 | static_cast<uint64_t>(std::max(a, b));
+}
+
+// Where `level` crosses an edge with one end below it and one at or above,
+// interpolated from the lower index end so both triangles get the same bits.
+glm::dvec2 Crossing(const std::vector<glm::vec3> &points, const uint64_t edge, const double level) {
+  const glm::vec3 &a = points[edge >> 32];
+  const glm::vec3 &b = points[edge & 0xffffffff];
+  const double t = (level - double{a.z}) / (double{b.z} - double{a.z});
+  return glm::dvec2(double{a.x} + t * (double{b.x} - double{a.x}), double{a.y} + t * (double{b.y} - double{a.y}));
+}
+
+// Levels crossed by a triangle are those in (min z, max z], as a range of
+// indices into the ascending levels.
+void CrossedLevels(const std::vector<glm::vec3> &points,
+                   const glm::ivec3 &triangle,
+                   const std::vector<double> &levels,
+                   uint64_t *first,
+                   uint64_t *last) {
+  const float z0 = points[static_cast<uint64_t>(triangle[0])].z;
+  const float z1 = points[static_cast<uint64_t>(triangle[1])].z;
+  const float z2 = points[static_cast<uint64_t>(triangle[2])].z;
+  const double min_z = double{std::min(z0, std::min(z1, z2))};
+  const double max_z = double{std::max(z0, std::max(z1, z2))};
+  *first = static_cast<uint64_t>(std::upper_bound(levels.begin(), levels.end(), min_z) - levels.begin());
+  *last = static_cast<uint64_t>(std::upper_bound(levels.begin(), levels.end(), max_z) - levels.begin());
+}
+
+// Chain one level's segments, sorted by `from`, into lines. Open lines start
+// where no segment leads in, at the boundary, and what is left are loops, each
+// started at its first segment in sorted order.
+std::vector<ContourLine> ChainSegments(const std::vector<glm::vec3> &points,
+                                       const Segment *segments,
+                                       const uint32_t num_segments,
+                                       const double level) {
+  std::vector<uint32_t> next(num_segments, kNoSegment);
+  std::vector<uint8_t> has_previous(num_segments, 0);
+  for (uint32_t i = 0; i < num_segments; i++) {
+    const Segment *found = std::lower_bound(segments, segments + num_segments, segments[i].to,
+                                            [](const Segment &segment, const uint64_t edge) {
+      return segment.from < edge;
+    });
+    if (found != segments + num_segments && found->from == segments[i].to) {
+      next[i] = static_cast<uint32_t>(found - segments);
+      has_previous[next[i]] = 1;
+    }
+  }
+
+  std::vector<ContourLine> lines;
+  std::vector<uint8_t> visited(num_segments, 0);
+  const auto walk = [&](const uint32_t start) {
+    ContourLine line;
+    line.points.push_back(Crossing(points, segments[start].from, level));
+    uint32_t i = start;
+    while (true) {
+      visited[i] = 1;
+      // Segments through a vertex on the level have zero length.
+      const glm::dvec2 point = Crossing(points, segments[i].to, level);
+      if (point != line.points.back()) {
+        line.points.push_back(point);
+      }
+      i = next[i];
+      if (i == start) {
+        line.closed = true;
+        break;
+      }
+      // A visited segment here means an edge shared by more than two
+      // triangles, so the line stops.
+      if (i == kNoSegment || visited[i]) {
+        break;
+      }
+    }
+    if (line.closed && line.points.size() > 1 && line.points.back() == line.points.front()) {
+      line.points.pop_back();
+    }
+    if (line.points.size() >= (line.closed ? 3u : 2u)) {
+      lines.push_back(std::move(line));
+    }
+  };
+  for (uint32_t i = 0; i < num_segments; i++) {
+    if (!has_previous[i] && !visited[i]) {
+      walk(i);
+    }
+  }
+  for (uint32_t i = 0; i < num_segments; i++) {
+    if (!visited[i]) {
+      walk(i);
+    }
+  }
+  return lines;
+}
+
+// The shortest text that reads back as the same float, like the 3MF writer,
+// since the mesh is only float precise. Adding zero turns the -0 of negated
+// y into 0.
+void AppendNumber(std::string *out, const double value) {
+  char buffer[16];
+  const char *end = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<float>(value + 0.0)).ptr;
+  out->append(buffer, static_cast<size_t>(end - buffer));
+}
+
+void AppendDxfLevel(const ContourLevel &level, std::string *out) {
+  for (const ContourLine &line : level.lines) {
+    // A 2D polyline on layer 0 with vertices following, at the level's
+    // elevation, flag 1 if closed.
+    out->append("0\nPOLYLINE\n8\n0\n66\n1\n10\n0\n20\n0\n30\n");
+    AppendNumber(out, level.z);
+    out->append(line.closed ? "\n70\n1\n" : "\n70\n0\n");
+    for (const glm::dvec2 &point : line.points) {
+      out->append("0\nVERTEX\n8\n0\n10\n");
+      AppendNumber(out, point.x);
+      out->append("\n20\n");
+      AppendNumber(out, point.y);
+      out->append("\n30\n");
+      AppendNumber(out, level.z);
+      out->append("\n");
+    }
+    out->append("0\nSEQEND\n8\n0\n");
+  }
+}
+
+void AppendSvgLevel(const ContourLevel &level, std::string *out) {
+  out->append("<g data-z=\"");
+  AppendNumber(out, level.z);
+  out->append("\">\n");
+  for (const ContourLine &line : level.lines) {
+    out->append("<path d=\"M");
+    for (const glm::dvec2 &point : line.points) {
+      out->append(" ");
+      AppendNumber(out, point.x);
+      out->append(" ");
+      AppendNumber(out, -point.y);
+    }
+    out->append(line.closed ? " Z\"/>\n" : "\"/>\n");
+  }
+  out->append("</g>\n");
+}
+
+}  // namespace
+
+Contours ContourMesh(const std::vector<glm::vec3> &points,
+                     const std::vector<glm::ivec3> &triangles,
+                     const std::vector<double> &levels) {
+  const ScopedStage stage("contour_mesh");
+  if (!std::is_sorted(levels.begin(), levels.end())) {
+    fprintf(stderr, "Contour levels must be ascending.\n");
+    std::exit(1);
+  }
+  if (levels.size() >= kNoSegment || points.size() > INT32_MAX) {
+    fprintf(stderr, "Too many contour levels or points.\n");
+    std::exit(1);
+  }
+  Contours contours;
+  if (!points.empty()) {
+    contours.min_x = contours.max_x = double{points[0].x};
+    contours.min_y = contours.max_y = double{points[0].y};
+  }
+  for (const glm::vec3 &point : points) {
+    contours.min_x = std::min(contours.min_x, double{point.x});
+    contours.max_x = std::max(contours.max_x, double{point.x});
+    contours.min_y = std::min(contours.min_y, double{point.y});
+    contours.max_y = std::max(contours.max_y, double{point.y});
+  }
+
+  // Count each chunk's segments per level, then write them at the chunk's
+  // offset within the level, so each level's segments come out in triangle
+  // order whatever the thread count, with no separate sort by level.
+  constexpr uint64_t kMinChunk = 1 << 16;
+  const uint64_t num_levels = levels.size();
+  std::vector<uint64_t> cursors(NumThreads() * num_levels, 0);
+  ParallelFor(triangles.size(), kMinChunk, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    uint64_t *counts = cursors.data() + chunk * num_levels;
+    for (uint64_t t = begin; t < end; t++) {
+      uint64_t first = 0;
+      uint64_t last = 0;
+      CrossedLevels(points, triangles[t], levels, &first, &last);
+      for (uint64_t l = first; l < last; l++) {
+        counts[l]++;
+      }
+    }
+  });
+  std::vector<uint64_t> level_offsets(num_levels + 1, 0);
+  for (uint64_t l = 0; l < num_levels; l++) {
+    level_offsets[l + 1] = level_offsets[l];
+    for (uint64_t chunk = 0; chunk < NumThreads(); chunk++) {
+      const uint64_t count = cursors[chunk * num_levels + l];
+      cursors[chunk * num_levels + l] = level_offsets[l + 1];
+      level_offsets[l + 1] += count;
+    }
+  }
+  std::vector<Segment> segments(level_offsets.back());
+  ParallelFor(triangles.size(), kMinChunk, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    uint64_t *chunk_cursors = cursors.data() + chunk * num_levels;
+    for (uint64_t t = begin; t < end; t++) {
+      const glm::ivec3 &triangle = triangles[t];
+      uint64_t first = 0;
+      uint64_t last = 0;
+      CrossedLevels(points, triangle, levels, &first, &last);
+      for (uint64_t l = first; l < last; l++) {
+        bool above[3];
+        for (int k = 0; k < 3; k++) {
+          above[k] = double{points[static_cast<uint64_t>(triangle[k])].z} >= levels[l];
+        }
+        Segment &segment = segments[chunk_cursors[l]++];
+        for (int k = 0; k < 3; k++) {
+          const int k_next = (k + 1) % 3;
+          if (above[k] && !above[k_next]) {
+            segment.from = EdgeKey(triangle[k], triangle[k_next]);
+          } else if (!above[k] && above[k_next]) {
+            segment.to = EdgeKey(triangle[k], triangle[k_next]);
+          }
+        }
+      }
+    }
+  });
+
+  // Sort each level by edge to chain it.
+  contours.levels.resize(levels.size());
+  ParallelFor(levels.size(), 1, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t l = begin; l < end; l++) {
+      Segment *first = segments.data() + level_offsets[l];
+      Segment *last = segments.data() + level_offsets[l + 1];
+      if (last - first > INT32_MAX) {
+        fprintf(stderr, "Too many segments at contour level %.9g\n", levels[l]);
+        std::exit(1);
+      }
+      std::sort(first, last, [](const Segment &a, const Segment &b) {
+        return a.from < b.from || (a.from == b.from && a.to < b.to);
+      });
+      contours.levels[l].z = levels[l];
+      contours.levels[l].lines = ChainSegments(points, first, static_cast<uint32_t>(last - first), levels[l]);
+    }
+  });
+
+  uint64_t num_lines = 0;
+  for (const ContourLevel &level : contours.levels) {
+    num_lines += level.lines.size();
+  }
+  StatsAdd("contour_levels", levels.size());
+  StatsAdd("contour_segments", segments.size());
+  StatsAdd("contour_lines", num_lines);
+  return contours;
+}
+
+void WriteContours(const std::string &path, const Contours &contours) {
+  const ScopedStage stage("write_contours");
+  const bool svg = HasExtension(path, ".svg");
+  if (!svg && !HasExtension(path, ".dxf")) {
+    fprintf(stderr, "Can only write contours to .dxf or .svg, not %s\n", path.c_str());
+    std::exit(1);
+  }
+  FILE *output = fopen(path.c_str(), "wb");
+  if (output == nullptr) {
+    fprintf(stderr, "Error opening output file %s.\n", path.c_str());
+    std::exit(1);
+  }
+
+  std::string header;
+  if (svg) {
+    // SVG y runs down, so y is negated and the view box starts at -max_y.
+    const double width = std::max(contours.max_x - contours.min_x, 1e-9);
+    const double height = std::max(contours.max_y - contours.min_y, 1e-9);
+    header = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"";
+    AppendNumber(&header, contours.min_x);
+    header += " ";
+    AppendNumber(&header, -contours.max_y);
+    header += " ";
+    AppendNumber(&header, width);
+    header += " ";
+    AppendNumber(&header, height);
+    header += "\">\n<style>path{fill:none;stroke:black;stroke-width:1px;vector-effect:non-scaling-stroke}</style>\n";
+  } else {
+    header = "0\nSECTION\n2\nENTITIES\n";
+  }
+  const std::string footer = svg ? "</svg>\n" : "0\nENDSEC\n0\nEOF\n";
+
+  // Format the levels in parallel, then write them in order.
+  std::vector<std::string> texts(contours.levels.size());
+  ParallelFor(contours.levels.size(), 1, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t l = begin; l < end; l++) {
+      if (svg) {
+        AppendSvgLevel(contours.levels[l], &texts[l]);
+      } else {
+        AppendDxfLevel(contours.levels[l], &texts[l]);
+      }
+    }
+  });
+  uint64_t num_bytes = 0;
+  bool ok = fwrite(header.data(), 1, header.size(), output) == header.size();
+  for (const std::string &text : texts) {
+    ok = ok && fwrite(text.data(), 1, text.size(), output) == text.size();
+    num_bytes += text.size();
+  }
+  ok = ok && fwrite(footer.data(), 1, footer.size(), output) == footer.size();
+  if (fclose(output) != 0 || !ok) {
+    fprintf(stderr, "Error writing %s\n", path.c_str());
+    std::exit(1);
+  }
+  StatsAdd("contour_bytes_written", header.size() + num_bytes + footer.size());
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// A polyline where a mesh crosses one z level, in the mesh's x and y.
+struct ContourLine {
+  std::vector<glm::dvec2> points;
+  // The last point connects back to the first, which is not repeated.
+  bool closed = false;
+};
+
+struct ContourLevel {
+  double z = 0;
+  std::vector<ContourLine> lines;
+};
+
+struct Contours {
+  // X/Y extents of the whole mesh, so contour sheets of one mesh line up.
+  double min_x = 0;
+  double min_y = 0;
+  double max_x = 0;
+  double max_y = 0;
+  std::vector<ContourLevel> levels;
+};
+
+// Slice a welded mesh at every z in `levels`, which must be ascending, in one
+// pass over the triangles. Each triangle finds the levels it spans by binary
+// search, so a level only costs the triangles it crosses. A vertex exactly on
+// a level counts as above it. Segments meet on shared mesh edges and are
+// chained into polylines that run with higher ground on the left, so closed
+// lines around peaks of an upward facing surface run counterclockwise seen
+// from above. Lines are open where they reach the mesh boundary, and the
+// output does not depend on the thread count.
+Contours ContourMesh(const std::vector<glm::vec3> &points,
+                     const std::vector<glm::ivec3> &triangles,
+                     const std::vector<double> &levels);
+
+// Write contours as R12 DXF polylines at their elevation, or as SVG paths
+// with y up, one group per level, framed by the mesh extents. The format
+// comes from the .dxf or .svg extension. Exits on any other extension.
+void WriteContours(const std::string &path, const Contours &contours);
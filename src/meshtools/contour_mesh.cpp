@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/contour.hpp"
+#include "src/meshtools/mesh_io.hpp"
+#include "src/meshtools/stats.hpp"
+
+namespace {
+
+// More levels than this is almost certainly an interval in the wrong units.
+constexpr double kMaxLevels = 100000;
+
+}  // namespace
+
+// Slice a mesh into contour lines at z levels in the mesh's own units, e.g.
+// the scaled terrain, so the lines match the printed geometry. Levels are
+// every `interval` starting from `offset` across the mesh's z range, or an
+// explicit comma separated list. Writes one file per output, DXF or SVG by
+// extension.
+// Usage: ./contour_mesh input output.(dxf|svg) [output...] (--interval=D [--offset=O] | --levels=a,b,...)
+int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  // Parse flags.
+  std::vector<std::string> paths;
+  double interval = 0;
+  double offset = 0;
+  std::vector<double> levels;
+  for (int32_t k = 1; k < argc; k++) {
+    const std::string arg = argv[k];
+    if (arg.rfind("--interval=", 0) == 0) {
+      interval = std::stod(arg.substr(11));
+    } else if (arg.rfind("--offset=", 0) == 0) {
+      offset = std::stod(arg.substr(9));
+    } else if (arg.rfind("--levels=", 0) == 0) {
+      size_t start = 9;
+      while (start <= arg.size()) {
+        const size_t comma = std::min(arg.find(',', start), arg.size());
+        levels.push_back(std::stod(arg.substr(start, comma - start)));
+        start = comma + 1;
+      }
+    } else if (arg.rfind("--", 0) == 0) {
+      fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+      std::exit(1);
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.size() < 2 || (interval > 0) == !levels.empty()) {
+    fprintf(stderr,
+            "Usage: ./contour_mesh input output.(dxf|svg) [output...] "
+            "(--interval=D [--offset=O] | --levels=a,b,...)\n");
+    std::exit(1);
+  }
+
+  // Read inputs.
+  std::vector<glm::vec3> vertices;
+  std::vector<glm::ivec3> triangles;
+  ReadMeshFile(paths[0], vertices, triangles);
+  std::cerr << "Loaded " << vertices.size() << " vertices and " << triangles.size() << " triangles from file." << std::endl;
+  if (vertices.empty()) {
+    fprintf(stderr, "Can't contour an empty mesh.\n");
+    std::exit(1);
+  }
+
+  if (interval > 0) {
+    float min_z = vertices[0].z;
+    float max_z = vertices[0].z;
+    for (const glm::vec3 &vertex : vertices) {
+      min_z = std::fmin(min_z, vertex.z);
+      max_z = std::fmax(max_z, vertex.z);
+    }
+    const double first = std::ceil((double{min_z} - offset) / interval);
+    const double last = std::floor((double{max_z} - offset) / interval);
+    if (last - first >= kMaxLevels) {
+      fprintf(stderr, "--interval=%g gives %.0f levels between z %g and %g, too many.\n", interval,
+              last - first + 1, double{min_z}, double{max_z});
+      std::exit(1);
+    }
+    for (double k = first; k <= last; k++) {
+      levels.push_back(offset + k * interval);
+    }
+  } else {
+    std::sort(levels.begin(), levels.end());
+    levels.erase(std::unique(levels.begin(), levels.end()), levels.end());
+  }
+
+  const Contours contours = ContourMesh(vertices, triangles, levels);
+  uint64_t num_lines = 0;
+  for (const ContourLevel &level : contours.levels) {
+    num_lines += level.lines.size();
+  }
+  std::cerr << "Found " << num_lines << " contour lines at " << levels.size() << " levels." << std::endl;
+
+  // Write outputs.
+  for (size_t i = 1; i < paths.size(); i++) {
+    WriteContours(paths[i], contours);
+  }
+}
@@ -0,0 +1,524 @@
+#include "decimate.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/topology.hpp"
+
+namespace {
+
+// Sum of weighted squared distances to a set of planes, as
+// p^T A p + 2 b.p + c with A symmetric. `w` is the total weight (area).
+struct Quadric {
+  double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+  double b0 = 0, b1 = 0, b2 = 0;
+  double c = 0;
+  double w = 0;
+
+  void Add(const Quadric &q) {
+    a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+    b0 += q.b0; b1 += q.b1; b2 += q.b2;
+    c += q.c;
+    w += q.w;
+  }
+
+  double Error(const glm::dvec3 &p) const {
+    const double ax = a00 * p.x + a01 * p.y + a02 * p.z;
+    const double ay = a01 * p.x + a11 * p.y + a12 * p.z;
+    const double az = a02 * p.x + a12 * p.y + a22 * p.z;
+    return p.x * ax + p.y * ay + p.z * az + 2 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+  }
+};
+
+Quadric PlaneQuadric(const glm::dvec3 &a, const glm::dvec3 &b, const glm::dvec3 &c) {
+  glm::dvec3 n = glm::cross(b - a, c - a);
+  const double length = glm::length(n);
+  Quadric q;
+  if (!(length > 0)) {
+    return q;
+  }
+  n /= length;
+  const double w = 0.5 * length;
+  const double d = -glm::dot(n, a);
+  q.a00 = w * n.x * n.x; q.a01 = w * n.x * n.y; q.a02 = w * n.x * n.z;
+  q.a11 = w * n.y * n.y; q.a12 = w * n.y * n.z; q.a22 = w * n.z * n.z;
+  q.b0 = w * n.x * d; q.b1 = w * n.y * d; q.b2 = w * n.z * d;
+  q.c = w * d * d;
+  q.w = w;
+  return q;
+}
+
+// Squared distance from p to the triangle abc, by the closest point on it
+// (Ericson, Real-Time Collision Detection, 5.1.5).
+double TriangleDistance2(const glm::dvec3 &p, const glm::dvec3 &a, const glm::dvec3 &b, const glm::dvec3 &c) {
+  const glm::dvec3 ab = b - a;
+  const glm::dvec3 ac = c - a;
+  const glm::dvec3 ap = p - a;
+  const double d1 = glm::dot(ab, ap);
+  const double d2 = glm::dot(ac, ap);
+  glm::dvec3 closest;
+  if (d1 <= 0 && d2 <= 0) {
+    closest = a;
+  } else {
+    const glm::dvec3 bp = p - b;
+    const double d3 = glm::dot(ab, bp);
+    const double d4 = glm::dot(ac, bp);
+    const glm::dvec3 cp = p - c;
+    const double d5 = glm::dot(ab, cp);
+    const double d6 = glm::dot(ac, cp);
+    const double va = d3 * d6 - d5 * d4;
+    const double vb = d5 * d2 - d1 * d6;
+    const double vc = d1 * d4 - d3 * d2;
+    if (d3 >= 0 && d4 <= d3) {
+      closest = b;
+    } else if (d6 >= 0 && d5 <= d6) {
+      closest = c;
+    } else if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+      closest = a + ab * (d1 / (d1 - d3));
+    } else if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+      closest = a + ac * (d2 / (d2 - d6));
+    } else if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+      closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    } else {
+      const double denom = va + vb + vc;
+      if (!(denom > 0)) {
+        // Degenerate, the edges above already found the closest point.
+        closest = glm::dot(ap, ap) < glm::dot(bp, bp) ? a : b;
+      } else {
+        closest = a + ab * (vb / denom) + ac * (vc / denom);
+      }
+    }
+  }
+  const glm::dvec3 offset = p - closest;
+  return glm::dot(offset, offset);
+}
+
+// Live triangles around each vertex, as compressed rows.
+struct Adjacency {
+  std::vector<uint64_t> offsets;
+  std::vector<uint32_t> triangles;
+
+  void Build(const uint64_t num_vertices, const std::vector<glm::ivec3> &mesh, const std::vector<uint8_t> &alive) {
+    offsets.assign(num_vertices + 1, 0);
+    for (uint64_t t = 0; t < mesh.size(); t++) {
+      if (alive[t]) {
+        for (int k = 0; k < 3; k++) {
+          offsets[static_cast<uint64_t>(mesh[t][k]) + 1]++;
+        }
+      }
+    }
+    for (uint64_t v = 0; v < num_vertices; v++) {
+      offsets[v + 1] += offsets[v];
+    }
+    triangles.resize(offsets[num_vertices]);
+    std::vector<uint64_t> next(offsets.begin(), offsets.end() - 1);
+    for (uint64_t t = 0; t < mesh.size(); t++) {
+      if (alive[t]) {
+        for (int k = 0; k < 3; k++) {
+          triangles[next[static_cast<uint64_t>(mesh[t][k])]++] = static_cast<uint32_t>(t);
+        }
+      }
+    }
+  }
+
+  const uint32_t *begin(const uint64_t v) const { return triangles.data() + offsets[v]; }
+  const uint32_t *end(const uint64_t v) const { return triangles.data() + offsets[v + 1]; }
+};
+
+bool Contains(const glm::ivec3 &triangle, const int32_t v) {
+  return triangle[0] == v || triangle[1] == v || triangle[2] == v;
+}
+
+// Vertices sharing a triangle with v, sorted, without duplicates.
+void Ring(const Adjacency &adjacency, const std::vector<glm::ivec3> &mesh, const int32_t v,
+          std::vector<int32_t> *ring) {
+  ring->clear();
+  for (const uint32_t *t = adjacency.begin(static_cast<uint64_t>(v)); t != adjacency.end(static_cast<uint64_t>(v)); t++) {
+    for (int k = 0; k < 3; k++) {
+      if (mesh[*t][k] != v) {
+        ring->push_back(mesh[*t][k]);
+      }
+    }
+  }
+  std::sort(ring->begin(), ring->end());
+  ring->erase(std::unique(ring->begin(), ring->end()), ring->end());
+}
+
+// Smallest allowed twice-area over squared longest edge of a triangle made by
+// a collapse. An equilateral triangle has about 0.87.
+constexpr double kMinSliverRatio = 0.01;
+
+double SliverRatio(const glm::dvec3 corners[3]) {
+  const double longest2 = std::max({glm::dot(corners[1] - corners[0], corners[1] - corners[0]),
+                                    glm::dot(corners[2] - corners[1], corners[2] - corners[1]),
+                                    glm::dot(corners[0] - corners[2], corners[0] - corners[2])});
+  return longest2 > 0 ? glm::length(glm::cross(corners[1] - corners[0], corners[2] - corners[0])) / longest2 : 0.0;
+}
+
+struct Collapse {
+  double cost;
+  int32_t from;
+  int32_t to;
+};
+
+// Per-thread scratch space for EvaluateVertex.
+struct Scratch {
+  std::vector<int32_t> ring_from;
+  std::vector<int32_t> ring_to;
+  std::vector<std::pair<double, int32_t>> options;
+  std::vector<int32_t> removed;
+};
+
+class Decimator {
+ public:
+  Decimator(const std::vector<glm::vec3> &points, std::vector<glm::ivec3> *mesh)
+      : points_(points), mesh_(*mesh), alive_(mesh->size(), 1), locked_(points.size(), 0),
+        quadrics_(points.size()), first_removed_(mesh->size(), -1), next_removed_(points.size(), -1) {
+    // Work relative to the bounding box center for better conditioned quadrics.
+    glm::vec3 min_point = points.empty() ? glm::vec3(0) : points[0];
+    glm::vec3 max_point = min_point;
+    for (const glm::vec3 &point : points) {
+      min_point = glm::min(min_point, point);
+      max_point = glm::max(max_point, point);
+    }
+    center_ = 0.5 * (glm::dvec3(min_point) + glm::dvec3(max_point));
+
+    for (uint64_t t = 0; t < mesh_.size(); t++) {
+      const glm::ivec3 &triangle = mesh_[t];
+      if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) {
+        alive_[t] = 0;
+      }
+    }
+    num_alive_ = static_cast<uint64_t>(std::count(alive_.begin(), alive_.end(), 1));
+    adjacency_.Build(points_.size(), mesh_, alive_);
+
+    // Quadrics only depend on each vertex's own triangles.
+    ParallelFor(points_.size(), 1 << 12, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+      for (uint64_t v = begin; v < end; v++) {
+        for (const uint32_t *t = adjacency_.begin(v); t != adjacency_.end(v); t++) {
+          const glm::ivec3 &triangle = mesh_[*t];
+          quadrics_[v].Add(PlaneQuadric(Position(triangle[0]), Position(triangle[1]), Position(triangle[2])));
+        }
+      }
+    });
+    // Both ends of every edge without a twin are locked. Degenerate triangles
+    // make their edges non-manifold, so their vertices stay put too.
+    const HalfEdgeMesh half_edges = BuildHalfEdges(points_.size(), mesh_);
+    for (uint64_t h = 0; h < half_edges.twins.size(); h++) {
+      if (half_edges.twins[h] < 0) {
+        locked_[static_cast<uint64_t>(HalfEdgeOrigin(mesh_, static_cast<int32_t>(h)))] = 1;
+        locked_[static_cast<uint64_t>(HalfEdgeTarget(mesh_, static_cast<int32_t>(h)))] = 1;
+      }
+    }
+  }
+
+  uint64_t num_alive() const { return num_alive_; }
+
+  // One pass of collapses. Returns how many were made.
+  uint64_t Pass(const uint64_t target_triangles, const double max_error, double *max_error_made) {
+    // Only vertices near the last pass's collapses can have a new best one.
+    cache_.resize(points_.size());
+    stale_.resize(points_.size(), 1);
+    ParallelFor(points_.size(), 1 << 12, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+      Scratch scratch;
+      for (uint64_t v = begin; v < end; v++) {
+        if (stale_[v]) {
+          cache_[v] = EvaluateVertex(static_cast<int32_t>(v), max_error, &scratch);
+        }
+      }
+    });
+    std::vector<Collapse> best;
+    for (const Collapse &collapse : cache_) {
+      if (collapse.from >= 0) {
+        best.push_back(collapse);
+      }
+    }
+    std::sort(best.begin(), best.end(), [](const Collapse &a, const Collapse &b) {
+      return a.cost < b.cost || (a.cost == b.cost && a.from < b.from);
+    });
+
+    // A collapse changes the triangles around `from`, so everything they touch
+    // is dirty until the adjacency is rebuilt.
+    std::vector<uint8_t> dirty(points_.size(), 0);
+    uint64_t num_collapses = 0;
+    Scratch scratch;
+    for (const Collapse &collapse : best) {
+      if (num_alive_ <= target_triangles) {
+        break;
+      }
+      const uint64_t from = static_cast<uint64_t>(collapse.from);
+      if (dirty[from] || dirty[static_cast<uint64_t>(collapse.to)]) {
+        continue;
+      }
+      TakeRemoved(collapse.from, &scratch.removed);
+      for (const uint32_t *t = adjacency_.begin(from); t != adjacency_.end(from); t++) {
+        glm::ivec3 &triangle = mesh_[*t];
+        for (int k = 0; k < 3; k++) {
+          dirty[static_cast<uint64_t>(triangle[k])] = 1;
+        }
+        if (Contains(triangle, collapse.to)) {
+          alive_[*t] = 0;
+          num_alive_--;
+        } else {
+          for (int k = 0; k < 3; k++) {
+            triangle[k] = triangle[k] == collapse.from ? collapse.to : triangle[k];
+          }
+        }
+      }
+      quadrics_[static_cast<uint64_t>(collapse.to)].Add(quadrics_[from]);
+      *max_error_made = std::max(*max_error_made, Reassign(from, scratch.removed));
+      num_collapses++;
+    }
+    adjacency_.Build(points_.size(), mesh_, alive_);
+
+    // A collapse's validity depends on the rings of both ends, so every
+    // vertex sharing a triangle with a dirty one is re-evaluated.
+    std::fill(stale_.begin(), stale_.end(), 0);
+    for (uint64_t t = 0; t < mesh_.size(); t++) {
+      const glm::ivec3 &triangle = mesh_[t];
+      const uint64_t v[3] = {static_cast<uint64_t>(triangle[0]), static_cast<uint64_t>(triangle[1]),
+                             static_cast<uint64_t>(triangle[2])};
+      if (alive_[t] && (dirty[v[0]] || dirty[v[1]] || dirty[v[2]])) {
+        stale_[v[0]] = stale_[v[1]] = stale_[v[2]] = 1;
+      }
+    }
+    for (uint64_t v = 0; v < points_.size(); v++) {
+      stale_[v] |= dirty[v];
+    }
+    return num_collapses;
+  }
+
+  const std::vector<uint8_t> &alive() const { return alive_; }
+
+ private:
+  glm::dvec3 Position(const int32_t v) const {
+    return glm::dvec3(points_[static_cast<uint64_t>(v)]) - center_;
+  }
+
+  // The cheapest valid collapse of `from` onto a neighbor within max_error,
+  // or from = -1. The cost is the area weighted RMS distance of `to` from the
+  // planes of both ends, squared, which orders collapses but bounds nothing.
+  Collapse EvaluateVertex(const int32_t from, const double max_error, Scratch *scratch) const {
+    const Collapse none{0, -1, -1};
+    const uint64_t v = static_cast<uint64_t>(from);
+    if (locked_[v] || adjacency_.begin(v) == adjacency_.end(v)) {
+      return none;
+    }
+    Ring(adjacency_, mesh_, from, &scratch->ring_from);
+    scratch->options.clear();
+    for (const int32_t to : scratch->ring_from) {
+      Quadric quadric = quadrics_[v];
+      quadric.Add(quadrics_[static_cast<uint64_t>(to)]);
+      const double cost = quadric.w > 0 ? std::max(0.0, quadric.Error(Position(to))) / quadric.w : 0.0;
+      scratch->options.emplace_back(cost, to);
+    }
+    std::sort(scratch->options.begin(), scratch->options.end());
+    if (std::isfinite(max_error)) {
+      GatherRemoved(from, &scratch->removed);
+    }
+    for (const auto &[cost, to] : scratch->options) {
+      if (IsValid(from, to, scratch) &&
+          (!std::isfinite(max_error) || FanError(from, to, scratch->removed) <= max_error * max_error)) {
+        return Collapse{cost, from, to};
+      }
+    }
+    return none;
+  }
+
+  bool IsValid(const int32_t from, const int32_t to, Scratch *scratch) const {
+    // Link condition: the only vertices adjacent to both ends are the
+    // opposite corners of the two triangles on the edge.
+    Ring(adjacency_, mesh_, to, &scratch->ring_to);
+    uint64_t num_common = 0;
+    auto a = scratch->ring_from.begin();
+    auto b = scratch->ring_to.begin();
+    while (a != scratch->ring_from.end() && b != scratch->ring_to.end()) {
+      if (*a < *b) {
+        a++;
+      } else if (*b < *a) {
+        b++;
+      } else {
+        num_common++;
+        a++;
+        b++;
+      }
+    }
+    if (num_common != 2) {
+      return false;
+    }
+
+    // No remaining triangle may flip, turn too far or become a sliver. Turns
+    // add up over passes, so slivers are checked on their own.
+    const glm::dvec3 target = Position(to);
+    const uint64_t v = static_cast<uint64_t>(from);
+    for (const uint32_t *t = adjacency_.begin(v); t != adjacency_.end(v); t++) {
+      const glm::ivec3 &triangle = mesh_[*t];
+      if (Contains(triangle, to)) {
+        continue;
+      }
+      glm::dvec3 corners[3] = {Position(triangle[0]), Position(triangle[1]), Position(triangle[2])};
+      const glm::dvec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+      const double before_ratio = SliverRatio(corners);
+      for (int k = 0; k < 3; k++) {
+        corners[k] = triangle[k] == from ? target : corners[k];
+      }
+      const glm::dvec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+      if (!(glm::dot(before, after) > 0.25 * glm::length(before) * glm::length(after))) {
+        return false;
+      }
+      // A triangle that already was a sliver may stay one, but not get thinner.
+      if (SliverRatio(corners) < std::min(kMinSliverRatio, before_ratio)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // `from` and every removed vertex on the triangles around it, which is
+  // what collapsing `from` has to place on the new triangles.
+  void GatherRemoved(const int32_t from, std::vector<int32_t> *removed) const {
+    removed->assign(1, from);
+    const uint64_t v = static_cast<uint64_t>(from);
+    for (const uint32_t *t = adjacency_.begin(v); t != adjacency_.end(v); t++) {
+      for (int32_t r = first_removed_[*t]; r >= 0; r = next_removed_[static_cast<uint64_t>(r)]) {
+        removed->push_back(r);
+      }
+    }
+  }
+
+  // GatherRemoved, emptying the triangles' lists.
+  void TakeRemoved(const int32_t from, std::vector<int32_t> *removed) {
+    GatherRemoved(from, removed);
+    const uint64_t v = static_cast<uint64_t>(from);
+    for (const uint32_t *t = adjacency_.begin(v); t != adjacency_.end(v); t++) {
+      first_removed_[*t] = -1;
+    }
+  }
+
+  // Largest squared distance of `removed` from the triangles around `from`
+  // once it moves to `to`. Those triangles are only part of the new surface,
+  // so this bounds the distance from it.
+  double FanError(const int32_t from, const int32_t to, const std::vector<int32_t> &removed) const {
+    const uint64_t v = static_cast<uint64_t>(from);
+    double error = 0;
+    for (const int32_t r : removed) {
+      const glm::dvec3 p = Position(r);
+      double nearest = std::numeric_limits<double>::infinity();
+      for (const uint32_t *t = adjacency_.begin(v); t != adjacency_.end(v); t++) {
+        const glm::ivec3 &triangle = mesh_[*t];
+        if (Contains(triangle, to)) {
+          continue;
+        }
+        glm::dvec3 corners[3];
+        for (int k = 0; k < 3; k++) {
+          corners[k] = Position(triangle[k] == from ? to : triangle[k]);
+        }
+        nearest = std::min(nearest, TriangleDistance2(p, corners[0], corners[1], corners[2]));
+      }
+      error = std::max(error, nearest);
+    }
+    return error;
+  }
+
+  // After collapsing `from`, put each removed vertex on the nearest of the
+  // triangles that were around it, and return the largest distance.
+  double Reassign(const uint64_t from, const std::vector<int32_t> &removed) {
+    double error = 0;
+    for (const int32_t r : removed) {
+      const glm::dvec3 p = Position(r);
+      double nearest = std::numeric_limits<double>::infinity();
+      uint32_t nearest_triangle = 0;
+      for (const uint32_t *t = adjacency_.begin(from); t != adjacency_.end(from); t++) {
+        if (!alive_[*t]) {
+          continue;
+        }
+        const glm::ivec3 &triangle = mesh_[*t];
+        const double distance2 = TriangleDistance2(p, Position(triangle[0]), Position(triangle[1]), Position(triangle[2]));
+        if (distance2 < nearest) {
+          nearest = distance2;
+          nearest_triangle = *t;
+        }
+      }
+      next_removed_[static_cast<uint64_t>(r)] = first_removed_[nearest_triangle];
+      first_removed_[nearest_triangle] = r;
+      error = std::max(error, nearest);
+    }
+    return std::sqrt(error);
+  }
+
+  const std::vector<glm::vec3> &points_;
+  std::vector<glm::ivec3> &mesh_;
+  std::vector<uint8_t> alive_;
+  std::vector<uint8_t> locked_;
+  std::vector<Quadric> quadrics_;
+  // Removed vertices as a linked list per live triangle, each on the
+  // triangle it was nearest when last moved.
+  std::vector<int32_t> first_removed_;
+  std::vector<int32_t> next_removed_;
+  Adjacency adjacency_;
+  std::vector<Collapse> cache_;
+  std::vector<uint8_t> stale_;
+  glm::dvec3 center_;
+  uint64_t num_alive_ = 0;
+};
+
+}  // namespace
+
+double DecimateMesh(const DecimateOptions &options,
+                    std::vector<glm::vec3> *points,
+                    std::vector<glm::ivec3> *triangles) {
+  const ScopedStage stage("decimate");
+  StatsAdd("decimate_input_triangles", triangles->size());
+  double max_error_made = 0;
+  {
+    Decimator decimator(*points, triangles);
+    uint64_t passes = 0;
+    while (decimator.num_alive() > options.target_triangles) {
+      passes++;
+      if (decimator.Pass(options.target_triangles, options.max_error, &max_error_made) == 0) {
+        break;
+      }
+    }
+    StatsAdd("decimate_passes", passes);
+
+    // Drop dead triangles, then unreferenced vertices, keeping order.
+    const std::vector<uint8_t> &alive = decimator.alive();
+    uint64_t num_kept = 0;
+    for (uint64_t t = 0; t < triangles->size(); t++) {
+      if (alive[t]) {
+        (*triangles)[num_kept++] = (*triangles)[t];
+      }
+    }
+    triangles->resize(num_kept);
+  }
+
+  std::vector<uint8_t> referenced(points->size(), 0);
+  for (const glm::ivec3 &triangle : *triangles) {
+    for (int k = 0; k < 3; k++) {
+      referenced[static_cast<uint64_t>(triangle[k])] = 1;
+    }
+  }
+  std::vector<int32_t> new_index(points->size(), -1);
+  int32_t num_points = 0;
+  for (uint64_t v = 0; v < points->size(); v++) {
+    if (referenced[v]) {
+      new_index[v] = num_points;
+      (*points)[static_cast<uint64_t>(num_points++)] = (*points)[v];
+    }
+  }
+  points->resize(static_cast<uint64_t>(num_points));
+  ParallelFor(triangles->size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t t = begin; t < end; t++) {
+      for (int k = 0; k < 3; k++) {
+        (*triangles)[t][k] = new_index[static_cast<uint64_t>((*triangles)[t][k])];
+      }
+    }
+  });
+
+  StatsAdd("decimate_output_triangles", triangles->size());
+  return max_error_made;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <vector>
+
+struct DecimateOptions {
+  // Stop once the mesh has at most this many triangles. 0 means no limit.
+  uint64_t target_triangles = 0;
+  // Keep every input vertex within this distance of the output surface, in
+  // mesh units.
+  double max_error = std::numeric_limits<double>::infinity();
+};
+
+// Simplify a welded mesh in place by quadric error edge collapse, until it
+// reaches options.target_triangles or every remaining collapse would move the
+// surface more than options.max_error. Returns the largest distance of an
+// input vertex from the output surface, or an upper bound on it.
+//
+// Collapses move a vertex onto a neighbor, so output vertices are a subset of
+// the input vertices. They are made cheapest first by the summed quadrics of
+// both ends, as in Garland and Heckbert. Each removed vertex is kept on the
+// nearest triangle of its neighborhood, and a collapse is only made if every
+// vertex it displaces stays within options.max_error of the new triangles.
+// This bounds the distance at the input vertices, which for a heightmap are
+// the samples, not at points between them. Vertices on the boundary or on
+// non-manifold edges never move, so the boundary is preserved exactly, and
+// collapses that would flip a triangle or make the mesh non-manifold are
+// skipped.
+//
+// Each pass evaluates the best collapse of every vertex in parallel, then
+// applies them cheapest first, skipping any whose neighborhood an earlier
+// collapse in the same pass already changed. Degenerate triangles are dropped
+// and unreferenced vertices are removed; surviving vertices and triangles keep
+// their relative order.
+double DecimateMesh(const DecimateOptions &options,
+                    std::vector<glm::vec3> *points,
+                    std::vector<glm::ivec3> *triangles);
@@ -0,0 +1,57 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/decimate.hpp"
+#include "src/meshtools/mesh_io.hpp"
+#include "src/meshtools/stats.hpp"
+
+// Simplify a mesh to a triangle budget and/or a maximum error, the distance
+// of any input vertex from the output surface in output units. Run it after
+// the output scaling, when the printer tolerance is known. The boundary is
+// kept exactly.
+// Usage: ./decimate_stl input output [--triangles=N] [--max_error=E]
+int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  // Parse flags.
+  if (argc < 4 || argc > 5) {
+    fprintf(stderr, "Usage: ./decimate_stl input output [--triangles=N] [--max_error=E]\n");
+    std::exit(1);
+  }
+  const std::string input_path = argv[1];
+  const std::string output_path = argv[2];
+  DecimateOptions options;
+  for (int32_t k = 3; k < argc; k++) {
+    const std::string arg = argv[k];
+    if (arg.rfind("--triangles=", 0) == 0) {
+      options.target_triangles = std::stoull(arg.substr(12));
+    } else if (arg.rfind("--max_error=", 0) == 0) {
+      options.max_error = std::stod(arg.substr(12));
+    } else {
+      fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+      std::exit(1);
+    }
+  }
+  if (options.target_triangles == 0 && std::isinf(options.max_error)) {
+    fprintf(stderr, "Need --triangles or --max_error, otherwise everything collapses.\n");
+    std::exit(1);
+  }
+
+  // Read inputs.
+  std::vector<glm::vec3> vertices;
+  std::vector<glm::ivec3> triangles;
+  ReadMeshFile(input_path, vertices, triangles);
+  std::cerr << "Loaded " << vertices.size() << " vertices and " << triangles.size() << " triangles from file." << std::endl;
+
+  const double max_error = DecimateMesh(options, &vertices, &triangles);
+  std::cerr << "Decimated to " << vertices.size() << " vertices and " << triangles.size()
+            << " triangles, max error " << max_error << "." << std::endl;
+
+  // Write outputs.
+  WriteMeshFile(output_path, vertices, triangles);
+}
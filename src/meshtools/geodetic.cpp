@@ -0,0 +1,685 @@
+#include "geodetic.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+
+// EGS84 eccentricity.
+static const double wgs84_E = std::sqrt(2 * wgs84_F - wgs84_F * wgs84_F);
+
+glm::dmat3 DcmEcef2Enu(const double lat_rad, const double lon_rad) {
+  double sin_lat = sin(lat_rad);
+  double cos_lat = cos(lat_rad);
+  double sin_lon = sin(lon_rad);
+  double cos_lon = cos(lon_rad);
+  glm::dmat3 dcm_ecef2ned;
+  dcm_ecef2ned[0][0] = -sin_lat * cos_lon;
+  dcm_ecef2ned[1][0] = -sin_lat * sin_lon;
+  dcm_ecef2ned[2][0] = cos_lat;
+  dcm_ecef2ned[0][1] = -sin_lon;
+  dcm_ecef2ned[1][1] = cos_lon;
+  dcm_ecef2ned[2][1] = 0.0;
+  dcm_ecef2ned[0][2] = -cos_lat * cos_lon;
+  dcm_ecef2ned[1][2] = -cos_lat * sin_lon;
+  dcm_ecef2ned[2][2] = -sin_lat;
+
+  glm::dmat3 dcm_ned2enu;
+  dcm_ned2enu[0][0] = 0.0;
+  dcm_ned2enu[1][0] = 1.0;
+  dcm_ned2enu[2][0] = 0.0;
+  dcm_ned2enu[0][1] = 1.0;
+  dcm_ned2enu[1][1] = 0.0;
+  dcm_ned2enu[2][1] = 0.0;
+  dcm_ned2enu[0][2] = 0.0;
+  dcm_ned2enu[1][2] = 0.0;
+  dcm_ned2enu[2][2] = -1.0;
+
+  return dcm_ned2enu * dcm_ecef2ned;
+}
+
+glm::dvec3 Llh2Ecef(const double lat, const double lon, const double height) {
+  const double d = wgs84_E * sin(lat);
+  const double n = wgs84_A / sqrt(1 - d * d);
+
+  glm::dvec3 ecef;
+  ecef[0] = (n + height) * cos(lat) * cos(lon);
+  ecef[1] = (n + height) * cos(lat) * sin(lon);
+  ecef[2] = ((1 - wgs84_E * wgs84_E) * n + height) * sin(lat);
+
+  return ecef;
+}
+
+std::pair<double, double> Llh2Gnomonic(const double lat_rad, const double lon_rad, const double center_lat_rad, const double center_lon_rad) {
+  const double cos_dlon = cos(lon_rad - center_lon_rad);
+  const double sin_dlon = sin(lon_rad - center_lon_rad);
+  const double sin_lat0 = sin(center_lat_rad);
+  const double cos_lat0 = cos(center_lat_rad);
+  const double sin_lat = sin(lat_rad);
+  const double cos_lat = cos(lat_rad);
+
+  const double cos_c = sin_lat0 * sin_lat + cos_lat0 * cos_lat * cos_dlon;
+  const double x = (cos_lat * sin_dlon) / cos_c;
+  const double y = (cos_lat0 * sin_lat - sin_lat0 * cos_lat * cos_dlon) / cos_c;
+  return std::pair<double, double>(x, y);
+}
+
+// Snyder 15-9 with the hemisphere folded in: pole is 1 for north, -1 for
+// south.
+static double PolarStereographicT(const double lat_rad, const double pole) {
+  const double lat = pole * lat_rad;
+  const double e_sin_lat = wgs84_E * sin(lat);
+  return tan(M_PI / 4 - lat / 2) / pow((1 - e_sin_lat) / (1 + e_sin_lat), wgs84_E / 2);
+}
+
+std::pair<double, double> Llh2PolarStereographic(const double lat_rad, const double lon_rad, const double center_lat_rad, const double center_lon_rad) {
+  const double pole = center_lat_rad < 0 ? -1.0 : 1.0;
+  const double sin_lat_c = sin(center_lat_rad);
+  const double m_c = cos(center_lat_rad) / sqrt(1 - wgs84_E * wgs84_E * sin_lat_c * sin_lat_c);
+  auto rho_of = [&](const double lat) {
+    const double t = PolarStereographicT(lat, pole);
+    // True scale at the pole itself has m_c = t_c = 0.
+    if (m_c < 1e-9) {
+      return 2 * wgs84_A * t / sqrt(pow(1 + wgs84_E, 1 + wgs84_E) * pow(1 - wgs84_E, 1 - wgs84_E));
+    }
+    return wgs84_A * m_c * t / PolarStereographicT(center_lat_rad, pole);
+  };
+  const double rho = rho_of(lat_rad);
+  const double rho_c = rho_of(center_lat_rad);
+  const double x = rho * sin(lon_rad - center_lon_rad);
+  const double y = -pole * (rho * cos(lon_rad - center_lon_rad) - rho_c);
+  return std::pair<double, double>(x, y);
+}
+
+// Meridian arc length from the equator, Snyder 3-21.
+static double MeridianArc(const double lat_rad) {
+  const double e2 = wgs84_E * wgs84_E;
+  const double e4 = e2 * e2;
+  const double e6 = e4 * e2;
+  return wgs84_A * ((1 - e2 / 4 - 3 * e4 / 64 - 5 * e6 / 256) * lat_rad -
+                    (3 * e2 / 8 + 3 * e4 / 32 + 45 * e6 / 1024) * sin(2 * lat_rad) +
+                    (15 * e4 / 256 + 45 * e6 / 1024) * sin(4 * lat_rad) -
+                    (35 * e6 / 3072) * sin(6 * lat_rad));
+}
+
+std::pair<double, double> Llh2TransverseMercator(const double lat_rad, const double lon_rad, const double center_lat_rad, const double center_lon_rad) {
+  const double e2 = wgs84_E * wgs84_E;
+  const double ep2 = e2 / (1 - e2);
+  const double sin_lat = sin(lat_rad);
+  const double cos_lat = cos(lat_rad);
+  const double tan_lat = tan(lat_rad);
+  const double n = wgs84_A / sqrt(1 - e2 * sin_lat * sin_lat);
+  const double t = tan_lat * tan_lat;
+  const double c = ep2 * cos_lat * cos_lat;
+  const double a = (lon_rad - center_lon_rad) * cos_lat;
+
+  const double x = n * (a + (1 - t + c) * pow(a, 3) / 6 +
+                        (5 - 18 * t + t * t + 72 * c - 58 * ep2) * pow(a, 5) / 120);
+  const double y = MeridianArc(lat_rad) - MeridianArc(center_lat_rad) +
+                   n * tan_lat * (a * a / 2 + (5 - t + 9 * c + 4 * c * c) * pow(a, 4) / 24 +
+                                  (61 - 58 * t + t * t + 600 * c - 330 * ep2) * pow(a, 6) / 720);
+  return std::pair<double, double>(x, y);
+}
+
+namespace {
+
+// Vertices per batch. Every per-lane loop below has this fixed trip count and
+// no branches, so the compiler turns it into packed double arithmetic. The
+// kernels capture by value so the lanes cannot alias their constants.
+constexpr uint64_t kLanes = 8;
+
+// Branch-free sin and cos, accurate to about 1 double ULP for |x| < 1e5.
+// Cody-Waite reduction by pi/2 followed by the fdlibm kernel polynomials.
+inline void SinCos(const double x, double *sin_x, double *cos_x) {
+  constexpr double kTwoOverPi = 6.36619772367581382433e-01;
+  constexpr double kPio2Hi = 1.57079632673412561417e+00;
+  constexpr double kPio2Lo = 6.07710050650619224932e-11;
+  // Adding and subtracting 1.5 * 2^52 rounds to the nearest integer.
+  constexpr double kRound = 6755399441055744.0;
+  const double q = (x * kTwoOverPi + kRound) - kRound;
+  const double r = (x - q * kPio2Hi) - q * kPio2Lo;
+  const double z = r * r;
+
+  const double s = r + r * z * (-1.66666666666666324348e-01 +
+                   z * (8.33333333332248946124e-03 +
+                   z * (-1.98412698298579493134e-04 +
+                   z * (2.75573137070700676789e-06 +
+                   z * (-2.50507602534068634195e-08 +
+                   z * 1.58969099521155010221e-10)))));
+  const double c = 1.0 - 0.5 * z + z * z * (4.16666666666666019037e-02 +
+                   z * (-1.38888888888741095749e-03 +
+                   z * (2.48015872894767294178e-05 +
+                   z * (-2.75573143513906633035e-07 +
+                   z * (2.08757232129817482790e-09 +
+                   z * -1.13596475577881948265e-11)))));
+
+  // Rotate by the quadrant.
+  const int32_t quadrant = static_cast<int32_t>(q) & 3;
+  const double sin_r = (quadrant & 1) ? c : s;
+  const double cos_r = (quadrant & 1) ? s : c;
+  *sin_x = (quadrant & 2) ? -sin_r : sin_r;
+  *cos_x = ((quadrant + 1) & 2) ? -cos_r : cos_r;
+}
+
+struct Lanes {
+  double x[kLanes];
+  double y[kLanes];
+  double z[kLanes];
+};
+
+// hmm only emits vertices on the raster pixel grid, and latitude depends only
+// on y while longitude depends only on x. This tabulates kTerms values that
+// are a function of one pixel coordinate at every integer pixel in [0, n], so
+// on-grid vertices need no trig at all.
+template <uint64_t kTerms>
+struct PixelTable {
+  std::vector<double> terms;
+  uint64_t size = 0;
+
+  // `terms_of(angle, sin, cos, terms)` fills the terms of one pixel from its
+  // angle. Tables are skipped for rasters too large to be worth tabulating.
+  template <typename Angle, typename TermsOf>
+  PixelTable(const int32_t n, const Angle &angle, const TermsOf &terms_of) {
+    if (n <= 0 || n > (1 << 26)) {
+      return;
+    }
+    size = static_cast<uint64_t>(n) + 1;
+    terms.resize(size * kTerms);
+    ParallelFor(size, 1 << 12, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+      for (uint64_t pixel = begin; pixel < end; pixel++) {
+        const double a = angle(static_cast<double>(pixel));
+        double pixel_terms[kTerms];
+        terms_of(a, std::sin(a), std::cos(a), pixel_terms);
+        for (uint64_t j = 0; j < kTerms; j++) {
+          terms[j * size + pixel] = pixel_terms[j];
+        }
+      }
+    });
+  }
+
+  // Table index of every lane, or false if any lane is off the grid.
+  bool Indices(const double pixels[kLanes], uint64_t indices[kLanes]) const {
+    const double n = static_cast<double>(size) - 1.0;
+    for (uint64_t i = 0; i < kLanes; i++) {
+      if (!(pixels[i] >= 0.0 && pixels[i] <= n)) {
+        return false;
+      }
+      indices[i] = static_cast<uint64_t>(pixels[i]);
+      if (static_cast<double>(indices[i]) != pixels[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// Run `kernel` over all points in batches of kLanes, in parallel, and return
+// the bounds of the float results.
+template <typename Kernel>
+Bounds TransformBatched(std::vector<glm::vec3> *points, const Kernel &kernel) {
+  const uint64_t num_points = points->size();
+  const uint32_t num_chunks = NumThreads();
+  std::vector<Bounds> chunk_bounds(num_chunks);
+  const double inf = std::numeric_limits<double>::infinity();
+  for (Bounds &bounds : chunk_bounds) {
+    bounds.min = glm::dvec3(inf, inf, inf);
+    bounds.max = glm::dvec3(-inf, -inf, -inf);
+  }
+
+  ParallelForChunks(num_points, num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    Bounds &bounds = chunk_bounds[chunk];
+    glm::vec3 *data = points->data();
+    for (uint64_t batch = begin; batch < end; batch += kLanes) {
+      const uint64_t count = std::min(kLanes, end - batch);
+      // Gather, padding a partial batch with copies of its first point.
+      Lanes lanes;
+      for (uint64_t i = 0; i < kLanes; i++) {
+        const glm::vec3 &point = data[batch + (i < count ? i : 0)];
+        lanes.x[i] = static_cast<double>(point.x);
+        lanes.y[i] = static_cast<double>(point.y);
+        lanes.z[i] = static_cast<double>(point.z);
+      }
+      kernel(&lanes);
+      for (uint64_t i = 0; i < count; i++) {
+        glm::vec3 &point = data[batch + i];
+        point.x = static_cast<float>(lanes.x[i]);
+        point.y = static_cast<float>(lanes.y[i]);
+        point.z = static_cast<float>(lanes.z[i]);
+        for (int k = 0; k < 3; k++) {
+          bounds.min[k] = std::min(bounds.min[k], static_cast<double>(point[k]));
+          bounds.max[k] = std::max(bounds.max[k], static_cast<double>(point[k]));
+        }
+      }
+    }
+  });
+
+  Bounds bounds = chunk_bounds[0];
+  for (const Bounds &other : chunk_bounds) {
+    bounds.min = glm::min(bounds.min, other.min);
+    bounds.max = glm::max(bounds.max, other.max);
+  }
+  return bounds;
+}
+
+// The projection engine. A projection policy splits its math into terms that
+// depend only on latitude, terms that depend only on longitude, and the
+// per-vertex combination of the two with height:
+//
+//   static constexpr bool kGeographic;  // Pixel fields in degrees, else meters.
+//   static constexpr uint64_t kRowTerms, kColumnTerms;
+//   double central_lon;  // Subtracted from each column's longitude.
+//   void RowTerms(double lat, double sin_lat, double cos_lat, double *terms) const;
+//   void ColumnTerms(double dlon, double sin_dlon, double cos_dlon, double *terms) const;
+//   void Project(const double row[][kLanes], const double column[][kLanes], uint64_t i,
+//                double height, double *x, double *y, double *z) const;
+//
+// Project reads term j of lane i as row[j][i], so the terms stay SoA. The
+// policy is a template argument captured by value, so Project inlines into
+// the per-lane loop and its constants stay in registers.
+//
+// The tables are built once here, and the returned function projects any
+// number of point sets with them.
+template <typename Projection>
+std::function<Bounds(std::vector<glm::vec3> *)> BatchedProjection(const HeightmapGeoreference &georeference,
+                                                                  const Projection &projection) {
+  auto to_radians = [](const double value) { return Projection::kGeographic ? value * M_PI / 180. : value; };
+  const double lon0 = to_radians(georeference.lon0_deg);
+  const double lat0 = to_radians(georeference.lat0_deg);
+  const double dlon_dpixel = to_radians(georeference.dlon_deg_dpixel);
+  const double dlat_dpixel = to_radians(georeference.dlat_deg_dpixel);
+  const double latF = lat0 + dlat_dpixel * static_cast<double>(georeference.n_lat);
+  const double central_lon = projection.central_lon;
+  const double min_height = georeference.min_height;
+  const double height_range = georeference.max_height - georeference.min_height;
+  const double z_exag = georeference.z_exag;
+
+  auto lat_of_row = [=](const double y) { return latF - dlat_dpixel * y; };
+  auto dlon_of_column = [=](const double x) { return (lon0 + dlon_dpixel * x) - central_lon; };
+  auto row_terms = [&](const double lat, const double sin_lat, const double cos_lat, double *terms) {
+    projection.RowTerms(lat, sin_lat, cos_lat, terms);
+  };
+  auto column_terms = [&](const double dlon, const double sin_dlon, const double cos_dlon, double *terms) {
+    projection.ColumnTerms(dlon, sin_dlon, cos_dlon, terms);
+  };
+  const auto row_table =
+      std::make_shared<const PixelTable<Projection::kRowTerms>>(georeference.n_lat, lat_of_row, row_terms);
+  const auto column_table =
+      std::make_shared<const PixelTable<Projection::kColumnTerms>>(georeference.n_lon, dlon_of_column, column_terms);
+
+  const auto kernel = [=](Lanes *lanes) {
+    double row[Projection::kRowTerms][kLanes], column[Projection::kColumnTerms][kLanes];
+    uint64_t rows[kLanes], columns[kLanes];
+    if (row_table->Indices(lanes->y, rows) && column_table->Indices(lanes->x, columns)) {
+      for (uint64_t j = 0; j < Projection::kRowTerms; j++) {
+        for (uint64_t i = 0; i < kLanes; i++) {
+          row[j][i] = row_table->terms[j * row_table->size + rows[i]];
+        }
+      }
+      for (uint64_t j = 0; j < Projection::kColumnTerms; j++) {
+        for (uint64_t i = 0; i < kLanes; i++) {
+          column[j][i] = column_table->terms[j * column_table->size + columns[i]];
+        }
+      }
+    } else {
+      for (uint64_t i = 0; i < kLanes; i++) {
+        double sin_a, cos_a, terms[std::max(Projection::kRowTerms, Projection::kColumnTerms)];
+        const double lat = lat_of_row(lanes->y[i]);
+        SinCos(lat, &sin_a, &cos_a);
+        projection.RowTerms(lat, sin_a, cos_a, terms);
+        for (uint64_t j = 0; j < Projection::kRowTerms; j++) {
+          row[j][i] = terms[j];
+        }
+        const double dlon = dlon_of_column(lanes->x[i]);
+        SinCos(dlon, &sin_a, &cos_a);
+        projection.ColumnTerms(dlon, sin_a, cos_a, terms);
+        for (uint64_t j = 0; j < Projection::kColumnTerms; j++) {
+          column[j][i] = terms[j];
+        }
+      }
+    }
+    // A local copy of the policy and the heights computed up front, so the
+    // stores to the lanes cannot alias the constants or later loads.
+    const Projection local = projection;
+    double height[kLanes];
+    for (uint64_t i = 0; i < kLanes; i++) {
+      height[i] = z_exag * (min_height + height_range * lanes->z[i]);
+    }
+    for (uint64_t i = 0; i < kLanes; i++) {
+      local.Project(row, column, i, height[i], &lanes->x[i], &lanes->y[i], &lanes->z[i]);
+    }
+  };
+  return [kernel](std::vector<glm::vec3> *points) { return TransformBatched(points, kernel); };
+}
+
+// ECEF relative to the center, rotated into the center's ENU frame.
+struct EnuProjection {
+  static constexpr bool kGeographic = true;
+  // sin and cos of latitude and the prime vertical radius.
+  static constexpr uint64_t kRowTerms = 3;
+  static constexpr uint64_t kColumnTerms = 2;
+  double central_lon = 0;
+  double e = wgs84_E;
+  glm::dvec3 ref;
+  glm::dmat3 dcm;
+
+  void RowTerms(double, const double sin_lat, const double cos_lat, double *terms) const {
+    const double d = e * sin_lat;
+    terms[0] = sin_lat;
+    terms[1] = cos_lat;
+    terms[2] = wgs84_A / std::sqrt(1 - d * d);
+  }
+  void ColumnTerms(double, const double sin_lon, const double cos_lon, double *terms) const {
+    terms[0] = sin_lon;
+    terms[1] = cos_lon;
+  }
+  void Project(const double row[][kLanes], const double column[][kLanes], const uint64_t i, const double height,
+               double *x, double *y, double *z) const {
+    const double e2 = e * e;
+    const double n = row[2][i];
+    const double ecef_x = (n + height) * row[1][i] * column[1][i] - ref.x;
+    const double ecef_y = (n + height) * row[1][i] * column[0][i] - ref.y;
+    const double ecef_z = ((1 - e2) * n + height) * row[0][i] - ref.z;
+    *x = dcm[0][0] * ecef_x + dcm[1][0] * ecef_y + dcm[2][0] * ecef_z;
+    *y = dcm[0][1] * ecef_x + dcm[1][1] * ecef_y + dcm[2][1] * ecef_z;
+    *z = dcm[0][2] * ecef_x + dcm[1][2] * ecef_y + dcm[2][2] * ecef_z;
+  }
+};
+
+struct GnomonicProjection {
+  static constexpr bool kGeographic = true;
+  static constexpr uint64_t kRowTerms = 2;
+  static constexpr uint64_t kColumnTerms = 2;
+  double central_lon = 0;
+  double sin_lat0 = 0;
+  double cos_lat0 = 1;
+  double lat_extent_in_meters = 1;
+
+  void RowTerms(double, const double sin_lat, const double cos_lat, double *terms) const {
+    terms[0] = sin_lat;
+    terms[1] = cos_lat;
+  }
+  void ColumnTerms(double, const double sin_dlon, const double cos_dlon, double *terms) const {
+    terms[0] = sin_dlon;
+    terms[1] = cos_dlon;
+  }
+  void Project(const double row[][kLanes], const double column[][kLanes], const uint64_t i, const double height,
+               double *x, double *y, double *z) const {
+    const double cos_c = sin_lat0 * row[0][i] + cos_lat0 * row[1][i] * column[1][i];
+    *z = height / lat_extent_in_meters;
+    *x = (row[1][i] * column[0][i]) / cos_c;
+    *y = (cos_lat0 * row[0][i] - sin_lat0 * row[1][i] * column[1][i]) / cos_c;
+  }
+};
+
+// Easting and northing of a projected raster, relative to a reference point
+// near the raster center so the float output keeps its precision.
+struct NedProjection {
+  static constexpr bool kGeographic = false;
+  static constexpr uint64_t kRowTerms = 1;
+  static constexpr uint64_t kColumnTerms = 1;
+  // The reference easting.
+  double central_lon = 0;
+  double central_northing = 0;
+
+  void RowTerms(const double northing, double, double, double *terms) const {
+    terms[0] = northing - central_northing;
+  }
+  void ColumnTerms(const double easting, double, double, double *terms) const { terms[0] = easting; }
+  void Project(const double row[][kLanes], const double column[][kLanes], const uint64_t i, const double height,
+               double *x, double *y, double *z) const {
+    *x = column[0][i];
+    *y = row[0][i];
+    *z = height;
+  }
+};
+
+// exp(e * atanh(e * x)) for |x| <= 1 without libm: e * x < 0.082, so atanh
+// needs terms to x^13 and the exponent is below 0.007, where seven terms of
+// exp are exact to double precision.
+inline double ConformalLatitudeFactor(const double e, const double x) {
+  const double u = e * x;
+  const double u2 = u * u;
+  const double atanh_u = u * (1 + u2 * (1. / 3 + u2 * (1. / 5 + u2 * (1. / 7 + u2 * (1. / 9 + u2 * (1. / 11 + u2 / 13))))));
+  const double a = e * atanh_u;
+  return 1 + a * (1 + a * (1. / 2 + a * (1. / 6 + a * (1. / 24 + a * (1. / 120 + a / 720)))));
+}
+
+// Snyder's t of 15-9 is tan(pi/4 - lat/2) / ((1 - e sin) / (1 + e sin))^(e/2),
+// which is cos / (1 + sin) * ConformalLatitudeFactor(sin), so the row terms
+// need no trig beyond the table's sin and cos.
+struct PolarStereographicProjection {
+  static constexpr bool kGeographic = true;
+  // rho, the distance from the pole.
+  static constexpr uint64_t kRowTerms = 1;
+  static constexpr uint64_t kColumnTerms = 2;
+  double central_lon = 0;
+  double e = wgs84_E;
+  // 1 for the north pole, -1 for the south pole.
+  double pole = 1;
+  // rho = rho_per_t * t.
+  double rho_per_t = 0;
+  double rho_center = 0;
+
+  double T(const double sin_lat, const double cos_lat) const {
+    const double sin_pole_lat = pole * sin_lat;
+    return cos_lat / (1 + sin_pole_lat) * ConformalLatitudeFactor(e, sin_pole_lat);
+  }
+  void RowTerms(double, const double sin_lat, const double cos_lat, double *terms) const {
+    terms[0] = rho_per_t * T(sin_lat, cos_lat);
+  }
+  void ColumnTerms(double, const double sin_dlon, const double cos_dlon, double *terms) const {
+    terms[0] = sin_dlon;
+    terms[1] = cos_dlon;
+  }
+  void Project(const double row[][kLanes], const double column[][kLanes], const uint64_t i, const double height,
+               double *x, double *y, double *z) const {
+    *x = row[0][i] * column[0][i];
+    *y = pole * (rho_center - row[0][i] * column[1][i]);
+    *z = height;
+  }
+};
+
+// Snyder's series with every latitude-only factor in the row terms, so a
+// vertex costs two short polynomials in A = dlon * cos(lat). tan(lat) only
+// appears as tan^2(lat) times A^2 or more, so the poles stay finite.
+struct TransverseMercatorProjection {
+  static constexpr bool kGeographic = true;
+  static constexpr uint64_t kRowTerms = 8;
+  static constexpr uint64_t kColumnTerms = 1;
+  double central_lon = 0;
+  double e = wgs84_E;
+  // Meridian arc at the center latitude.
+  double m0 = 0;
+
+  void RowTerms(const double lat, const double sin_lat, const double cos_lat, double *terms) const {
+    const double e2 = e * e;
+    const double e4 = e2 * e2;
+    const double e6 = e4 * e2;
+    const double ep2 = e2 / (1 - e2);
+    const double n = wgs84_A / std::sqrt(1 - e2 * sin_lat * sin_lat);
+    const double cos2 = cos_lat * cos_lat;
+    const double t = sin_lat * sin_lat / std::max(cos2, 1e-300);
+    const double c = ep2 * cos2;
+    // Multiple angle sines for the meridian arc.
+    const double sin_2lat = 2 * sin_lat * cos_lat;
+    const double cos_2lat = cos2 - sin_lat * sin_lat;
+    const double sin_4lat = 2 * sin_2lat * cos_2lat;
+    const double sin_6lat = sin_2lat * (3 - 4 * sin_2lat * sin_2lat);
+    const double m = wgs84_A * ((1 - e2 / 4 - 3 * e4 / 64 - 5 * e6 / 256) * lat -
+                                (3 * e2 / 8 + 3 * e4 / 32 + 45 * e6 / 1024) * sin_2lat +
+                                (15 * e4 / 256 + 45 * e6 / 1024) * sin_4lat -
+                                (35 * e6 / 3072) * sin_6lat);
+    terms[0] = cos_lat;
+    terms[1] = n;
+    terms[2] = (1 - t + c) / 6;
+    terms[3] = (5 - 18 * t + t * t + 72 * c - 58 * ep2) / 120;
+    terms[4] = m - m0;
+    // n * tan(lat) * cos^2(lat), the A^2 coefficient per dlon^2.
+    terms[5] = n * sin_lat * cos_lat;
+    terms[6] = (5 - t + 9 * c + 4 * c * c) / 24;
+    terms[7] = (61 - 58 * t + t * t + 600 * c - 330 * ep2) / 720;
+  }
+  void ColumnTerms(const double dlon, double, double, double *terms) const { terms[0] = dlon; }
+  void Project(const double row[][kLanes], const double column[][kLanes], const uint64_t i, const double height,
+               double *x, double *y, double *z) const {
+    const double dlon = column[0][i];
+    const double a = dlon * row[0][i];
+    const double a2 = a * a;
+    *x = row[1][i] * a * (1 + a2 * (row[2][i] + a2 * row[3][i]));
+    *y = row[4][i] + row[5][i] * dlon * dlon * (0.5 + a2 * (row[6][i] + a2 * row[7][i]));
+    *z = height;
+  }
+};
+
+// The stats stage of projecting a whole mesh.
+const char *ProjectionStageName(const OutputScaling output_scaling) {
+  switch (output_scaling) {
+    case OutputScaling::kEnu:
+      return "heightmap_to_enu";
+    case OutputScaling::kGnomonic:
+      return "heightmap_to_gnomonic";
+    case OutputScaling::kNed:
+      return "heightmap_to_ned";
+    case OutputScaling::kPolarStereographic:
+      return "heightmap_to_polar_stereographic";
+    case OutputScaling::kTransverseMercator:
+      return "heightmap_to_transverse_mercator";
+    default:
+      return "heightmap_to_unknown";
+  }
+}
+
+}  // namespace
+
+OutputScaling ParseOutputScaling(const std::string &name) {
+  for (const OutputScaling output_scaling :
+       {OutputScaling::kEnu, OutputScaling::kGnomonic, OutputScaling::kNed, OutputScaling::kPolarStereographic,
+        OutputScaling::kTransverseMercator}) {
+    if (name == OutputScalingName(output_scaling)) {
+      return output_scaling;
+    }
+  }
+  fprintf(stderr, "Unknown output_scaling: %s\n", name.c_str());
+  std::exit(1);
+}
+
+const char *OutputScalingName(const OutputScaling output_scaling) {
+  switch (output_scaling) {
+    case OutputScaling::kEnu:
+      return "llh2ecef";
+    case OutputScaling::kGnomonic:
+      return "llh2gnomonic";
+    case OutputScaling::kNed:
+      return "ned";
+    case OutputScaling::kPolarStereographic:
+      return "polar_stereographic";
+    case OutputScaling::kTransverseMercator:
+      return "transverse_mercator";
+    default:
+      return "unknown";
+  }
+}
+
+HeightmapProjection::HeightmapProjection(const OutputScaling output_scaling,
+                                         const HeightmapGeoreference &georeference,
+                                         const double center_lat_deg,
+                                         const double center_lon_deg) {
+  const ScopedStage stage("build_projection");
+  const double center_lat = center_lat_deg * M_PI / 180.;
+  const double center_lon = center_lon_deg * M_PI / 180.;
+  switch (output_scaling) {
+    case OutputScaling::kEnu: {
+      EnuProjection projection;
+      projection.ref = Llh2Ecef(center_lat, center_lon, 0.);
+      projection.dcm = DcmEcef2Enu(center_lat, center_lon);
+      apply_ = BatchedProjection(georeference, projection);
+      return;
+    }
+    case OutputScaling::kGnomonic: {
+      GnomonicProjection projection;
+      projection.central_lon = georeference.CenterLonDeg() * M_PI / 180.0;
+      projection.sin_lat0 = sin(georeference.CenterLatDeg() * M_PI / 180.0);
+      projection.cos_lat0 = cos(georeference.CenterLatDeg() * M_PI / 180.0);
+      const double lat0 = georeference.lat0_deg * M_PI / 180.;
+      const double latF = lat0 + georeference.dlat_deg_dpixel * M_PI / 180. * static_cast<double>(georeference.n_lat);
+      projection.lat_extent_in_meters = wgs84_A * (latF - lat0);
+      apply_ = BatchedProjection(georeference, projection);
+      return;
+    }
+    case OutputScaling::kNed: {
+      NedProjection projection;
+      projection.central_lon = georeference.CenterLonDeg();
+      projection.central_northing = georeference.CenterLatDeg();
+      apply_ = BatchedProjection(georeference, projection);
+      return;
+    }
+    case OutputScaling::kPolarStereographic: {
+      PolarStereographicProjection projection;
+      projection.central_lon = center_lon;
+      projection.pole = center_lat < 0 ? -1.0 : 1.0;
+      const double sin_lat_c = sin(center_lat);
+      const double cos_lat_c = cos(center_lat);
+      const double m_c = cos_lat_c / sqrt(1 - wgs84_E * wgs84_E * sin_lat_c * sin_lat_c);
+      if (m_c < 1e-9) {
+        projection.rho_per_t =
+            2 * wgs84_A / sqrt(pow(1 + wgs84_E, 1 + wgs84_E) * pow(1 - wgs84_E, 1 - wgs84_E));
+      } else {
+        projection.rho_per_t = wgs84_A * m_c / projection.T(sin_lat_c, cos_lat_c);
+      }
+      projection.rho_center = projection.rho_per_t * projection.T(sin_lat_c, cos_lat_c);
+      apply_ = BatchedProjection(georeference, projection);
+      return;
+    }
+    case OutputScaling::kTransverseMercator: {
+      TransverseMercatorProjection projection;
+      projection.central_lon = center_lon;
+      double center_terms[TransverseMercatorProjection::kRowTerms];
+      projection.RowTerms(center_lat, sin(center_lat), cos(center_lat), center_terms);
+      projection.m0 = center_terms[4];
+      apply_ = BatchedProjection(georeference, projection);
+      return;
+    }
+    default:
+      fprintf(stderr, "Unknown output_scaling %d\n", static_cast<int32_t>(output_scaling));
+      std::exit(1);
+  }
+}
+
+Bounds HeightmapProjection::Apply(std::vector<glm::vec3> *points) const {
+  StatsAdd("points_transformed", points->size());
+  return apply_(points);
+}
+
+Bounds ProjectHeightmap(const OutputScaling output_scaling,
+                        const HeightmapGeoreference &georeference,
+                        const double center_lat_deg,
+                        const double center_lon_deg,
+                        std::vector<glm::vec3> *points) {
+  const ScopedStage stage(ProjectionStageName(output_scaling));
+  return HeightmapProjection(output_scaling, georeference, center_lat_deg, center_lon_deg).Apply(points);
+}
+
+void ScaleToTargetSize(const OutputScaling output_scaling,
+                       const Bounds &bounds,
+                       const double target_size,
+                       std::vector<glm::vec3> *points) {
+  const ScopedStage stage("scale_to_target_size");
+  const float scale_factor = static_cast<float>(target_size / std::min(bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y));
+  glm::vec3 origin(0.0f, 0.0f, static_cast<float>(bounds.min.z));
+  if (output_scaling == OutputScaling::kNed) {
+    origin.x = static_cast<float>(0.5 * (bounds.min.x + bounds.max.x));
+    origin.y = static_cast<float>(0.5 * (bounds.min.y + bounds.max.y));
+  }
+  glm::vec3 *data = points->data();
+  ParallelFor(points->size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t i = begin; i < end; i++) {
+      data[i] -= origin;
+      data[i] *= scale_factor;
+    }
+  });
+}
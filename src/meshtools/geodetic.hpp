@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+// WGS84 equitorial radius.
+constexpr double wgs84_A = 6378137.0;
+
+// WGS84 flattening term.
+constexpr double wgs84_F = 1 / 298.257223563;
+
+// Maps an unscaled hmm mesh to geographic coordinates. Vertex x and y are
+// pixel coordinates of the source raster and z is height normalized to [0, 1].
+// For rasters already in a projected CRS, as used with ned, the lon/lat fields
+// hold easting and northing in meters instead of degrees.
+struct HeightmapGeoreference {
+  double lon0_deg = 0;
+  double dlon_deg_dpixel = 0;
+  double lat0_deg = 0;
+  double dlat_deg_dpixel = 0;
+  int32_t n_lon = 0;
+  int32_t n_lat = 0;
+  double min_height = 0;
+  double max_height = 0;
+  double z_exag = 1;
+
+  double CenterLatDeg() const { return lat0_deg + 0.5 * dlat_deg_dpixel * static_cast<double>(n_lat); }
+  double CenterLonDeg() const { return lon0_deg + 0.5 * dlon_deg_dpixel * static_cast<double>(n_lon); }
+};
+
+// Bounding box of transformed points, taken after rounding to float.
+struct Bounds {
+  glm::dvec3 min;
+  glm::dvec3 max;
+};
+
+// Scalar reference transforms. These are the exact per-point math that the
+// batched transforms below are checked against.
+glm::dmat3 DcmEcef2Enu(double lat_rad, double lon_rad);
+glm::dvec3 Llh2Ecef(double lat, double lon, double height);
+std::pair<double, double> Llh2Gnomonic(double lat_rad, double lon_rad, double center_lat_rad, double center_lon_rad);
+// Ellipsoidal polar stereographic (Snyder 21-33 and 21-34) about the pole on
+// the side of center_lat_rad, true to scale at center_lat_rad, in meters
+// relative to the center point.
+std::pair<double, double> Llh2PolarStereographic(double lat_rad, double lon_rad, double center_lat_rad, double center_lon_rad);
+// Ellipsoidal transverse Mercator (Snyder 8-9 and 8-10) with scale 1 on the
+// central meridian center_lon_rad, in meters relative to the center point.
+std::pair<double, double> Llh2TransverseMercator(double lat_rad, double lon_rad, double center_lat_rad, double center_lon_rad);
+
+// The output_scaling of a terrain, named as in pipeline.bzl.
+enum class OutputScaling {
+  // Local ENU frame in meters, via ECEF.
+  kEnu,
+  // Gnomonic, in earth radii, with height scaled by the latitude extent of the
+  // raster in meters. Always about the raster center.
+  kGnomonic,
+  // Raster already in meters, e.g. polar stereographic source data. Centered
+  // on the mesh bounds.
+  kNed,
+  kPolarStereographic,
+  kTransverseMercator,
+};
+
+// "llh2ecef", "llh2gnomonic", "ned", "polar_stereographic" or
+// "transverse_mercator". Exits on anything else.
+OutputScaling ParseOutputScaling(const std::string &name);
+const char *OutputScalingName(OutputScaling output_scaling);
+
+// Project an unscaled hmm mesh in place. The ENU, polar stereographic and
+// transverse Mercator projections are about (center_lat_deg, center_lon_deg),
+// normally the raster center, and give meters with height as z.
+//
+// There is one batched engine, instantiated per projection, so each inner
+// loop is inlined with no dispatch. Vertices are processed in batches of SoA
+// double lanes across all threads. Batches whose vertices all lie on the
+// integer pixel grid, which is every batch for hmm output, read everything
+// that depends only on the row (latitude) or only on the column (longitude)
+// from per-pixel tables, leaving plain arithmetic per vertex. Other batches
+// use a polynomial sin/cos. Against the scalar references above each output
+// coordinate differs by at most kTransformMaxUlp float ULPs of the largest
+// coordinate magnitude after output scaling, checked by geodetic_test.
+Bounds ProjectHeightmap(OutputScaling output_scaling,
+                        const HeightmapGeoreference &georeference,
+                        double center_lat_deg,
+                        double center_lon_deg,
+                        std::vector<glm::vec3> *points);
+
+// ProjectHeightmap split in two, for projecting a mesh in pieces: the
+// constructor builds the per-pixel tables once, and Apply projects one set
+// of points in place with them and returns their bounds.
+class HeightmapProjection {
+ public:
+  HeightmapProjection(OutputScaling output_scaling,
+                      const HeightmapGeoreference &georeference,
+                      double center_lat_deg,
+                      double center_lon_deg);
+
+  Bounds Apply(std::vector<glm::vec3> *points) const;
+
+ private:
+  std::function<Bounds(std::vector<glm::vec3> *)> apply_;
+};
+
+constexpr uint32_t kTransformMaxUlp = 4;
+
+// Final output scaling of projected points, given their bounds: shift the
+// lowest point to z = 0, center x and y for ned, and scale so the shorter of
+// the x and y sides is target_size. The shortest side sets the size because
+// wood comes in long boards and the longest side is assumed to fit.
+void ScaleToTargetSize(OutputScaling output_scaling,
+                       const Bounds &bounds,
+                       double target_size,
+                       std::vector<glm::vec3> *points);
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <glm/glm.hpp>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/geodetic.hpp"
+
+// Check the projection engine against scalar reference loops, including the
+// ones llh2ecef and llh2gnomonic used, on synthetic hmm-like meshes.
+
+static std::vector<glm::vec3> SyntheticHeightmapPoints(const HeightmapGeoreference &georeference) {
+  std::mt19937_64 rng(0);
+  std::uniform_real_distribution<float> height(0.0f, 1.0f);
+  std::vector<glm::vec3> points;
+  for (int32_t y = 0; y <= georeference.n_lat; y += 7) {
+    for (int32_t x = 0; x <= georeference.n_lon; x += 5) {
+      points.push_back({static_cast<float>(x), static_cast<float>(y), height(rng)});
+    }
+  }
+  // Off-grid vertices, which take the polynomial path.
+  for (int32_t y = 0; y < georeference.n_lat; y += 13) {
+    for (int32_t x = 0; x < georeference.n_lon; x += 11) {
+      points.push_back({static_cast<float>(x) + 0.25f, static_cast<float>(y) + 0.5f, height(rng)});
+    }
+  }
+  // Exact corners and extremes of z.
+  points.push_back({0.0f, 0.0f, 0.0f});
+  points.push_back({static_cast<float>(georeference.n_lon), static_cast<float>(georeference.n_lat), 1.0f});
+  return points;
+}
+
+static Bounds ReferenceEnu(const HeightmapGeoreference &georeference, std::vector<glm::vec3> *points) {
+  const double center_lat_deg = georeference.CenterLatDeg();
+  const double center_lon_deg = georeference.CenterLonDeg();
+  const glm::dvec3 ref_ecef = Llh2Ecef(center_lat_deg * M_PI / 180., center_lon_deg * M_PI / 180., 0.);
+  const glm::dmat3 dcm_ecef2enu = DcmEcef2Enu(center_lat_deg * M_PI / 180., center_lon_deg * M_PI / 180.);
+  const double lon0 = georeference.lon0_deg * M_PI / 180.;
+  const double lat0 = georeference.lat0_deg * M_PI / 180.;
+  const double dlon_dpixel = georeference.dlon_deg_dpixel * M_PI / 180.;
+  const double dlat_dpixel = georeference.dlat_deg_dpixel * M_PI / 180.;
+  const double latF = lat0 + dlat_dpixel * static_cast<double>(georeference.n_lat);
+
+  const double inf = std::numeric_limits<double>::infinity();
+  Bounds bounds{glm::dvec3(inf, inf, inf), glm::dvec3(-inf, -inf, -inf)};
+  for (glm::vec3 &point : *points) {
+    const double height = georeference.z_exag * (georeference.min_height + (georeference.max_height - georeference.min_height) * static_cast<double>(point.z));
+    const double lat = latF - dlat_dpixel * static_cast<double>(point.y);
+    const double lon = lon0 + dlon_dpixel * static_cast<double>(point.x);
+    point = dcm_ecef2enu * (Llh2Ecef(lat, lon, height) - ref_ecef);
+    bounds.min = glm::min(bounds.min, glm::dvec3(point));
+    bounds.max = glm::max(bounds.max, glm::dvec3(point));
+  }
+  return bounds;
+}
+
+static Bounds ReferenceGnomonic(const HeightmapGeoreference &georeference, std::vector<glm::vec3> *points) {
+  const double center_lat = georeference.CenterLatDeg() * M_PI / 180.0;
+  const double center_lon = georeference.CenterLonDeg() * M_PI / 180.0;
+  const double lon0 = georeference.lon0_deg * M_PI / 180.;
+  const double lat0 = georeference.lat0_deg * M_PI / 180.;
+  const double dlon_dpixel = georeference.dlon_deg_dpixel * M_PI / 180.;
+  const double dlat_dpixel = georeference.dlat_deg_dpixel * M_PI / 180.;
+  const double latF = lat0 + dlat_dpixel * static_cast<double>(georeference.n_lat);
+  const double lat_extent_in_meters = wgs84_A * (latF - lat0);
+
+  const double inf = std::numeric_limits<double>::infinity();
+  Bounds bounds{glm::dvec3(inf, inf, inf), glm::dvec3(-inf, -inf, -inf)};
+  for (glm::vec3 &point : *points) {
+    const double point_z = georeference.z_exag * (georeference.min_height + (georeference.max_height - georeference.min_height) * static_cast<double>(point.z)) / lat_extent_in_meters;
+    const double lat = latF - dlat_dpixel * static_cast<double>(point.y);
+    const double lon = lon0 + dlon_dpixel * static_cast<double>(point.x);
+    const auto [x, y] = Llh2Gnomonic(lat, lon, center_lat, center_lon);
+    point = glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(point_z));
+    bounds.min = glm::min(bounds.min, glm::dvec3(point));
+    bounds.max = glm::max(bounds.max, glm::dvec3(point));
+  }
+  return bounds;
+}
+
+// Snyder's formulas point by point with libm trig and pow, about the raster
+// center, with height as z.
+static Bounds ReferenceProjected(const HeightmapGeoreference &georeference,
+                                 std::pair<double, double> (*project)(double, double, double, double),
+                                 std::vector<glm::vec3> *points) {
+  const double center_lat = georeference.CenterLatDeg() * M_PI / 180.0;
+  const double center_lon = georeference.CenterLonDeg() * M_PI / 180.0;
+  const double lon0 = georeference.lon0_deg * M_PI / 180.;
+  const double lat0 = georeference.lat0_deg * M_PI / 180.;
+  const double dlon_dpixel = georeference.dlon_deg_dpixel * M_PI / 180.;
+  const double dlat_dpixel = georeference.dlat_deg_dpixel * M_PI / 180.;
+  const double latF = lat0 + dlat_dpixel * static_cast<double>(georeference.n_lat);
+
+  const double inf = std::numeric_limits<double>::infinity();
+  Bounds bounds{glm::dvec3(inf, inf, inf), glm::dvec3(-inf, -inf, -inf)};
+  for (glm::vec3 &point : *points) {
+    const double height = georeference.z_exag * (georeference.min_height + (georeference.max_height - georeference.min_height) * static_cast<double>(point.z));
+    const double lat = latF - dlat_dpixel * static_cast<double>(point.y);
+    const double lon = lon0 + dlon_dpixel * static_cast<double>(point.x);
+    const auto [x, y] = project(lat, lon, center_lat, center_lon);
+    point = glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(height));
+    bounds.min = glm::min(bounds.min, glm::dvec3(point));
+    bounds.max = glm::max(bounds.max, glm::dvec3(point));
+  }
+  return bounds;
+}
+
+// A raster already in meters: north, east and down about the raster center,
+// written out as x east, y north and z up.
+static Bounds ReferenceNed(const HeightmapGeoreference &georeference, std::vector<glm::vec3> *points) {
+  const double center_north = georeference.CenterLatDeg();
+  const double center_east = georeference.CenterLonDeg();
+  const double northF = georeference.lat0_deg + georeference.dlat_deg_dpixel * static_cast<double>(georeference.n_lat);
+
+  const double inf = std::numeric_limits<double>::infinity();
+  Bounds bounds{glm::dvec3(inf, inf, inf), glm::dvec3(-inf, -inf, -inf)};
+  for (glm::vec3 &point : *points) {
+    const double height = georeference.z_exag * (georeference.min_height + (georeference.max_height - georeference.min_height) * static_cast<double>(point.z));
+    const double north = (northF - georeference.dlat_deg_dpixel * static_cast<double>(point.y)) - center_north;
+    const double east = (georeference.lon0_deg + georeference.dlon_deg_dpixel * static_cast<double>(point.x)) - center_east;
+    const double down = -height;
+    point = glm::vec3(static_cast<float>(east), static_cast<float>(north), static_cast<float>(-down));
+    bounds.min = glm::min(bounds.min, glm::dvec3(point));
+    bounds.max = glm::max(bounds.max, glm::dvec3(point));
+  }
+  return bounds;
+}
+
+// Largest coordinate difference in float ULPs of the largest coordinate.
+static double MaxUlpError(const std::vector<glm::vec3> &expected, const std::vector<glm::vec3> &actual) {
+  float max_abs = 0.0f;
+  for (const glm::vec3 &point : expected) {
+    max_abs = std::max({max_abs, std::abs(point.x), std::abs(point.y), std::abs(point.z)});
+  }
+  const double ulp = static_cast<double>(std::nextafter(max_abs, std::numeric_limits<float>::infinity()) - max_abs);
+  double max_error = 0.0;
+  for (size_t i = 0; i < expected.size(); i++) {
+    for (int k = 0; k < 3; k++) {
+      max_error = std::max(max_error, std::abs(static_cast<double>(expected[i][k]) - static_cast<double>(actual[i][k])) / ulp);
+    }
+  }
+  return max_error;
+}
+
+static bool Check(const std::string &name, const HeightmapGeoreference &georeference, const OutputScaling output_scaling) {
+  std::vector<glm::vec3> expected = SyntheticHeightmapPoints(georeference);
+  std::vector<glm::vec3> actual = expected;
+  Bounds expected_bounds;
+  switch (output_scaling) {
+    case OutputScaling::kEnu:
+      expected_bounds = ReferenceEnu(georeference, &expected);
+      break;
+    case OutputScaling::kGnomonic:
+      expected_bounds = ReferenceGnomonic(georeference, &expected);
+      break;
+    case OutputScaling::kPolarStereographic:
+      expected_bounds = ReferenceProjected(georeference, Llh2PolarStereographic, &expected);
+      break;
+    case OutputScaling::kTransverseMercator:
+      expected_bounds = ReferenceProjected(georeference, Llh2TransverseMercator, &expected);
+      break;
+    case OutputScaling::kNed:
+      expected_bounds = ReferenceNed(georeference, &expected);
+      break;
+  }
+  const Bounds actual_bounds =
+      ProjectHeightmap(output_scaling, georeference, georeference.CenterLatDeg(), georeference.CenterLonDeg(), &actual);
+
+  // Apply the output scaling the tools use to both.
+  for (auto [points, bounds] : {std::make_pair(&expected, expected_bounds), std::make_pair(&actual, actual_bounds)}) {
+    ScaleToTargetSize(output_scaling, bounds, 10.0, points);
+  }
+
+  const double error = MaxUlpError(expected, actual);
+  const bool ok = error <= kTransformMaxUlp;
+  printf("%-32s %8zu points  max error %.2f ulp  %s\n", name.c_str(), expected.size(), error, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int32_t main() {
+  bool ok = true;
+
+  // Like the_rock: 1/3 arc second tiles in southern Utah.
+  HeightmapGeoreference the_rock;
+  the_rock.lon0_deg = -113.07;
+  the_rock.dlon_deg_dpixel = 9.259259e-05;
+  the_rock.lat0_deg = 37.175;
+  the_rock.dlat_deg_dpixel = -9.259259e-05;
+  the_rock.n_lon = 972;
+  the_rock.n_lat = 702;
+  the_rock.min_height = 1100.0;
+  the_rock.max_height = 2400.0;
+  ok &= Check("the_rock enu", the_rock, OutputScaling::kEnu);
+
+  // Like hawaii_gebco: 15 arc second bathymetry with exaggeration.
+  HeightmapGeoreference hawaii;
+  hawaii.lon0_deg = -161.4;
+  hawaii.dlon_deg_dpixel = 0.004166667;
+  hawaii.lat0_deg = 23.8;
+  hawaii.dlat_deg_dpixel = -0.004166667;
+  hawaii.n_lon = 1968;
+  hawaii.n_lat = 1464;
+  hawaii.min_height = -5800.0;
+  hawaii.max_height = 4200.0;
+  hawaii.z_exag = 5.0;
+  ok &= Check("hawaii_gebco enu", hawaii, OutputScaling::kEnu);
+
+  // Like copernicus: most of the northern hemisphere, gnomonic.
+  HeightmapGeoreference copernicus;
+  copernicus.lon0_deg = -135.0;
+  copernicus.dlon_deg_dpixel = 0.1666667;
+  copernicus.lat0_deg = 89.0;
+  copernicus.dlat_deg_dpixel = -0.1666667;
+  copernicus.n_lon = 1044;
+  copernicus.n_lat = 390;
+  copernicus.min_height = -400.0;
+  copernicus.max_height = 8800.0;
+  copernicus.z_exag = 5.0;
+  ok &= Check("copernicus gnomonic", copernicus, OutputScaling::kGnomonic);
+  ok &= Check("the_rock gnomonic", the_rock, OutputScaling::kGnomonic);
+
+  // Greenland in geographic coordinates, polar stereographic.
+  HeightmapGeoreference greenland;
+  greenland.lon0_deg = -75.0;
+  greenland.dlon_deg_dpixel = 0.05;
+  greenland.lat0_deg = 84.0;
+  greenland.dlat_deg_dpixel = -0.025;
+  greenland.n_lon = 1300;
+  greenland.n_lat = 1000;
+  greenland.min_height = -200.0;
+  greenland.max_height = 3700.0;
+  greenland.z_exag = 5.0;
+  ok &= Check("greenland polar_stereographic", greenland, OutputScaling::kPolarStereographic);
+  ok &= Check("copernicus polar_stereographic", copernicus, OutputScaling::kPolarStereographic);
+  ok &= Check("the_rock polar_stereographic", the_rock, OutputScaling::kPolarStereographic);
+
+  // Antarctica, about the south pole.
+  HeightmapGeoreference antarctica = greenland;
+  antarctica.lon0_deg = -180.0;
+  antarctica.dlon_deg_dpixel = 0.25;
+  antarctica.lat0_deg = -62.0;
+  antarctica.n_lon = 1440;
+  antarctica.n_lat = 1120;
+  ok &= Check("antarctica polar_stereographic", antarctica, OutputScaling::kPolarStereographic);
+
+  ok &= Check("the_rock transverse_mercator", the_rock, OutputScaling::kTransverseMercator);
+  ok &= Check("hawaii_gebco transverse_mercator", hawaii, OutputScaling::kTransverseMercator);
+
+  // The same rasters reprojected to meters, ned: the_rock in UTM zone 12 at
+  // 10 m, hawaii_gebco in UTM zone 4 at 500 m.
+  HeightmapGeoreference the_rock_utm = the_rock;
+  the_rock_utm.lon0_deg = 317000.0;
+  the_rock_utm.dlon_deg_dpixel = 10.0;
+  the_rock_utm.lat0_deg = 4116000.0;
+  the_rock_utm.dlat_deg_dpixel = -10.0;
+  ok &= Check("the_rock ned", the_rock_utm, OutputScaling::kNed);
+
+  HeightmapGeoreference hawaii_utm = hawaii;
+  hawaii_utm.lon0_deg = -45000.0;
+  hawaii_utm.dlon_deg_dpixel = 500.0;
+  hawaii_utm.lat0_deg = 2634000.0;
+  hawaii_utm.dlat_deg_dpixel = -500.0;
+  ok &= Check("hawaii_gebco ned", hawaii_utm, OutputScaling::kNed);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#include "grid.hpp"
+
+#include <algorithm>
+
+#include "src/meshtools/parallel.hpp"
+
+namespace {
+
+// Largest x or y a grid key can hold, so the float to integer casts are exact.
+constexpr float kMaxGridCoordinate = static_cast<float>(uint32_t{1} << 31);
+
+uint32_t BitWidth(uint32_t value) {
+  uint32_t bits = 0;
+  while (value != 0) {
+    bits++;
+    value >>= 1;
+  }
+  return bits;
+}
+
+template <typename PointAt>
+bool DetectLayout(const uint64_t n, const PointAt &point_at, GridKeyLayout *layout) {
+  const uint32_t num_chunks = NumThreads();
+  std::vector<uint32_t> max_x(num_chunks, 0);
+  std::vector<uint32_t> max_y(num_chunks, 0);
+  std::vector<uint8_t> on_grid(num_chunks, 1);
+  ParallelForChunks(n, num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    uint32_t chunk_max_x = 0;
+    uint32_t chunk_max_y = 0;
+    for (uint64_t i = begin; i < end; i++) {
+      const glm::vec3 point = point_at(i);
+      // Written so that NaN fails every test.
+      if (!(point.x >= 0.0f && point.x < kMaxGridCoordinate && point.y >= 0.0f && point.y < kMaxGridCoordinate &&
+            point.z >= 0.0f && point.z <= 1.0f)) {
+        on_grid[chunk] = 0;
+        return;
+      }
+      const uint32_t x = static_cast<uint32_t>(point.x);
+      const uint32_t y = static_cast<uint32_t>(point.y);
+      if (static_cast<float>(x) != point.x || static_cast<float>(y) != point.y) {
+        on_grid[chunk] = 0;
+        return;
+      }
+      chunk_max_x = std::max(chunk_max_x, x);
+      chunk_max_y = std::max(chunk_max_y, y);
+    }
+    max_x[chunk] = chunk_max_x;
+    max_y[chunk] = chunk_max_y;
+  });
+  if (std::find(on_grid.begin(), on_grid.end(), 0) != on_grid.end()) {
+    return false;
+  }
+  layout->x_bits = BitWidth(*std::max_element(max_x.begin(), max_x.end()));
+  layout->y_bits = BitWidth(*std::max_element(max_y.begin(), max_y.end()));
+  return layout->x_bits + layout->y_bits + kGridZBits <= 64;
+}
+
+}  // namespace
+
+bool DetectGridLayout(const CornerView &corners, GridKeyLayout *layout) {
+  return DetectLayout(corners.NumCorners(), [&corners](const uint64_t c) { return corners.Corner(c); }, layout);
+}
+
+bool DetectGridLayout(const std::vector<glm::vec3> &points, GridKeyLayout *layout) {
+  return DetectLayout(points.size(), [&points](const uint64_t i) { return points[i]; }, layout);
+}
+
+bool PackGridPoints(const std::vector<glm::vec3> &points, GridKeyLayout *layout, std::vector<uint64_t> *keys) {
+  keys->clear();
+  if (!DetectGridLayout(points, layout)) {
+    return false;
+  }
+  keys->resize(points.size());
+  ParallelFor(points.size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t i = begin; i < end; i++) {
+      (*keys)[i] = layout->Pack(points[i]);
+    }
+  });
+  return true;
+}
+
+void UnpackGridPoints(const GridKeyLayout &layout, const std::vector<uint64_t> &keys, std::vector<glm::vec3> *points) {
+  points->resize(keys.size());
+  ParallelFor(keys.size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t i = begin; i < end; i++) {
+      (*points)[i] = layout.Unpack(keys[i]);
+    }
+  });
+}
+
+GridVertexTable::GridVertexTable(const uint64_t expected_size) {
+  uint64_t capacity = 16;
+  while (capacity < 2 * expected_size) {
+    capacity *= 2;
+  }
+  slots_.assign(capacity, -1);
+  mask_ = capacity - 1;
+  keys_.reserve(expected_size);
+  indices_.reserve(expected_size);
+}
+
+void GridVertexTable::Grow() {
+  slots_.assign(2 * slots_.size(), -1);
+  mask_ = slots_.size() - 1;
+  for (uint64_t position = 0; position < keys_.size(); position++) {
+    uint64_t i = GridHash(keys_[position]) & mask_;
+    while (slots_[i] >= 0) {
+      i = (i + 1) & mask_;
+    }
+    slots_[i] = static_cast<int32_t>(position);
+  }
+}
+
+int32_t GridVertexTable::FindOrInsert(const uint64_t key, const int32_t index, bool *inserted) {
+  uint64_t i = GridHash(key) & mask_;
+  while (slots_[i] >= 0) {
+    const uint64_t position = static_cast<uint64_t>(slots_[i]);
+    if (keys_[position] == key) {
+      *inserted = false;
+      return indices_[position];
+    }
+    i = (i + 1) & mask_;
+  }
+  // Keep the load factor at or below 1/2 so probe sequences stay short.
+  if (2 * (keys_.size() + 1) > slots_.size()) {
+    Grow();
+    i = GridHash(key) & mask_;
+    while (slots_[i] >= 0) {
+      i = (i + 1) & mask_;
+    }
+  }
+  slots_[i] = static_cast<int32_t>(keys_.size());
+  keys_.push_back(key);
+  indices_.push_back(index);
+  *inserted = true;
+  return index;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "src/meshtools/weld.hpp"
+
+// Unscaled heightmap meshes (hmm, triangulate_dem, stitch_tiles) have x and y
+// on integer pixel coordinates and z in [0, 1]. Such a vertex packs losslessly
+// into one 64 bit key: x and y as integers, z as its float bits, which fit in
+// 30 bits for [0, 1]. Keys compare equal exactly when the floats do.
+
+// Bits of z in a grid key.
+constexpr uint32_t kGridZBits = 30;
+
+// Field widths of a grid key, big enough for the largest x and y of a mesh.
+struct GridKeyLayout {
+  uint32_t x_bits = 0;
+  uint32_t y_bits = 0;
+
+  uint64_t Pack(const glm::vec3 &point) const {
+    uint32_t z_bits;
+    const float z = point.z == 0.0f ? 0.0f : point.z;
+    memcpy(&z_bits, &z, 4);
+    return (static_cast<uint64_t>(point.x) << (y_bits + kGridZBits)) |
+           (static_cast<uint64_t>(point.y) << kGridZBits) | z_bits;
+  }
+
+  glm::vec3 Unpack(const uint64_t key) const {
+    const uint32_t z_bits = static_cast<uint32_t>(key & ((uint64_t{1} << kGridZBits) - 1));
+    float z;
+    memcpy(&z, &z_bits, 4);
+    const uint64_t y = (key >> kGridZBits) & ((uint64_t{1} << y_bits) - 1);
+    const uint64_t x = key >> (y_bits + kGridZBits);
+    return glm::vec3(static_cast<float>(x), static_cast<float>(y), z);
+  }
+};
+
+// Multiplicative hash of a grid key. Neighbouring pixels land far apart.
+inline uint64_t GridHash(const uint64_t key) {
+  const uint64_t h = key * 0x9e3779b97f4a7c15ull;
+  return h ^ (h >> 29);
+}
+
+// Find a layout that fits every corner, or return false if some corner is off
+// the grid: x or y negative or not an integer, z outside [0, 1] or NaN, or x
+// and y too large to share 34 bits.
+bool DetectGridLayout(const CornerView &corners, GridKeyLayout *layout);
+bool DetectGridLayout(const std::vector<glm::vec3> &points, GridKeyLayout *layout);
+
+// Convert between float points and grid keys, for holding a grid mesh's
+// vertices in 8 bytes instead of 12. Unpack returns the packed point bit for
+// bit, except that a z of -0 comes back as +0. PackGridPoints replaces `keys`
+// and returns false, leaving them empty, if the points are not a grid.
+bool PackGridPoints(const std::vector<glm::vec3> &points, GridKeyLayout *layout, std::vector<uint64_t> *keys);
+void UnpackGridPoints(const GridKeyLayout &layout, const std::vector<uint64_t> &keys, std::vector<glm::vec3> *points);
+
+// Open-addressing table from grid key to vertex index. Slots hold 32 bit
+// positions into dense key and index arrays, so at the same load factor it
+// needs about 20 bytes per vertex where VertexTable needs 32.
+class GridVertexTable {
+ public:
+  explicit GridVertexTable(uint64_t expected_size = 0);
+
+  // Return the index of `key`, inserting it with `index` if it is new.
+  // `inserted` is set to whether the key was new.
+  int32_t FindOrInsert(uint64_t key, int32_t index, bool *inserted);
+
+  uint64_t size() const { return keys_.size(); }
+  double LoadFactor() const { return static_cast<double>(keys_.size()) / static_cast<double>(slots_.size()); }
+
+ private:
+  void Grow();
+
+  std::vector<int32_t> slots_;
+  std::vector<uint64_t> keys_;
+  std::vector<int32_t> indices_;
+  uint64_t mask_ = 0;
+};
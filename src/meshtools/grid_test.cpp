@@ -0,0 +1,97 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/grid.hpp"
+
+// Check that grid points survive PackGridPoints and UnpackGridPoints bit for
+// bit, that keys are equal exactly when the points are, and that points off
+// the grid are rejected.
+
+static bool SameBits(const glm::vec3 &a, const glm::vec3 &b) { return memcmp(&a, &b, sizeof(glm::vec3)) == 0; }
+
+static bool Check(const std::string &name, const bool ok) {
+  printf("%-32s %s\n", name.c_str(), ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Heightmap-like points: every pixel of a width x height grid with random
+// heights, plus the z values at the ends of [0, 1] and the smallest ones.
+static std::vector<glm::vec3> GridPoints(const uint32_t width, const uint32_t height) {
+  std::mt19937_64 rng(0);
+  std::uniform_real_distribution<float> z(0.0f, 1.0f);
+  std::vector<glm::vec3> points;
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      points.push_back(glm::vec3(static_cast<float>(x), static_cast<float>(y), z(rng)));
+    }
+  }
+  for (const float special : {0.0f, 1.0f, std::numeric_limits<float>::denorm_min(),
+                              std::numeric_limits<float>::min(), std::nextafter(1.0f, 0.0f)}) {
+    points.push_back(glm::vec3(static_cast<float>(width - 1), 0.0f, special));
+  }
+  return points;
+}
+
+static bool RoundTrips(const std::string &name, const std::vector<glm::vec3> &points) {
+  GridKeyLayout layout;
+  std::vector<uint64_t> keys;
+  if (!PackGridPoints(points, &layout, &keys) || keys.size() != points.size()) {
+    return Check(name, false);
+  }
+  std::vector<glm::vec3> unpacked;
+  UnpackGridPoints(layout, keys, &unpacked);
+  bool ok = unpacked.size() == points.size();
+  for (uint64_t i = 0; ok && i < points.size(); i++) {
+    ok = SameBits(points[i], unpacked[i]) && layout.Pack(points[i]) == keys[i];
+  }
+  return Check(name, ok);
+}
+
+static bool Rejects(const std::string &name, const glm::vec3 &point) {
+  std::vector<glm::vec3> points = GridPoints(4, 4);
+  points.push_back(point);
+  GridKeyLayout layout;
+  std::vector<uint64_t> keys = {1, 2, 3};
+  return Check(name, !PackGridPoints(points, &layout, &keys) && keys.empty());
+}
+
+int32_t main() {
+  bool ok = true;
+  ok &= RoundTrips("round trip 1x1", GridPoints(1, 1));
+  ok &= RoundTrips("round trip 1000x700", GridPoints(1000, 700));
+  // 2^17 wide and 2^16 high needs all 64 bits.
+  std::vector<glm::vec3> wide = GridPoints(3, 2);
+  wide.push_back(glm::vec3(131071.0f, 65535.0f, 1.0f));
+  ok &= RoundTrips("round trip 64 bit keys", wide);
+
+  // -0 packs like +0, so the two weld together.
+  GridKeyLayout layout;
+  std::vector<uint64_t> keys;
+  std::vector<glm::vec3> zeros = {glm::vec3(2.0f, 3.0f, 0.0f), glm::vec3(2.0f, 3.0f, -0.0f)};
+  ok &= Check("negative zero", PackGridPoints(zeros, &layout, &keys) && keys[0] == keys[1]);
+
+  // Different points never share a key.
+  const std::vector<glm::vec3> points = GridPoints(300, 200);
+  ok &= Check("distinct keys", PackGridPoints(points, &layout, &keys) && [&] {
+    for (uint64_t i = 1; i < keys.size(); i++) {
+      if ((keys[i] == keys[i - 1]) != SameBits(points[i], points[i - 1])) {
+        return false;
+      }
+    }
+    return true;
+  }());
+
+  ok &= Rejects("rejects negative x", glm::vec3(-1.0f, 0.0f, 0.5f));
+  ok &= Rejects("rejects fractional y", glm::vec3(1.0f, 0.5f, 0.5f));
+  ok &= Rejects("rejects z above 1", glm::vec3(1.0f, 1.0f, 1.5f));
+  ok &= Rejects("rejects NaN z", glm::vec3(1.0f, 1.0f, std::nanf("")));
+  ok &= Rejects("rejects keys over 64 bits", glm::vec3(262144.0f, 65535.0f, 0.5f));
+
+  return ok ? 0 : 1;
+}
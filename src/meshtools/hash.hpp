@@ -1,7 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <glm/glm.hpp>
+#include <vector>
+
+#include "src/meshtools/parallel.hpp"
 
 template <class T>
 inline void hash_combine(std::size_t & seed, const T & v)
@@ -38,3 +44,43 @@ namespace std {
     }
   };
 }
+
+// Fast 64 bit hash of a byte range, for content hashes of mesh files.
+// Not cryptographic. Processes 8 bytes per step.
+inline uint64_t HashBytes(const void *data, const uint64_t size, uint64_t seed = 0)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ull);
+  uint64_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+    word *= 0xbf58476d1ce4e5b9ull;
+    word ^= word >> 31;
+    h = (h ^ word) * 0x94d049bb133111ebull;
+    h ^= h >> 29;
+  }
+  uint64_t tail = 0;
+  if (i < size) {
+    memcpy(&tail, bytes + i, size - i);
+  }
+  h = (h ^ tail) * 0x94d049bb133111ebull;
+  h ^= h >> 32;
+  return h;
+}
+
+// HashBytes of fixed 1 MB blocks in parallel, combined in block order, so the
+// result does not depend on the number of threads.
+inline uint64_t ParallelHashBytes(const void *data, const uint64_t size, const uint64_t seed = 0)
+{
+  constexpr uint64_t kBlockBytes = 1 << 20;
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  std::vector<uint64_t> block_hashes((size + kBlockBytes - 1) / kBlockBytes);
+  ParallelFor(block_hashes.size(), 4, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t block = begin; block < end; block++) {
+      const uint64_t offset = block * kBlockBytes;
+      block_hashes[block] = HashBytes(bytes + offset, std::min(kBlockBytes, size - offset), block);
+    }
+  });
+  return HashBytes(block_hashes.data(), block_hashes.size() * sizeof(uint64_t), seed);
+}
@@ -0,0 +1,18 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/terrain.hpp"
+
+// Print the gdal_translate -scale source range "min max" of a raster, its
+// computedMin and computedMax from the gdalinfo JSON, for the PNG genrules.
+// Usage: ./height_range gdalinfo.json
+int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  if (argc != 2) {
+    fprintf(stderr, "Usage: ./height_range gdalinfo.json\n");
+    std::exit(1);
+  }
+  const GdalInfo info = ReadGdalInfo(argv[1]);
+  printf("%.17g %.17g\n", info.computed_min.AsDouble(), info.computed_max.AsDouble());
+}
@@ -0,0 +1,249 @@
+#include "json.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+class JsonParser {
+ public:
+  explicit JsonParser(const std::string &text) : text_(text) {}
+
+  JsonValue ParseDocument() {
+    JsonValue value = ParseValue();
+    SkipWhitespace();
+    if (pos_ != text_.size()) {
+      Fail("trailing characters");
+    }
+    return value;
+  }
+
+ private:
+  [[noreturn]] void Fail(const char *what) const {
+    fprintf(stderr, "Error parsing JSON at offset %zu: %s\n", pos_, what);
+    std::exit(1);
+  }
+
+  void SkipWhitespace() {
+    while (pos_ < text_.size() && strchr(" \t\r\n", text_[pos_]) != nullptr) {
+      pos_++;
+    }
+  }
+
+  char Peek() {
+    SkipWhitespace();
+    if (pos_ >= text_.size()) {
+      Fail("unexpected end of input");
+    }
+    return text_[pos_];
+  }
+
+  void Expect(const char c) {
+    if (Peek() != c) {
+      Fail("unexpected character");
+    }
+    pos_++;
+  }
+
+  bool ConsumeLiteral(const char *literal) {
+    const size_t length = strlen(literal);
+    if (text_.compare(pos_, length, literal) == 0) {
+      pos_ += length;
+      return true;
+    }
+    return false;
+  }
+
+  JsonValue ParseValue() {
+    JsonValue value;
+    const char c = Peek();
+    if (c == '{') {
+      value.type = JsonValue::Type::kObject;
+      pos_++;
+      if (Peek() == '}') {
+        pos_++;
+        return value;
+      }
+      while (true) {
+        if (Peek() != '"') {
+          Fail("expected object key");
+        }
+        std::string key = ParseString();
+        Expect(':');
+        value.object.emplace_back(std::move(key), ParseValue());
+        if (Peek() == ',') {
+          pos_++;
+          continue;
+        }
+        Expect('}');
+        return value;
+      }
+    }
+    if (c == '[') {
+      value.type = JsonValue::Type::kArray;
+      pos_++;
+      if (Peek() == ']') {
+        pos_++;
+        return value;
+      }
+      while (true) {
+        value.array.push_back(ParseValue());
+        if (Peek() == ',') {
+          pos_++;
+          continue;
+        }
+        Expect(']');
+        return value;
+      }
+    }
+    if (c == '"') {
+      value.type = JsonValue::Type::kString;
+      value.text = ParseString();
+      return value;
+    }
+    if (ConsumeLiteral("true")) {
+      value.type = JsonValue::Type::kBool;
+      value.boolean = true;
+      return value;
+    }
+    if (ConsumeLiteral("false")) {
+      value.type = JsonValue::Type::kBool;
+      return value;
+    }
+    if (ConsumeLiteral("null")) {
+      return value;
+    }
+    // gdalinfo writes NaN and Infinity for some statistics.
+    const size_t start = pos_;
+    if (ConsumeLiteral("NaN") || ConsumeLiteral("Infinity") || ConsumeLiteral("-Infinity")) {
+      value.type = JsonValue::Type::kNumber;
+      value.text = text_.substr(start, pos_ - start);
+      value.number = strtod(value.text.c_str(), nullptr);
+      return value;
+    }
+    while (pos_ < text_.size() && strchr("+-0123456789.eE", text_[pos_]) != nullptr) {
+      pos_++;
+    }
+    if (pos_ == start) {
+      Fail("unexpected character");
+    }
+    value.type = JsonValue::Type::kNumber;
+    value.text = text_.substr(start, pos_ - start);
+    char *end = nullptr;
+    value.number = strtod(value.text.c_str(), &end);
+    if (end != value.text.c_str() + value.text.size()) {
+      Fail("malformed number");
+    }
+    return value;
+  }
+
+  std::string ParseString() {
+    Expect('"');
+    std::string result;
+    while (true) {
+      if (pos_ >= text_.size()) {
+        Fail("unterminated string");
+      }
+      const char c = text_[pos_++];
+      if (c == '"') {
+        return result;
+      }
+      if (c != '\\') {
+        result.push_back(c);
+        continue;
+      }
+      if (pos_ >= text_.size()) {
+        Fail("unterminated string");
+      }
+      const char escaped = text_[pos_++];
+      switch (escaped) {
+        case 'n': result.push_back('\n'); break;
+        case 't': result.push_back('\t'); break;
+        case 'r': result.push_back('\r'); break;
+        case 'b': result.push_back('\b'); break;
+        case 'f': result.push_back('\f'); break;
+        case 'u':
+          // Keys and values we read are ASCII, keep escapes verbatim.
+          result += "\\u";
+          break;
+        default: result.push_back(escaped); break;
+      }
+    }
+  }
+
+  const std::string &text_;
+  size_t pos_ = 0;
+};
+
+}  // namespace
+
+bool JsonValue::Has(const std::string &key) const {
+  for (const auto &[name, value] : object) {
+    if (name == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+const JsonValue &JsonValue::operator[](const std::string &key) const {
+  for (const auto &[name, value] : object) {
+    if (name == key) {
+      return value;
+    }
+  }
+  fprintf(stderr, "Error: JSON object has no key \"%s\".\n", key.c_str());
+  std::exit(1);
+}
+
+const JsonValue &JsonValue::operator[](const uint64_t index) const {
+  if (type != Type::kArray || index >= array.size()) {
+    fprintf(stderr, "Error: JSON index %llu out of range.\n", static_cast<unsigned long long>(index));
+    std::exit(1);
+  }
+  return array[index];
+}
+
+uint64_t JsonValue::size() const {
+  return type == Type::kObject ? object.size() : array.size();
+}
+
+double JsonValue::AsDouble() const {
+  if (type != Type::kNumber) {
+    fprintf(stderr, "Error: JSON value is not a number.\n");
+    std::exit(1);
+  }
+  return number;
+}
+
+float JsonValue::AsFloat() const {
+  AsDouble();
+  return strtof(text.c_str(), nullptr);
+}
+
+int32_t JsonValue::AsInt() const {
+  const double value = AsDouble();
+  if (!(value >= -2147483648.0 && value <= 2147483647.0) || value != static_cast<double>(static_cast<int32_t>(value))) {
+    fprintf(stderr, "Error: JSON value %s is not an int32.\n", text.c_str());
+    std::exit(1);
+  }
+  return static_cast<int32_t>(value);
+}
+
+JsonValue ParseJson(const std::string &text) {
+  return JsonParser(text).ParseDocument();
+}
+
+JsonValue ReadJsonFile(const std::string &path) {
+  std::ifstream file(path);
+  if (!file) {
+    fprintf(stderr, "Error opening %s.\n", path.c_str());
+    std::exit(1);
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return ParseJson(buffer.str());
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal JSON document model, enough to read gdalinfo output.
+// Malformed input and missing keys are fatal.
+struct JsonValue {
+  enum class Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+  Type type = Type::kNull;
+  bool boolean = false;
+  double number = 0;
+  // String contents, or the literal text of a number so callers can parse it
+  // with the precision they need (e.g. strtof).
+  std::string text;
+  std::vector<JsonValue> array;
+  std::vector<std::pair<std::string, JsonValue>> object;
+
+  bool Has(const std::string &key) const;
+  const JsonValue &operator[](const std::string &key) const;
+  const JsonValue &operator[](uint64_t index) const;
+  uint64_t size() const;
+
+  double AsDouble() const;
+  float AsFloat() const;
+  int32_t AsInt() const;
+};
+
+JsonValue ParseJson(const std::string &text);
+JsonValue ReadJsonFile(const std::string &path);
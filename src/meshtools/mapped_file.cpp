@@ -0,0 +1,57 @@
+#include "mapped_file.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Error opening %s.\n", path.c_str());
+    std::exit(1);
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    fprintf(stderr, "Error getting size of %s.\n", path.c_str());
+    std::exit(1);
+  }
+  size_ = static_cast<size_t>(st.st_size);
+
+  // mmap refuses zero-length mappings, so leave data_ null for empty files.
+  if (size_ > 0) {
+    void *mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      fprintf(stderr, "Error mapping %s.\n", path.c_str());
+      std::exit(1);
+    }
+    // We walk the file front to back exactly once.
+    madvise(mapped, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const uint8_t *>(mapped);
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+  }
+}
+
+void WriteAll(const int fd, const void *data, uint64_t size, const std::string &path) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  while (size > 0) {
+    const ssize_t written = write(fd, bytes, size);
+    if (written <= 0) {
+      fprintf(stderr, "Error writing %s: %s\n", path.c_str(), strerror(errno));
+      std::exit(1);
+    }
+    bytes += written;
+    size -= static_cast<uint64_t>(written);
+  }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of an entire file.
+// Errors opening or mapping the file are fatal, like the rest of meshtools.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Write all `size` bytes to `fd`, retrying short writes. Errors are fatal and
+// name `path`.
+void WriteAll(int fd, const void *data, uint64_t size, const std::string &path);
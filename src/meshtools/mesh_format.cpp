@@ -0,0 +1,168 @@
+#include "mesh_format.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <unistd.h>
+
+#include "src/meshtools/hash.hpp"
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+
+namespace {
+
+uint64_t AlignUp(const uint64_t offset) {
+  return (offset + kMeshAlignment - 1) / kMeshAlignment * kMeshAlignment;
+}
+
+}  // namespace
+
+uint64_t MeshContentHash(const glm::vec3 *points, const uint64_t num_points,
+                         const glm::ivec3 *triangles, const uint64_t num_triangles) {
+  const uint64_t vertex_hash = ParallelHashBytes(points, num_points * sizeof(glm::vec3));
+  return ParallelHashBytes(triangles, num_triangles * sizeof(glm::ivec3), vertex_hash);
+}
+
+void WriteMesh(const std::string &path,
+               const std::vector<glm::vec3> &points,
+               const std::vector<glm::ivec3> &triangles) {
+  static_assert(sizeof(glm::vec3) == 12 && sizeof(glm::ivec3) == 12);
+  const ScopedStage stage("write_mesh");
+
+  MeshFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMeshMagic, sizeof(kMeshMagic));
+  header.version = kMeshVersion;
+  header.flags = kMeshHasBounds | kMeshHasContentHash;
+  header.num_vertices = points.size();
+  header.num_triangles = triangles.size();
+  header.vertex_offset = kMeshHeaderBytes;
+  header.index_offset = AlignUp(header.vertex_offset + points.size() * sizeof(glm::vec3));
+
+  // Bounds, reduced per chunk in parallel.
+  const uint32_t num_chunks = NumThreads();
+  std::vector<glm::vec3> chunk_min(num_chunks, glm::vec3(std::numeric_limits<float>::infinity()));
+  std::vector<glm::vec3> chunk_max(num_chunks, glm::vec3(-std::numeric_limits<float>::infinity()));
+  ParallelForChunks(points.size(), num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    for (uint64_t i = begin; i < end; i++) {
+      chunk_min[chunk] = glm::min(chunk_min[chunk], points[i]);
+      chunk_max[chunk] = glm::max(chunk_max[chunk], points[i]);
+    }
+  });
+  glm::vec3 bounds_min = chunk_min[0];
+  glm::vec3 bounds_max = chunk_max[0];
+  for (uint32_t chunk = 1; chunk < num_chunks; chunk++) {
+    bounds_min = glm::min(bounds_min, chunk_min[chunk]);
+    bounds_max = glm::max(bounds_max, chunk_max[chunk]);
+  }
+  memcpy(header.bounds_min, &bounds_min, 12);
+  memcpy(header.bounds_max, &bounds_max, 12);
+  header.content_hash = MeshContentHash(points.data(), points.size(), triangles.data(), triangles.size());
+
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    fprintf(stderr, "Error opening %s for writing: %s\n", path.c_str(), strerror(errno));
+    std::exit(1);
+  }
+  uint8_t padding[kMeshHeaderBytes] = {};
+  WriteAll(fd, &header, sizeof(header), path);
+  WriteAll(fd, padding, kMeshHeaderBytes - sizeof(header), path);
+  WriteAll(fd, points.data(), points.size() * sizeof(glm::vec3), path);
+  WriteAll(fd, padding, header.index_offset - (header.vertex_offset + points.size() * sizeof(glm::vec3)), path);
+  WriteAll(fd, triangles.data(), triangles.size() * sizeof(glm::ivec3), path);
+  if (close(fd) != 0) {
+    fprintf(stderr, "Error closing %s: %s\n", path.c_str(), strerror(errno));
+    std::exit(1);
+  }
+  StatsAdd("mesh_bytes_written", header.index_offset + triangles.size() * sizeof(glm::ivec3));
+}
+
+MappedMesh::MappedMesh(const std::string &path) : file_(path) {
+  if (file_.size() < kMeshHeaderBytes) {
+    fprintf(stderr, "Invalid mesh file %s: %zu bytes is too small for the header.\n", path.c_str(), file_.size());
+    std::exit(1);
+  }
+  memcpy(&header_, file_.data(), sizeof(header_));
+  if (memcmp(header_.magic, kMeshMagic, sizeof(kMeshMagic)) != 0) {
+    fprintf(stderr, "Invalid mesh file %s: bad magic.\n", path.c_str());
+    std::exit(1);
+  }
+  if (header_.version != kMeshVersion) {
+    fprintf(stderr, "Invalid mesh file %s: version %u, expected %u.\n", path.c_str(), header_.version, kMeshVersion);
+    std::exit(1);
+  }
+  // Every bound is checked by division against what is left of the file, so
+  // no header value can overflow the arithmetic.
+  const uint64_t size = file_.size();
+  const bool sizes_ok =
+      header_.vertex_offset % kMeshAlignment == 0 && header_.index_offset % kMeshAlignment == 0 &&
+      header_.vertex_offset >= kMeshHeaderBytes && header_.vertex_offset <= size &&
+      header_.num_vertices <= (size - header_.vertex_offset) / sizeof(glm::vec3) &&
+      header_.index_offset >= header_.vertex_offset + header_.num_vertices * sizeof(glm::vec3) &&
+      header_.index_offset <= size &&
+      header_.num_triangles <= (size - header_.index_offset) / sizeof(glm::ivec3) &&
+      size == header_.index_offset + header_.num_triangles * sizeof(glm::ivec3);
+  if (!sizes_ok) {
+    fprintf(stderr, "Invalid mesh file %s: header does not match the %zu byte file.\n", path.c_str(), file_.size());
+    std::exit(1);
+  }
+}
+
+const glm::vec3 *MappedMesh::vertices() const {
+  return reinterpret_cast<const glm::vec3 *>(file_.data() + header_.vertex_offset);
+}
+
+const glm::ivec3 *MappedMesh::triangles() const {
+  return reinterpret_cast<const glm::ivec3 *>(file_.data() + header_.index_offset);
+}
+
+bool MappedMesh::VerifyContentHash() const {
+  if (!(header_.flags & kMeshHasContentHash)) {
+    return true;
+  }
+  return MeshContentHash(vertices(), num_vertices(), triangles(), num_triangles()) == header_.content_hash;
+}
+
+uint64_t MappedMesh::FirstBadTriangle() const {
+  const glm::ivec3 *indices = triangles();
+  const uint64_t num_vertices = header_.num_vertices;
+  const uint32_t num_chunks = NumThreads();
+  std::vector<uint64_t> first_bad(num_chunks, header_.num_triangles);
+  ParallelForChunks(header_.num_triangles, num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    for (uint64_t t = begin; t < end; t++) {
+      const glm::ivec3 &triangle = indices[t];
+      bool ok = true;
+      for (int k = 0; k < 3; k++) {
+        ok &= triangle[k] >= 0 && static_cast<uint64_t>(triangle[k]) < num_vertices;
+      }
+      if (!ok) {
+        first_bad[chunk] = t;
+        return;
+      }
+    }
+  });
+  return *std::min_element(first_bad.begin(), first_bad.end());
+}
+
+void ReadMesh(const std::string &path,
+              std::vector<glm::vec3> &points,
+              std::vector<glm::ivec3> &triangles) {
+  const ScopedStage stage("read_mesh");
+  const MappedMesh mesh(path);
+  // Consumers index the vertex array with these unchecked.
+  const uint64_t bad = mesh.FirstBadTriangle();
+  if (bad < mesh.num_triangles()) {
+    const glm::ivec3 &triangle = mesh.triangles()[bad];
+    fprintf(stderr, "Invalid mesh file %s: triangle %llu has vertex indices %d %d %d, but there are %llu vertices.\n",
+            path.c_str(), static_cast<unsigned long long>(bad), triangle.x, triangle.y, triangle.z,
+            static_cast<unsigned long long>(mesh.num_vertices()));
+    std::exit(1);
+  }
+  points.assign(mesh.vertices(), mesh.vertices() + mesh.num_vertices());
+  triangles.assign(mesh.triangles(), mesh.triangles() + mesh.num_triangles());
+  StatsAdd("mesh_bytes_read", mesh.header().index_offset + mesh.num_triangles() * sizeof(glm::ivec3));
+}
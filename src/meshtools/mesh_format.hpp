@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/mapped_file.hpp"
+
+// Indexed native mesh format (.mesh) for intermediate artifacts.
+//
+//   offset 0    MeshFileHeader, padded to kMeshHeaderBytes
+//   offset 128  num_vertices * glm::vec3 (float x, y, z)
+//   aligned     num_triangles * glm::ivec3 (int32 vertex indices)
+//
+// Both arrays start on a kMeshAlignment boundary, so a mapped file can be
+// used in place without parsing. All values are little endian.
+constexpr char kMeshMagic[8] = {'T', 'O', 'P', 'O', 'M', 'E', 'S', 'H'};
+constexpr uint32_t kMeshVersion = 1;
+constexpr uint64_t kMeshHeaderBytes = 128;
+constexpr uint64_t kMeshAlignment = 64;
+
+// Optional header fields present in the file.
+constexpr uint32_t kMeshHasBounds = 1 << 0;
+constexpr uint32_t kMeshHasContentHash = 1 << 1;
+
+struct MeshFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t num_vertices;
+  uint64_t num_triangles;
+  uint64_t vertex_offset;
+  uint64_t index_offset;
+  float bounds_min[3];
+  float bounds_max[3];
+  // ParallelHashBytes of the vertex array, then of the index array seeded
+  // with the vertex hash.
+  uint64_t content_hash;
+};
+static_assert(sizeof(MeshFileHeader) <= kMeshHeaderBytes);
+
+// Write a .mesh file with bounds and a content hash.
+void WriteMesh(const std::string &path,
+               const std::vector<glm::vec3> &points,
+               const std::vector<glm::ivec3> &triangles);
+
+// A .mesh file mapped read-only. Vertices and triangles point straight into
+// the mapping, so opening costs the same whatever the mesh size. Exits if the
+// header is malformed or does not match the file. Vertex indices are not
+// checked on open: callers that index the vertices with them call
+// FirstBadTriangle first, or go through ReadMesh, which does.
+class MappedMesh {
+ public:
+  explicit MappedMesh(const std::string &path);
+
+  const MeshFileHeader &header() const { return header_; }
+  uint64_t num_vertices() const { return header_.num_vertices; }
+  uint64_t num_triangles() const { return header_.num_triangles; }
+  const glm::vec3 *vertices() const;
+  const glm::ivec3 *triangles() const;
+
+  // Recompute the content hash and compare it with the header.
+  bool VerifyContentHash() const;
+
+  // The first triangle with a vertex index out of range, or num_triangles()
+  // if there is none. Scans the triangles in parallel.
+  uint64_t FirstBadTriangle() const;
+
+ private:
+  MappedFile file_;
+  MeshFileHeader header_;
+};
+
+// Copy a .mesh file into vectors, replacing their contents. Exits if any
+// vertex index is out of range.
+void ReadMesh(const std::string &path,
+              std::vector<glm::vec3> &points,
+              std::vector<glm::ivec3> &triangles);
+
+uint64_t MeshContentHash(const glm::vec3 *points, uint64_t num_points,
+                         const glm::ivec3 *triangles, uint64_t num_triangles);
@@ -0,0 +1,144 @@
+#include "mesh_io.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "src/meshtools/mesh_format.hpp"
+#include "src/meshtools/ply.hpp"
+#include "src/meshtools/stl.hpp"
+#include "src/meshtools/threemf.hpp"
+
+MeshFormat ParseFormatFlag(int32_t *argc, char *argv[]) {
+  MeshFormat format = MeshFormat::kByExtension;
+  int32_t kept = 1;
+  for (int32_t k = 1; k < *argc; k++) {
+    if (strncmp(argv[k], "--format=", 9) != 0) {
+      argv[kept++] = argv[k];
+      continue;
+    }
+    const std::string name = argv[k] + 9;
+    if (name == "stl") {
+      format = MeshFormat::kStl;
+    } else if (name == "ply") {
+      format = MeshFormat::kPly;
+    } else if (name == "mesh") {
+      format = MeshFormat::kMesh;
+    } else if (name == "3mf") {
+      format = MeshFormat::kThreeMf;
+    } else {
+      fprintf(stderr, "Unknown --format %s, expected stl, ply, mesh or 3mf\n", name.c_str());
+      std::exit(1);
+    }
+  }
+  argv[kept] = nullptr;
+  *argc = kept;
+  return format;
+}
+
+bool ParseStreamingFlag(int32_t *argc, char *argv[]) {
+  bool streaming = false;
+  int32_t kept = 1;
+  for (int32_t k = 1; k < *argc; k++) {
+    if (strcmp(argv[k], "--streaming") == 0) {
+      streaming = true;
+    } else {
+      argv[kept++] = argv[k];
+    }
+  }
+  argv[kept] = nullptr;
+  *argc = kept;
+  return streaming;
+}
+
+void CheckStreamingPaths(const std::string &input_path, const std::string &output_path, const MeshFormat format) {
+  for (const char *extension : {".mesh", ".ply", ".3mf"}) {
+    if (HasExtension(input_path, extension) ||
+        (format == MeshFormat::kByExtension && HasExtension(output_path, extension))) {
+      fprintf(stderr, "Error: --streaming only supports binary STL, not %s.\n", extension);
+      std::exit(1);
+    }
+  }
+  if (format != MeshFormat::kByExtension && format != MeshFormat::kStl) {
+    fprintf(stderr, "Error: --streaming only supports --format=stl.\n");
+    std::exit(1);
+  }
+  // The output is truncated before pass two reads the input again.
+  struct stat input_stat;
+  struct stat output_stat;
+  if (input_path == output_path ||
+      (stat(input_path.c_str(), &input_stat) == 0 && stat(output_path.c_str(), &output_stat) == 0 &&
+       input_stat.st_dev == output_stat.st_dev && input_stat.st_ino == output_stat.st_ino)) {
+    fprintf(stderr, "Error: --streaming cannot write over its input %s.\n", input_path.c_str());
+    std::exit(1);
+  }
+}
+
+bool HasExtension(const std::string &path, const std::string &extension) {
+  return path.size() >= extension.size() &&
+         path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+void ReadMeshFile(const std::string &path,
+                  std::vector<glm::vec3> &points,
+                  std::vector<glm::ivec3> &triangles) {
+  if (HasExtension(path, ".3mf")) {
+    fprintf(stderr, "Error: reading 3MF is not supported, %s.\n", path.c_str());
+    std::exit(1);
+  }
+  if (HasExtension(path, ".mesh") || HasExtension(path, ".ply")) {
+    std::vector<glm::vec3> new_points;
+    std::vector<glm::ivec3> new_triangles;
+    if (HasExtension(path, ".mesh")) {
+      ReadMesh(path, new_points, new_triangles);
+    } else {
+      LoadPly(path, &new_points, &new_triangles);
+    }
+    if (points.empty() && triangles.empty()) {
+      points.swap(new_points);
+      triangles.swap(new_triangles);
+      return;
+    }
+    const int32_t offset = static_cast<int32_t>(points.size());
+    points.insert(points.end(), new_points.begin(), new_points.end());
+    for (const glm::ivec3 &triangle : new_triangles) {
+      triangles.push_back({triangle.x + offset, triangle.y + offset, triangle.z + offset});
+    }
+    return;
+  }
+  ReadBinarySTL(path, points, triangles);
+}
+
+void WriteMeshFile(const std::string &path,
+                   const std::vector<glm::vec3> &points,
+                   const std::vector<glm::ivec3> &triangles,
+                   MeshFormat format) {
+  if (format == MeshFormat::kByExtension) {
+    if (HasExtension(path, ".mesh")) {
+      format = MeshFormat::kMesh;
+    } else if (HasExtension(path, ".ply")) {
+      format = MeshFormat::kPly;
+    } else if (HasExtension(path, ".3mf")) {
+      format = MeshFormat::kThreeMf;
+    } else {
+      format = MeshFormat::kStl;
+    }
+  }
+  switch (format) {
+    case MeshFormat::kMesh:
+      WriteMesh(path, points, triangles);
+      return;
+    case MeshFormat::kPly:
+      SavePly(path, points, triangles);
+      return;
+    case MeshFormat::kThreeMf:
+      WriteThreeMf(path, points, triangles);
+      return;
+    case MeshFormat::kStl:
+    case MeshFormat::kByExtension:
+    default:
+      WriteBinaryStl(path, points, triangles);
+      return;
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+enum class MeshFormat { kByExtension, kStl, kPly, kMesh, kThreeMf };
+
+// Remove a --format=(stl|ply|mesh|3mf) flag from argv, like InitStats does for
+// --stats, and return the format, or kByExtension if there is none. Exits on
+// an unknown format.
+MeshFormat ParseFormatFlag(int32_t *argc, char *argv[]);
+
+// Remove a --streaming flag from argv and return whether it was there. Tools
+// with it transform binary STL to binary STL through StreamTransformStl, in
+// constant memory and without welding.
+bool ParseStreamingFlag(int32_t *argc, char *argv[]);
+
+// Exit unless both paths are binary STL as ReadMeshFile and WriteMeshFile
+// would treat them, which is all streaming supports, and are different files.
+void CheckStreamingPaths(const std::string &input_path, const std::string &output_path, MeshFormat format);
+
+// Read or write a mesh, picking the format from the file extension unless
+// one is given: .mesh is the indexed native format, .ply is PLY, .3mf is 3MF
+// (write only), anything else binary STL. ReadMeshFile appends like
+// ReadBinarySTL does.
+void ReadMeshFile(const std::string &path,
+                  std::vector<glm::vec3> &points,
+                  std::vector<glm::ivec3> &triangles);
+
+void WriteMeshFile(const std::string &path,
+                   const std::vector<glm::vec3> &points,
+                   const std::vector<glm::ivec3> &triangles,
+                   MeshFormat format = MeshFormat::kByExtension);
+
+bool HasExtension(const std::string &path, const std::string &extension);
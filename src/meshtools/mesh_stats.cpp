@@ -0,0 +1,156 @@
+#include "mesh_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "src/meshtools/mapped_file.hpp"
+#include "src/meshtools/mesh_io.hpp"
+#include "src/meshtools/normals.hpp"
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/stl.hpp"
+
+namespace {
+
+// Triangles per block. Block areas are summed in order for determinism.
+constexpr uint64_t kBlockTriangles = 1 << 16;
+// Triangle areas computed at once within a block.
+constexpr uint64_t kAreaTriangles = 1024;
+
+// HyperLogLog with 2^14 one byte registers.
+constexpr uint32_t kHllBits = 14;
+constexpr uint64_t kHllRegisters = uint64_t{1} << kHllBits;
+
+// 64 bit hash of a vertex's float bits, finished with the murmur3 mixer so
+// every output bit depends on every input bit.
+inline uint64_t HashVertex(const glm::vec3 &vertex) {
+  uint32_t bits[3];
+  memcpy(bits, &vertex, 12);
+  uint64_t h = (uint64_t{bits[0]} | uint64_t{bits[1]} << 32) * 0x9e3779b97f4a7c15ull;
+  h ^= (uint64_t{bits[2]} + 0x632be59bd9b4e019ull) * 0xc2b2ae3d27d4eb4full;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+inline void HllAdd(const uint64_t hash, uint8_t *registers) {
+  // The top bits pick the register, the rest give the rank of the first one.
+  const uint64_t rest = hash << kHllBits | uint64_t{1} << (kHllBits - 1);
+  const uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+  uint8_t &reg = registers[hash >> (64 - kHllBits)];
+  reg = std::max(reg, rank);
+}
+
+// Flajolet et al. with the small range correction. 64 bit hashes need no
+// large range correction at mesh sizes.
+double HllEstimate(const uint8_t *registers) {
+  const double m = static_cast<double>(kHllRegisters);
+  double sum = 0;
+  uint64_t zeros = 0;
+  for (uint64_t i = 0; i < kHllRegisters; i++) {
+    sum += std::ldexp(1.0, -registers[i]);
+    zeros += registers[i] == 0;
+  }
+  const double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+  if (estimate <= 2.5 * m && zeros > 0) {
+    return m * std::log(m / static_cast<double>(zeros));
+  }
+  return estimate;
+}
+
+}  // namespace
+
+MeshStats ComputeMeshStats(const CornerView &corners, const bool estimate_unique_vertices) {
+  const ScopedStage stage("mesh_stats");
+  const uint64_t num_blocks = (corners.num_triangles + kBlockTriangles - 1) / kBlockTriangles;
+  const uint32_t num_chunks = static_cast<uint32_t>(std::min<uint64_t>(NumThreads(), std::max<uint64_t>(1, num_blocks)));
+  std::vector<double> block_areas(num_blocks, 0.0);
+  std::vector<MeshStats> chunk_stats(num_chunks);
+  std::vector<uint8_t> registers(estimate_unique_vertices ? num_chunks * kHllRegisters : 0, 0);
+
+  ParallelForChunks(num_blocks, num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    MeshStats &stats = chunk_stats[chunk];
+    uint8_t *chunk_registers = estimate_unique_vertices ? &registers[chunk * kHllRegisters] : nullptr;
+    for (uint64_t block = begin; block < end; block++) {
+      const uint64_t first = block * kBlockTriangles;
+      const uint64_t last = std::min(first + kBlockTriangles, corners.num_triangles);
+      // Branch-free min/max per triangle, so this vectorizes.
+      glm::vec3 min = stats.min;
+      glm::vec3 max = stats.max;
+      for (uint64_t t = first; t < last; t++) {
+        glm::vec3 p[3];
+        memcpy(p, corners.base + t * corners.triangle_stride, 36);
+        min = glm::min(min, glm::min(p[0], glm::min(p[1], p[2])));
+        max = glm::max(max, glm::max(p[0], glm::max(p[1], p[2])));
+      }
+      double area = 0;
+      float areas[kAreaTriangles];
+      for (uint64_t sub = first; sub < last; sub += kAreaTriangles) {
+        const uint64_t sub_last = std::min(sub + kAreaTriangles, last);
+        FaceNormals(corners, sub, sub_last, nullptr, areas);
+        for (uint64_t i = 0; i < sub_last - sub; i++) {
+          area += double{areas[i]};
+        }
+      }
+      if (chunk_registers != nullptr) {
+        for (uint64_t t = first; t < last; t++) {
+          glm::vec3 p[3];
+          memcpy(p, corners.base + t * corners.triangle_stride, 36);
+          for (int k = 0; k < 3; k++) {
+            HllAdd(HashVertex(p[k]), chunk_registers);
+          }
+        }
+      }
+      stats.min = min;
+      stats.max = max;
+      block_areas[block] = area;
+    }
+  });
+
+  MeshStats stats;
+  stats.num_triangles = corners.num_triangles;
+  for (const MeshStats &other : chunk_stats) {
+    stats.min = glm::min(stats.min, other.min);
+    stats.max = glm::max(stats.max, other.max);
+  }
+  for (const double area : block_areas) {
+    stats.surface_area += area;
+  }
+  if (estimate_unique_vertices) {
+    for (uint32_t chunk = 1; chunk < num_chunks; chunk++) {
+      for (uint64_t i = 0; i < kHllRegisters; i++) {
+        registers[i] = std::max(registers[i], registers[chunk * kHllRegisters + i]);
+      }
+    }
+    stats.unique_vertices = corners.num_triangles > 0 ? HllEstimate(registers.data()) : 0;
+  }
+  return stats;
+}
+
+MeshStats MeshFileStats(const std::string &path, const bool estimate_unique_vertices) {
+  if (HasExtension(path, ".mesh") || HasExtension(path, ".ply") || HasExtension(path, ".3mf")) {
+    std::vector<glm::vec3> points;
+    std::vector<glm::ivec3> triangles;
+    ReadMeshFile(path, points, triangles);
+    std::vector<glm::vec3> soup(3 * triangles.size());
+    for (uint64_t t = 0; t < triangles.size(); t++) {
+      for (int k = 0; k < 3; k++) {
+        soup[3 * t + static_cast<uint64_t>(k)] = points[static_cast<uint64_t>(triangles[t][k])];
+      }
+    }
+    CornerView corners;
+    corners.base = reinterpret_cast<const uint8_t *>(soup.data());
+    corners.num_triangles = triangles.size();
+    return ComputeMeshStats(corners, estimate_unique_vertices);
+  }
+  const MappedFile file(path);
+  const MeshStats stats = ComputeMeshStats(ParseBinaryStl(file.data(), file.size()).Corners(), estimate_unique_vertices);
+  StatsAdd("stl_bytes_read", file.size());
+  StatsAdd("stl_triangles_read", stats.num_triangles);
+  return stats;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+
+#include "src/meshtools/weld.hpp"
+
+// Summary of a triangle soup from one pass over its corners.
+struct MeshStats {
+  uint64_t num_triangles = 0;
+  // Bounding box, inverted (min > max) when there are no triangles.
+  glm::vec3 min = glm::vec3(INFINITY);
+  glm::vec3 max = glm::vec3(-INFINITY);
+  double surface_area = 0;
+  // HyperLogLog estimate of the number of distinct vertex positions, by float
+  // bits like the weld, with about 0.8% standard error. 0 unless requested.
+  double unique_vertices = 0;
+};
+
+// Stats of the corners, e.g. the records of a memory mapped binary STL,
+// without welding or allocating per vertex. Fixed blocks of triangles are
+// scanned in parallel and their areas summed in block order, so the result
+// does not depend on the thread count.
+MeshStats ComputeMeshStats(const CornerView &corners, bool estimate_unique_vertices);
+
+// ComputeMeshStats of a mesh file. Binary STL is mapped and scanned in place;
+// other formats are read with ReadMeshFile first.
+MeshStats MeshFileStats(const std::string &path, bool estimate_unique_vertices);
@@ -0,0 +1,233 @@
+#include "normals.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Triangles gathered per block, a multiple of the widest vector.
+constexpr uint64_t kBlockTriangles = 64;
+
+// Corners of a block of triangles, p[3 * corner + axis][triangle], and the
+// results, one array per normal coordinate. Lanes past the end of the last
+// block hold stale or zero corners and their results are dropped.
+struct BlockLanes {
+  alignas(64) float p[9][kBlockTriangles] = {};
+  alignas(64) float n[3][kBlockTriangles] = {};
+  alignas(64) float area[kBlockTriangles] = {};
+};
+
+using NormalsKernel = void (*)(BlockLanes *lanes);
+
+// Each kernel does exactly what glm::triangleNormal(p0, p1, p2) does, in the
+// same order: a = p0 - p1, b = p0 - p2, c = cross(a, b), then c * (1 /
+// sqrt(dot(c, c))).
+void NormalsScalar(BlockLanes *lanes) {
+  for (uint64_t i = 0; i < kBlockTriangles; i++) {
+    const float ax = lanes->p[0][i] - lanes->p[3][i];
+    const float ay = lanes->p[1][i] - lanes->p[4][i];
+    const float az = lanes->p[2][i] - lanes->p[5][i];
+    const float bx = lanes->p[0][i] - lanes->p[6][i];
+    const float by = lanes->p[1][i] - lanes->p[7][i];
+    const float bz = lanes->p[2][i] - lanes->p[8][i];
+    const float cx = ay * bz - by * az;
+    const float cy = az * bx - bz * ax;
+    const float cz = ax * by - bx * ay;
+    const float length = std::sqrt(cx * cx + cy * cy + cz * cz);
+    const float inverse = 1.0f / length;
+    lanes->n[0][i] = cx * inverse;
+    lanes->n[1][i] = cy * inverse;
+    lanes->n[2][i] = cz * inverse;
+    lanes->area[i] = 0.5f * length;
+  }
+}
+
+#if defined(__x86_64__)
+
+void NormalsSse2(BlockLanes *lanes) {
+  for (uint64_t i = 0; i < kBlockTriangles; i += 4) {
+    const __m128 x0 = _mm_load_ps(&lanes->p[0][i]);
+    const __m128 y0 = _mm_load_ps(&lanes->p[1][i]);
+    const __m128 z0 = _mm_load_ps(&lanes->p[2][i]);
+    const __m128 ax = _mm_sub_ps(x0, _mm_load_ps(&lanes->p[3][i]));
+    const __m128 ay = _mm_sub_ps(y0, _mm_load_ps(&lanes->p[4][i]));
+    const __m128 az = _mm_sub_ps(z0, _mm_load_ps(&lanes->p[5][i]));
+    const __m128 bx = _mm_sub_ps(x0, _mm_load_ps(&lanes->p[6][i]));
+    const __m128 by = _mm_sub_ps(y0, _mm_load_ps(&lanes->p[7][i]));
+    const __m128 bz = _mm_sub_ps(z0, _mm_load_ps(&lanes->p[8][i]));
+    const __m128 cx = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(by, az));
+    const __m128 cy = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(bz, ax));
+    const __m128 cz = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(bx, ay));
+    const __m128 length =
+        _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz)));
+    const __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), length);
+    _mm_store_ps(&lanes->n[0][i], _mm_mul_ps(cx, inverse));
+    _mm_store_ps(&lanes->n[1][i], _mm_mul_ps(cy, inverse));
+    _mm_store_ps(&lanes->n[2][i], _mm_mul_ps(cz, inverse));
+    _mm_store_ps(&lanes->area[i], _mm_mul_ps(_mm_set1_ps(0.5f), length));
+  }
+}
+
+__attribute__((target("avx2"))) void NormalsAvx2(BlockLanes *lanes) {
+  for (uint64_t i = 0; i < kBlockTriangles; i += 8) {
+    const __m256 x0 = _mm256_load_ps(&lanes->p[0][i]);
+    const __m256 y0 = _mm256_load_ps(&lanes->p[1][i]);
+    const __m256 z0 = _mm256_load_ps(&lanes->p[2][i]);
+    const __m256 ax = _mm256_sub_ps(x0, _mm256_load_ps(&lanes->p[3][i]));
+    const __m256 ay = _mm256_sub_ps(y0, _mm256_load_ps(&lanes->p[4][i]));
+    const __m256 az = _mm256_sub_ps(z0, _mm256_load_ps(&lanes->p[5][i]));
+    const __m256 bx = _mm256_sub_ps(x0, _mm256_load_ps(&lanes->p[6][i]));
+    const __m256 by = _mm256_sub_ps(y0, _mm256_load_ps(&lanes->p[7][i]));
+    const __m256 bz = _mm256_sub_ps(z0, _mm256_load_ps(&lanes->p[8][i]));
+    const __m256 cx = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(by, az));
+    const __m256 cy = _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(bz, ax));
+    const __m256 cz = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(bx, ay));
+    const __m256 length = _mm256_sqrt_ps(
+        _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), _mm256_mul_ps(cy, cy)), _mm256_mul_ps(cz, cz)));
+    const __m256 inverse = _mm256_div_ps(_mm256_set1_ps(1.0f), length);
+    _mm256_store_ps(&lanes->n[0][i], _mm256_mul_ps(cx, inverse));
+    _mm256_store_ps(&lanes->n[1][i], _mm256_mul_ps(cy, inverse));
+    _mm256_store_ps(&lanes->n[2][i], _mm256_mul_ps(cz, inverse));
+    _mm256_store_ps(&lanes->area[i], _mm256_mul_ps(_mm256_set1_ps(0.5f), length));
+  }
+}
+
+__attribute__((target("avx512f"))) void NormalsAvx512(BlockLanes *lanes) {
+  for (uint64_t i = 0; i < kBlockTriangles; i += 16) {
+    const __m512 x0 = _mm512_load_ps(&lanes->p[0][i]);
+    const __m512 y0 = _mm512_load_ps(&lanes->p[1][i]);
+    const __m512 z0 = _mm512_load_ps(&lanes->p[2][i]);
+    const __m512 ax = _mm512_sub_ps(x0, _mm512_load_ps(&lanes->p[3][i]));
+    const __m512 ay = _mm512_sub_ps(y0, _mm512_load_ps(&lanes->p[4][i]));
+    const __m512 az = _mm512_sub_ps(z0, _mm512_load_ps(&lanes->p[5][i]));
+    const __m512 bx = _mm512_sub_ps(x0, _mm512_load_ps(&lanes->p[6][i]));
+    const __m512 by = _mm512_sub_ps(y0, _mm512_load_ps(&lanes->p[7][i]));
+    const __m512 bz = _mm512_sub_ps(z0, _mm512_load_ps(&lanes->p[8][i]));
+    const __m512 cx = _mm512_sub_ps(_mm512_mul_ps(ay, bz), _mm512_mul_ps(by, az));
+    const __m512 cy = _mm512_sub_ps(_mm512_mul_ps(az, bx), _mm512_mul_ps(bz, ax));
+    const __m512 cz = _mm512_sub_ps(_mm512_mul_ps(ax, by), _mm512_mul_ps(bx, ay));
+    // The all-lanes mask form, since _mm512_sqrt_ps trips -Wuninitialized in
+    // GCC 12's headers. Same instruction.
+    const __m512 length = _mm512_maskz_sqrt_ps(
+        0xffff, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(cx, cx), _mm512_mul_ps(cy, cy)), _mm512_mul_ps(cz, cz)));
+    const __m512 inverse = _mm512_div_ps(_mm512_set1_ps(1.0f), length);
+    _mm512_store_ps(&lanes->n[0][i], _mm512_mul_ps(cx, inverse));
+    _mm512_store_ps(&lanes->n[1][i], _mm512_mul_ps(cy, inverse));
+    _mm512_store_ps(&lanes->n[2][i], _mm512_mul_ps(cz, inverse));
+    _mm512_store_ps(&lanes->area[i], _mm512_mul_ps(_mm512_set1_ps(0.5f), length));
+  }
+}
+
+#endif
+
+struct KernelChoice {
+  const char *isa;
+  NormalsKernel kernel;
+};
+
+// The widest kernel the CPU supports, no wider than MESHTOOLS_SIMD.
+const KernelChoice &SelectedKernel() {
+  static const KernelChoice selected = [] {
+    struct Candidate {
+      KernelChoice choice;
+      bool supported;
+    };
+    // Widest first.
+    const Candidate candidates[] = {
+#if defined(__x86_64__)
+        {{"avx512", NormalsAvx512}, __builtin_cpu_supports("avx512f") != 0},
+        {{"avx2", NormalsAvx2}, __builtin_cpu_supports("avx2") != 0},
+        {{"sse2", NormalsSse2}, true},
+#endif
+        {{"scalar", NormalsScalar}, true},
+    };
+    const char *env = std::getenv("MESHTOOLS_SIMD");
+    bool allowed = env == nullptr || *env == '\0';
+    for (const Candidate &candidate : candidates) {
+      allowed = allowed || strcmp(env, candidate.choice.isa) == 0;
+      if (allowed && candidate.supported) {
+        return candidate.choice;
+      }
+    }
+    fprintf(stderr, "Unknown MESHTOOLS_SIMD=%s, expected avx512, avx2, sse2 or scalar.\n", env);
+    std::exit(1);
+  }();
+  return selected;
+}
+
+// Run the kernel on blocks of corners from `gather(first, count, lanes)` and
+// scatter the results.
+template <typename Gather>
+void BlockedFaceNormals(const uint64_t begin,
+                        const uint64_t end,
+                        glm::vec3 *normals,
+                        float *areas,
+                        const Gather &gather) {
+  const NormalsKernel kernel = SelectedKernel().kernel;
+  BlockLanes lanes;
+  for (uint64_t first = begin; first < end; first += kBlockTriangles) {
+    const uint64_t count = std::min(kBlockTriangles, end - first);
+    gather(first, count, &lanes);
+    kernel(&lanes);
+    if (normals != nullptr) {
+      glm::vec3 *out = normals + (first - begin);
+      for (uint64_t i = 0; i < count; i++) {
+        out[i] = glm::vec3(lanes.n[0][i], lanes.n[1][i], lanes.n[2][i]);
+      }
+    }
+    if (areas != nullptr) {
+      memcpy(areas + (first - begin), lanes.area, count * sizeof(float));
+    }
+  }
+}
+
+void SetCorner(const glm::vec3 &point, const uint64_t corner, const uint64_t i, BlockLanes *lanes) {
+  lanes->p[3 * corner][i] = point.x;
+  lanes->p[3 * corner + 1][i] = point.y;
+  lanes->p[3 * corner + 2][i] = point.z;
+}
+
+}  // namespace
+
+void FaceNormals(const std::vector<glm::vec3> &points,
+                 const std::vector<glm::ivec3> &triangles,
+                 const uint64_t begin,
+                 const uint64_t end,
+                 glm::vec3 *normals,
+                 float *areas) {
+  BlockedFaceNormals(begin, end, normals, areas, [&](const uint64_t first, const uint64_t count, BlockLanes *lanes) {
+    for (uint64_t i = 0; i < count; i++) {
+      const glm::ivec3 &triangle = triangles[first + i];
+      SetCorner(points[static_cast<uint64_t>(triangle.x)], 0, i, lanes);
+      SetCorner(points[static_cast<uint64_t>(triangle.y)], 1, i, lanes);
+      SetCorner(points[static_cast<uint64_t>(triangle.z)], 2, i, lanes);
+    }
+  });
+}
+
+void FaceNormals(const CornerView &corners,
+                 const uint64_t begin,
+                 const uint64_t end,
+                 glm::vec3 *normals,
+                 float *areas) {
+  BlockedFaceNormals(begin, end, normals, areas, [&](const uint64_t first, const uint64_t count, BlockLanes *lanes) {
+    for (uint64_t i = 0; i < count; i++) {
+      glm::vec3 p[3];
+      memcpy(p, corners.base + (first + i) * corners.triangle_stride, 36);
+      for (uint64_t k = 0; k < 3; k++) {
+        SetCorner(p[k], k, i, lanes);
+      }
+    }
+  });
+}
+
+const char *FaceNormalsIsa() {
+  return SelectedKernel().isa;
+}
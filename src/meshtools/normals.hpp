@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "src/meshtools/weld.hpp"
+
+// Unit normals and areas of triangles [begin, end), written to normals[0,
+// end - begin) and areas[0, end - begin). Either output may be null. Corners
+// are gathered into one array per coordinate a block at a time and the cross
+// products and normalization run 16, 8 or 4 triangles at a time with
+// AVX-512, AVX2 or SSE2, whichever the CPU has, or one at a time elsewhere.
+// The normalization is a true square root and divide, not the approximate
+// reciprocal square root, because that differs between CPU vendors and
+// instruction sets. With the library built with -ffp-contract=off, every path
+// is within 0 ULP of glm::triangleNormal(p0, p1, p2) and the area is the
+// matching 0.5 * length(cross(p1 - p0, p2 - p0)). Degenerate triangles get
+// NaN normals, as from glm. Runs on the calling thread.
+void FaceNormals(const std::vector<glm::vec3> &points,
+                 const std::vector<glm::ivec3> &triangles,
+                 uint64_t begin,
+                 uint64_t end,
+                 glm::vec3 *normals,
+                 float *areas);
+
+// Same for triangles [begin, end) of a corner view.
+void FaceNormals(const CornerView &corners, uint64_t begin, uint64_t end, glm::vec3 *normals, float *areas);
+
+// Instruction set FaceNormals uses: "avx512", "avx2", "sse2" or "scalar". The
+// MESHTOOLS_SIMD environment variable set to one of these caps it, to compare
+// or time the narrower paths.
+const char *FaceNormalsIsa();
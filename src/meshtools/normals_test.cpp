@@ -0,0 +1,92 @@
+#define GLM_ENABLE_EXPERIMENTAL
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtx/normal.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/normals.hpp"
+
+// Check FaceNormals against glm::triangleNormal bit for bit, on whichever
+// instruction set MESHTOOLS_SIMD and the CPU select.
+
+static bool SameBits(const float a, const float b) {
+  return (std::isnan(a) && std::isnan(b)) || memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Triangle soup of terrain-like small triangles across a large extent, plus
+// thin, tiny and degenerate ones. Not a multiple of any block size.
+static std::vector<glm::vec3> SyntheticCorners() {
+  std::mt19937_64 rng(0);
+  std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+  std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+  std::vector<glm::vec3> corners;
+  for (int32_t t = 0; t < 10007; t++) {
+    const glm::vec3 p0(position(rng), position(rng), position(rng));
+    corners.push_back(p0);
+    corners.push_back(p0 + glm::vec3(offset(rng), offset(rng), offset(rng)));
+    corners.push_back(p0 + glm::vec3(offset(rng), offset(rng), offset(rng)));
+  }
+  const glm::vec3 p(3.0f, 4.0f, 5.0f);
+  const glm::vec3 special[][3] = {
+      {p, p, p},
+      {p, p + glm::vec3(1.0f, 0.0f, 0.0f), p + glm::vec3(2.0f, 0.0f, 0.0f)},
+      {p, p + glm::vec3(1e-6f, 0.0f, 0.0f), p + glm::vec3(0.0f, 1e-6f, 0.0f)},
+      {glm::vec3(1e30f), glm::vec3(-1e30f, 1e30f, 0.0f), glm::vec3(0.0f, -1e30f, 1e30f)},
+  };
+  for (const auto &triangle : special) {
+    corners.insert(corners.end(), triangle, triangle + 3);
+  }
+  return corners;
+}
+
+static bool Check(const std::string &name, const std::vector<glm::vec3> &corners, const uint64_t begin,
+                  const std::vector<glm::vec3> &normals, const std::vector<float> &areas) {
+  uint64_t mismatches = 0;
+  for (uint64_t i = 0; i < normals.size(); i++) {
+    const glm::vec3 &p0 = corners[3 * (begin + i)];
+    const glm::vec3 &p1 = corners[3 * (begin + i) + 1];
+    const glm::vec3 &p2 = corners[3 * (begin + i) + 2];
+    const glm::vec3 expected = glm::triangleNormal(p0, p1, p2);
+    const float expected_area = 0.5f * glm::length(glm::cross(p1 - p0, p2 - p0));
+    if (!SameBits(expected.x, normals[i].x) || !SameBits(expected.y, normals[i].y) ||
+        !SameBits(expected.z, normals[i].z) || !SameBits(expected_area, areas[i])) {
+      mismatches++;
+    }
+  }
+  printf("%-8s %-8s %8zu triangles  %llu mismatches  %s\n", FaceNormalsIsa(), name.c_str(), normals.size(),
+         static_cast<unsigned long long>(mismatches), mismatches == 0 ? "ok" : "FAILED");
+  return mismatches == 0;
+}
+
+int32_t main() {
+  bool ok = true;
+  const std::vector<glm::vec3> corners = SyntheticCorners();
+  const uint64_t num_triangles = corners.size() / 3;
+  // Start off a block boundary so both partial blocks are covered.
+  const uint64_t begin = 5;
+  std::vector<glm::vec3> normals(num_triangles - begin);
+  std::vector<float> areas(num_triangles - begin);
+
+  CornerView view;
+  view.base = reinterpret_cast<const uint8_t *>(corners.data());
+  view.num_triangles = num_triangles;
+  FaceNormals(view, begin, num_triangles, normals.data(), areas.data());
+  ok &= Check("corners", corners, begin, normals, areas);
+
+  std::vector<glm::ivec3> triangles(num_triangles);
+  for (uint64_t t = 0; t < num_triangles; t++) {
+    const int32_t first = static_cast<int32_t>(3 * t);
+    triangles[t] = glm::ivec3(first, first + 1, first + 2);
+  }
+  normals.assign(normals.size(), glm::vec3(0.0f));
+  areas.assign(areas.size(), 0.0f);
+  FaceNormals(corners, triangles, begin, num_triangles, normals.data(), areas.data());
+  ok &= Check("indexed", corners, begin, normals, areas);
+
+  return ok ? 0 : 1;
+}
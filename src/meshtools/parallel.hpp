@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Number of worker threads to use. Defaults to the hardware concurrency and
+// can be overridden with the MESHTOOLS_THREADS environment variable.
+inline uint32_t NumThreads() {
+  static const uint32_t num_threads = [] {
+    const char *env = std::getenv("MESHTOOLS_THREADS");
+    if (env != nullptr && std::atoi(env) > 0) {
+      return static_cast<uint32_t>(std::atoi(env));
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+  }();
+  return num_threads;
+}
+
+// Split [0, n) into `num_chunks` contiguous ranges of near equal size and call
+// fn(begin, end, chunk) for each one on its own thread. Chunk boundaries only
+// depend on `n` and `num_chunks`, so results that are combined in chunk order
+// are deterministic.
+template <typename Fn>
+void ParallelForChunks(const uint64_t n, const uint32_t num_chunks, Fn &&fn) {
+  if (num_chunks <= 1) {
+    fn(uint64_t{0}, n, uint32_t{0});
+    return;
+  }
+  std::vector<std::thread> threads;
+  threads.reserve(num_chunks - 1);
+  for (uint32_t chunk = 1; chunk < num_chunks; chunk++) {
+    threads.emplace_back([&fn, n, num_chunks, chunk] {
+      fn(n * chunk / num_chunks, n * (chunk + 1) / num_chunks, chunk);
+    });
+  }
+  fn(uint64_t{0}, n / num_chunks, uint32_t{0});
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+// Like ParallelForChunks, but picks the number of chunks so that each one has
+// at least `min_chunk_size` elements and there are no more than NumThreads().
+template <typename Fn>
+void ParallelFor(const uint64_t n, const uint64_t min_chunk_size, Fn &&fn) {
+  const uint64_t max_chunks = std::max<uint64_t>(1, n / std::max<uint64_t>(1, min_chunk_size));
+  const uint32_t num_chunks = static_cast<uint32_t>(std::min<uint64_t>(NumThreads(), max_chunks));
+  ParallelForChunks(n, num_chunks, fn);
+}
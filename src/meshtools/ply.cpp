@@ -1,91 +1,506 @@
 #include "ply.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <limits>
+#include <sstream>
 
-void WritePlyHeader(FILE * const output, const uint32_t vertex_count, const uint32_t triangle_count) {
-  fprintf(output, "ply\r\n");
-  fprintf(output, "format binary_little_endian 1.0\r\n");
-  fprintf(output, "element vertex %u\r\n", vertex_count);
-  fprintf(output, "property float x\r\n");
-  fprintf(output, "property float y\r\n");
-  fprintf(output, "property float z\r\n");
-  fprintf(output, "element face %u\r\n", triangle_count);
-  fprintf(output, "property list uchar uint vertex_indices\r\n");
-  fprintf(output, "end_header\r\n");
+#include "src/meshtools/mapped_file.hpp"
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+
+namespace {
+
+uint64_t TypeSize(const PlyType type) {
+  switch (type) {
+    case PlyType::kInt8: return 1;
+    case PlyType::kUint8: return 1;
+    case PlyType::kInt16: return 2;
+    case PlyType::kUint16: return 2;
+    case PlyType::kInt32: return 4;
+    case PlyType::kUint32: return 4;
+    case PlyType::kFloat32: return 4;
+    case PlyType::kFloat64: return 8;
+    default: return 0;
+  }
 }
 
-void ReadPlyHeader(FILE * const input, uint32_t *vertex_count, uint32_t *triangle_count) {
-  char buffer[81];
-  int lol = 0;
+bool ParseType(const std::string &name, PlyType *type) {
+  static const std::pair<const char *, PlyType> kTypes[] = {
+      {"char", PlyType::kInt8},     {"int8", PlyType::kInt8},
+      {"uchar", PlyType::kUint8},   {"uint8", PlyType::kUint8},
+      {"short", PlyType::kInt16},   {"int16", PlyType::kInt16},
+      {"ushort", PlyType::kUint16}, {"uint16", PlyType::kUint16},
+      {"int", PlyType::kInt32},     {"int32", PlyType::kInt32},
+      {"uint", PlyType::kUint32},   {"uint32", PlyType::kUint32},
+      {"float", PlyType::kFloat32}, {"float32", PlyType::kFloat32},
+      {"double", PlyType::kFloat64}, {"float64", PlyType::kFloat64},
+  };
+  for (const auto &[type_name, value] : kTypes) {
+    if (name == type_name) {
+      *type = value;
+      return true;
+    }
+  }
+  return false;
+}
 
-  //fprintf(output, "ply\r\n");
-  lol = fscanf(input, "%80s\n", buffer);
+// Decode one binary scalar of `type` at `p`.
+inline double DecodeBinary(const uint8_t *p, const PlyType type, const bool big_endian) {
+  uint8_t bytes[8];
+  const uint64_t size = TypeSize(type);
+  if (big_endian) {
+    for (uint64_t i = 0; i < size; i++) {
+      bytes[i] = p[size - 1 - i];
+    }
+  } else {
+    memcpy(bytes, p, size);
+  }
+  switch (type) {
+    case PlyType::kInt8: { int8_t v; memcpy(&v, bytes, 1); return v; }
+    case PlyType::kUint8: return bytes[0];
+    case PlyType::kInt16: { int16_t v; memcpy(&v, bytes, 2); return v; }
+    case PlyType::kUint16: { uint16_t v; memcpy(&v, bytes, 2); return v; }
+    case PlyType::kInt32: { int32_t v; memcpy(&v, bytes, 4); return v; }
+    case PlyType::kUint32: { uint32_t v; memcpy(&v, bytes, 4); return v; }
+    case PlyType::kFloat32: { float v; memcpy(&v, bytes, 4); return static_cast<double>(v); }
+    case PlyType::kFloat64: { double v; memcpy(&v, bytes, 8); return v; }
+    default: return 0;
+  }
+}
+
+// Sequential reader over the body of a PLY file, for the general case.
+class PlyBodyReader {
+ public:
+  PlyBodyReader(const uint8_t *data, const uint64_t size, const uint64_t offset, const PlyFormat format)
+      : data_(data), size_(size), offset_(offset), format_(format) {}
 
-  //fprintf(output, "format binary_little_endian 1.0\r\n");
-  lol = fscanf(input, "%80s %80s %80s\n", buffer, buffer, buffer);
+  uint64_t offset() const { return offset_; }
+  void Skip(const uint64_t bytes) {
+    Require(bytes);
+    offset_ += bytes;
+  }
+
+  double Read(const PlyType type) {
+    if (format_ == PlyFormat::kAscii) {
+      return ReadAscii();
+    }
+    const uint64_t size = TypeSize(type);
+    Require(size);
+    const double value = DecodeBinary(data_ + offset_, type, format_ == PlyFormat::kBinaryBigEndian);
+    offset_ += size;
+    return value;
+  }
 
-  //fprintf(output, "element vertex %u\r\n", vertex_count);
-  lol = fscanf(input, "%s %s %u\n", buffer, buffer, vertex_count);
+  // Read one whole property and discard it.
+  void SkipProperty(const PlyProperty &property) {
+    if (!property.is_list) {
+      Read(property.type);
+      return;
+    }
+    const uint64_t count = ReadCount(property.count_type);
+    if (format_ != PlyFormat::kAscii) {
+      Skip(count * TypeSize(property.type));
+      return;
+    }
+    for (uint64_t k = 0; k < count; k++) {
+      Read(property.type);
+    }
+  }
 
-  //fprintf(output, "property float x\r\n");
-  //fprintf(output, "property float y\r\n");
-  //fprintf(output, "property float z\r\n");
-  for (int k=0; k<3; k++) {
-    lol = fscanf(input, "%s %s %s\n", buffer, buffer, buffer);
+  // Read a list count. Every item takes at least one byte, so a count larger
+  // than the rest of the file is malformed.
+  uint64_t ReadCount(const PlyType type) {
+    const double count = Read(type);
+    if (!(count >= 0 && count <= static_cast<double>(size_ - offset_))) {
+      fprintf(stderr, "Error reading PLY: list count %g out of range\n", count);
+      std::exit(1);
+    }
+    return static_cast<uint64_t>(count);
   }
 
-  //fprintf(output, "element face %u\r\n", triangle_count);
-  lol = fscanf(input, "%80s %80s %u\n", buffer, buffer, triangle_count);
+ private:
+  void Require(const uint64_t bytes) const {
+    if (bytes > size_ - offset_) {
+      fprintf(stderr, "Error reading PLY: unexpected end of file\n");
+      std::exit(1);
+    }
+  }
 
-  //fprintf(output, "property list uchar uint vertex_indices\r\n");
-  lol = fscanf(input, "%80s %80s %80s %80s %80s\n", buffer, buffer, buffer, buffer, buffer);
+  double ReadAscii() {
+    while (offset_ < size_ && strchr(" \t\r\n", static_cast<char>(data_[offset_])) != nullptr) {
+      offset_++;
+    }
+    char token[64];
+    uint64_t length = 0;
+    while (offset_ < size_ && length + 1 < sizeof(token) && strchr(" \t\r\n", static_cast<char>(data_[offset_])) == nullptr) {
+      token[length++] = static_cast<char>(data_[offset_++]);
+    }
+    token[length] = '\0';
+    char *end = nullptr;
+    const double value = strtod(token, &end);
+    if (length == 0 || end != token + length) {
+      fprintf(stderr, "Error reading PLY: bad ascii value '%s'\n", token);
+      std::exit(1);
+    }
+    return value;
+  }
 
-  //fprintf(output, "end_header\r\n");
-  lol = fscanf(input, "%80s\n", buffer);
+  const uint8_t *data_;
+  uint64_t size_;
+  uint64_t offset_;
+  PlyFormat format_;
+};
 
-  (void)lol;
+int64_t FindProperty(const PlyElement &element, const std::string &name) {
+  for (uint64_t k = 0; k < element.properties.size(); k++) {
+    if (element.properties[k].name == name) {
+      return static_cast<int64_t>(k);
+    }
+  }
+  return -1;
 }
 
-void WriteTriangleHeader(FILE * const output) {
-  // Write triangle header.
-  const uint8_t three = 3; // This triangle will have three vertices, big surprise.
-  if (fwrite(&three, 1, 1, output) != 1) {
-    fprintf(stderr, "Error writing 'three' as uint8_t\n");
+// Bytes per element if every property is a fixed-size scalar, otherwise 0.
+uint64_t FixedStride(const PlyElement &element) {
+  uint64_t stride = 0;
+  for (const PlyProperty &property : element.properties) {
+    if (property.is_list) {
+      return 0;
+    }
+    stride += TypeSize(property.type);
+  }
+  return stride;
+}
+
+// Fewest bytes one element can take: its scalars and list counts in binary,
+// or one character per value in ascii.
+uint64_t MinElementBytes(const PlyElement &element, const PlyFormat format) {
+  if (format == PlyFormat::kAscii) {
+    return element.properties.size();
+  }
+  uint64_t bytes = 0;
+  for (const PlyProperty &property : element.properties) {
+    bytes += TypeSize(property.is_list ? property.count_type : property.type);
+  }
+  return bytes;
+}
+
+// Exit unless `element.count` elements can fit in the rest of the file, so a
+// hostile count cannot make us allocate for it.
+void CheckElementFits(const PlyElement &element, const PlyFormat format, const uint64_t size, const uint64_t offset) {
+  const uint64_t min_bytes = MinElementBytes(element, format);
+  if (min_bytes > 0 && element.count > (size - offset) / min_bytes) {
+    fprintf(stderr, "Error reading PLY: %llu %s elements do not fit in the rest of the file\n",
+            static_cast<unsigned long long>(element.count), element.name.c_str());
     std::exit(1);
   }
 }
 
-void ReadTriangleHeader(FILE * const input) {
-  // Write triangle header.
-  uint8_t three = 0; // This triangle will have three vertices, big surprise.
-  if (fread(&three, 1, 1, input) != 1) {
-    fprintf(stderr, "Error reading 'three' as uint8_t\n");
+uint64_t PropertyOffset(const PlyElement &element, const int64_t index) {
+  uint64_t offset = 0;
+  for (int64_t k = 0; k < index; k++) {
+    offset += TypeSize(element.properties[static_cast<uint64_t>(k)].type);
+  }
+  return offset;
+}
+
+void ReadVertices(const uint8_t *data, const uint64_t size, const PlyHeader &header, const PlyElement &element,
+                  uint64_t *offset, std::vector<glm::vec3> *points) {
+  int64_t xyz[3] = {FindProperty(element, "x"), FindProperty(element, "y"), FindProperty(element, "z")};
+  for (int k = 0; k < 3; k++) {
+    if (xyz[k] < 0 || element.properties[static_cast<uint64_t>(xyz[k])].is_list) {
+      fprintf(stderr, "Error reading PLY: vertex element needs scalar x, y and z properties\n");
+      std::exit(1);
+    }
+  }
+  // For fixed-stride binary vertices this is the exact size check.
+  CheckElementFits(element, header.format, size, *offset);
+  points->resize(element.count);
+
+  const uint64_t stride = FixedStride(element);
+  if (header.format != PlyFormat::kAscii && stride > 0) {
+    const uint8_t *block = data + *offset;
+    *offset += element.count * stride;
+
+    // Our own layout is exactly an array of glm::vec3.
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float));
+    const bool is_xyz_float = element.properties.size() == 3 && xyz[0] == 0 && xyz[1] == 1 && xyz[2] == 2 &&
+                              element.properties[0].type == PlyType::kFloat32 &&
+                              element.properties[1].type == PlyType::kFloat32 &&
+                              element.properties[2].type == PlyType::kFloat32;
+    if (is_xyz_float && header.format == PlyFormat::kBinaryLittleEndian) {
+      memcpy(points->data(), block, element.count * sizeof(glm::vec3));
+      return;
+    }
+
+    const bool big_endian = header.format == PlyFormat::kBinaryBigEndian;
+    const uint64_t offsets[3] = {PropertyOffset(element, xyz[0]), PropertyOffset(element, xyz[1]), PropertyOffset(element, xyz[2])};
+    const PlyType types[3] = {element.properties[static_cast<uint64_t>(xyz[0])].type,
+                              element.properties[static_cast<uint64_t>(xyz[1])].type,
+                              element.properties[static_cast<uint64_t>(xyz[2])].type};
+    ParallelFor(element.count, 1 << 14, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+      for (uint64_t i = begin; i < end; i++) {
+        for (int k = 0; k < 3; k++) {
+          (*points)[i][k] = static_cast<float>(DecodeBinary(block + i * stride + offsets[k], types[k], big_endian));
+        }
+      }
+    });
+    return;
+  }
+
+  PlyBodyReader reader(data, size, *offset, header.format);
+  for (uint64_t i = 0; i < element.count; i++) {
+    for (uint64_t p = 0; p < element.properties.size(); p++) {
+      const PlyProperty &property = element.properties[p];
+      const int64_t axis = std::find(xyz, xyz + 3, static_cast<int64_t>(p)) - xyz;
+      if (axis < 3) {
+        (*points)[i][static_cast<int>(axis)] = static_cast<float>(reader.Read(property.type));
+      } else {
+        reader.SkipProperty(property);
+      }
+    }
+  }
+  *offset = reader.offset();
+}
+
+void ReadFaces(const uint8_t *data, const uint64_t size, const PlyHeader &header, const PlyElement &element,
+               uint64_t *offset, std::vector<glm::ivec3> *triangles) {
+  int64_t indices_property = FindProperty(element, "vertex_indices");
+  if (indices_property < 0) {
+    indices_property = FindProperty(element, "vertex_index");
+  }
+  if (indices_property < 0 || !element.properties[static_cast<uint64_t>(indices_property)].is_list) {
+    fprintf(stderr, "Error reading PLY: face element needs a vertex_indices list\n");
     std::exit(1);
   }
-  if (three != 3) {
-    fprintf(stderr, "Error reading 'three' in triangle header. It is not 3 it is %d\n", (int32_t)three);
+  const PlyProperty &list = element.properties[static_cast<uint64_t>(indices_property)];
+
+  // Fast path: binary little endian `list uchar (u)int vertex_indices` only,
+  // every face a triangle. That is fixed 13 byte records.
+  constexpr uint64_t kTriangleRecordBytes = 13;
+  const bool fixed_triangles = header.format == PlyFormat::kBinaryLittleEndian &&
+                               element.properties.size() == 1 && list.count_type == PlyType::kUint8 &&
+                               (list.type == PlyType::kInt32 || list.type == PlyType::kUint32) &&
+                               element.count <= (size - *offset) / kTriangleRecordBytes;
+  if (fixed_triangles) {
+    const uint8_t *block = data + *offset;
+    std::atomic<bool> all_triangles(true);
+    ParallelFor(element.count, 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+      for (uint64_t i = begin; i < end; i++) {
+        if (block[i * kTriangleRecordBytes] != 3) {
+          all_triangles = false;
+          return;
+        }
+      }
+    });
+    if (all_triangles) {
+      triangles->resize(element.count);
+      ParallelFor(element.count, 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+        for (uint64_t i = begin; i < end; i++) {
+          memcpy(&(*triangles)[i], block + i * kTriangleRecordBytes + 1, 12);
+        }
+      });
+      *offset += element.count * kTriangleRecordBytes;
+      return;
+    }
+  }
+
+  CheckElementFits(element, header.format, size, *offset);
+  triangles->reserve(element.count);
+  PlyBodyReader reader(data, size, *offset, header.format);
+  std::vector<int32_t> polygon;
+  for (uint64_t i = 0; i < element.count; i++) {
+    for (uint64_t p = 0; p < element.properties.size(); p++) {
+      const PlyProperty &property = element.properties[p];
+      if (p != static_cast<uint64_t>(indices_property)) {
+        reader.SkipProperty(property);
+        continue;
+      }
+      const uint64_t count = reader.ReadCount(property.count_type);
+      if (count < 3) {
+        fprintf(stderr, "Error reading PLY: face %llu has %llu vertices\n",
+                static_cast<unsigned long long>(i), static_cast<unsigned long long>(count));
+        std::exit(1);
+      }
+      polygon.resize(count);
+      for (uint64_t k = 0; k < count; k++) {
+        const double index = reader.Read(property.type);
+        if (!(index >= 0 && index <= std::numeric_limits<int32_t>::max())) {
+          fprintf(stderr, "Error reading PLY: face %llu has vertex index %g\n", static_cast<unsigned long long>(i),
+                  index);
+          std::exit(1);
+        }
+        polygon[k] = static_cast<int32_t>(index);
+      }
+      // Fan triangulate polygons.
+      for (uint64_t k = 1; k + 1 < count; k++) {
+        triangles->push_back({polygon[0], polygon[k], polygon[k + 1]});
+      }
+    }
+  }
+  *offset = reader.offset();
+}
+
+void SkipElement(const uint8_t *data, const uint64_t size, const PlyHeader &header, const PlyElement &element,
+                 uint64_t *offset) {
+  const uint64_t stride = FixedStride(element);
+  PlyBodyReader reader(data, size, *offset, header.format);
+  if (header.format != PlyFormat::kAscii && stride > 0) {
+    if (element.count > (size - *offset) / stride) {
+      fprintf(stderr, "Error reading PLY: unexpected end of file\n");
+      std::exit(1);
+    }
+    reader.Skip(element.count * stride);
+  } else {
+    for (uint64_t i = 0; i < element.count; i++) {
+      for (const PlyProperty &property : element.properties) {
+        reader.SkipProperty(property);
+      }
+    }
+  }
+  *offset = reader.offset();
+}
+
+// Exit if any face refers to a vertex the file does not have. Faces may come
+// before vertices, so this runs once both are read.
+void CheckVertexIndices(const std::vector<glm::ivec3> &triangles, const uint64_t num_vertices) {
+  const uint32_t num_chunks = NumThreads();
+  std::vector<uint64_t> first_bad(num_chunks, triangles.size());
+  ParallelForChunks(triangles.size(), num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    for (uint64_t t = begin; t < end; t++) {
+      bool ok = true;
+      for (int k = 0; k < 3; k++) {
+        ok &= triangles[t][k] >= 0 && static_cast<uint64_t>(triangles[t][k]) < num_vertices;
+      }
+      if (!ok) {
+        first_bad[chunk] = t;
+        return;
+      }
+    }
+  });
+  const uint64_t bad = *std::min_element(first_bad.begin(), first_bad.end());
+  if (bad < triangles.size()) {
+    fprintf(stderr, "Error reading PLY: triangle %llu has vertex indices %d %d %d, but there are %llu vertices\n",
+            static_cast<unsigned long long>(bad), triangles[bad].x, triangles[bad].y, triangles[bad].z,
+            static_cast<unsigned long long>(num_vertices));
     std::exit(1);
   }
 }
 
-void WriteVertex(FILE * const output, const glm::vec3 &vertex) {
-  static_assert(sizeof(glm::vec3) == 3*sizeof(float));
-  // Write this new vertex to file.
-  if (fwrite(&vertex, 4, 3, output) != 3) {
-    fprintf(stderr, "Error writing vertex\n");
+}  // namespace
+
+PlyHeader ParsePlyHeader(const uint8_t *data, const uint64_t size) {
+  PlyHeader header;
+  uint64_t offset = 0;
+  bool first_line = true;
+  bool has_format = false;
+  auto fail = [](const std::string &line) {
+    fprintf(stderr, "Error reading PLY header at line '%s'\n", line.c_str());
     std::exit(1);
+  };
+  while (true) {
+    const uint8_t *newline = static_cast<const uint8_t *>(memchr(data + offset, '\n', size - offset));
+    if (newline == nullptr) {
+      fprintf(stderr, "Error reading PLY header: no end_header\n");
+      std::exit(1);
+    }
+    std::string line(reinterpret_cast<const char *>(data + offset), static_cast<size_t>(newline - (data + offset)));
+    offset = static_cast<uint64_t>(newline - data) + 1;
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+
+    std::istringstream tokens(line);
+    std::string keyword;
+    tokens >> keyword;
+    if (first_line) {
+      if (keyword != "ply") {
+        fail(line);
+      }
+      first_line = false;
+    } else if (keyword == "format") {
+      std::string format;
+      tokens >> format;
+      if (format == "ascii") {
+        header.format = PlyFormat::kAscii;
+      } else if (format == "binary_little_endian") {
+        header.format = PlyFormat::kBinaryLittleEndian;
+      } else if (format == "binary_big_endian") {
+        header.format = PlyFormat::kBinaryBigEndian;
+      } else {
+        fail(line);
+      }
+      has_format = true;
+    } else if (keyword == "element") {
+      PlyElement element;
+      if (!(tokens >> element.name >> element.count)) {
+        fail(line);
+      }
+      header.elements.push_back(element);
+    } else if (keyword == "property") {
+      PlyProperty property;
+      std::string type;
+      if (header.elements.empty() || !(tokens >> type)) {
+        fail(line);
+      }
+      if (type == "list") {
+        std::string count_type;
+        property.is_list = true;
+        if (!(tokens >> count_type >> type) || !ParseType(count_type, &property.count_type)) {
+          fail(line);
+        }
+      }
+      if (!ParseType(type, &property.type) || !(tokens >> property.name)) {
+        fail(line);
+      }
+      header.elements.back().properties.push_back(property);
+    } else if (keyword == "end_header") {
+      break;
+    } else if (keyword != "comment" && keyword != "obj_info" && !keyword.empty()) {
+      fail(line);
+    }
   }
+  if (!has_format) {
+    fprintf(stderr, "Error reading PLY header: no format line\n");
+    std::exit(1);
+  }
+  header.header_bytes = offset;
+  return header;
 }
 
-void ReadVertex(FILE * const input, glm::vec3 *vertex) {
-  static_assert(sizeof(glm::vec3) == 3*sizeof(float));
-  if (fread(vertex, 4, 3, input) != 3) {
-    fprintf(stderr, "Error reading vertex\n");
+void WritePlyHeader(FILE * const output, const uint32_t vertex_count, const uint32_t triangle_count) {
+  fprintf(output, "ply\r\n");
+  fprintf(output, "format binary_little_endian 1.0\r\n");
+  fprintf(output, "element vertex %u\r\n", vertex_count);
+  fprintf(output, "property float x\r\n");
+  fprintf(output, "property float y\r\n");
+  fprintf(output, "property float z\r\n");
+  fprintf(output, "element face %u\r\n", triangle_count);
+  fprintf(output, "property list uchar uint vertex_indices\r\n");
+  fprintf(output, "end_header\r\n");
+}
+
+void WriteTriangleHeader(FILE * const output) {
+  // Write triangle header.
+  const uint8_t three = 3; // This triangle will have three vertices, big surprise.
+  if (fwrite(&three, 1, 1, output) != 1) {
+    fprintf(stderr, "Error writing 'three' as uint8_t\n");
     std::exit(1);
   }
 }
 
+void WriteVertex(FILE * const output, const glm::vec3 &vertex) {
+  static_assert(sizeof(glm::vec3) == 3*sizeof(float));
+  // Write this new vertex to file.
+  if (fwrite(&vertex, 4, 3, output) != 3) {
+    fprintf(stderr, "Error writing vertex\n");
+    std::exit(1);
+  }
+}
 
 void WriteVertexIndex(FILE * const output, const uint32_t vertex_index) {
   static_assert(sizeof(vertex_index) == 4);
@@ -96,19 +511,11 @@ void WriteVertexIndex(FILE * const output, const uint32_t vertex_index) {
   }
 }
 
-void ReadVertexIndex(FILE * const input, uint32_t *vertex_index) {
-  static_assert(sizeof(*vertex_index) == 4);
-  // write the vertex index to the triangle file
-  if (fread(vertex_index, 4, 1, input) != 1) {
-    fprintf(stderr, "Error reading vertex indexu\n");
-    std::exit(1);
-  }
-}
-
 void SavePly(const std::string &path,
              const std::vector<glm::vec3> &points,
              const std::vector<glm::ivec3> &triangles) {
-  FILE *output = fopen(path.c_str(), "w");
+  const ScopedStage stage("save_ply");
+  FILE *output = fopen(path.c_str(), "wb");
   if (output == NULL) {
     fprintf(stderr, "Error opening output file %s.\n", path.c_str());
     exit(1);
@@ -116,56 +523,69 @@ void SavePly(const std::string &path,
 
   WritePlyHeader(output, (uint32_t)points.size(), (uint32_t)triangles.size());
 
-  // write vertex list
-  for (const glm::vec3 & vertex : points) {
-    WriteVertex(output, vertex);
+  // The vertex block is exactly the in-memory array.
+  static_assert(sizeof(glm::vec3) == 3*sizeof(float));
+  if (fwrite(points.data(), sizeof(glm::vec3), points.size(), output) != points.size()) {
+    fprintf(stderr, "Error writing vertices\n");
+    std::exit(1);
   }
 
-  // Write triangle list
-  for (const glm::ivec3 & triangle : triangles) {
-    WriteTriangleHeader(output);
-    WriteVertexIndex(output, static_cast<uint32_t>(triangle[0]));
-    WriteVertexIndex(output, static_cast<uint32_t>(triangle[1]));
-    WriteVertexIndex(output, static_cast<uint32_t>(triangle[2]));
+  // Encode the face block a chunk at a time: uchar 3 then three uint32.
+  constexpr uint64_t kChunkFaces = 1 << 20;
+  std::vector<uint8_t> buffer;
+  for (uint64_t begin = 0; begin < triangles.size(); begin += kChunkFaces) {
+    const uint64_t end = std::min<uint64_t>(begin + kChunkFaces, triangles.size());
+    buffer.resize((end - begin) * 13);
+    ParallelFor(end - begin, 1 << 16, [&](const uint64_t chunk_begin, const uint64_t chunk_end, uint32_t) {
+      for (uint64_t i = chunk_begin; i < chunk_end; i++) {
+        buffer[i * 13] = 3;
+        memcpy(&buffer[i * 13 + 1], &triangles[begin + i], 12);
+      }
+    });
+    if (fwrite(buffer.data(), 1, buffer.size(), output) != buffer.size()) {
+      fprintf(stderr, "Error writing faces\n");
+      std::exit(1);
+    }
+  }
+
+  const long bytes_written = ftell(output);
+  if (fclose(output) != 0) {
+    fprintf(stderr, "Error closing output file %s.\n", path.c_str());
+    std::exit(1);
   }
+  StatsAdd("ply_bytes_written", bytes_written > 0 ? static_cast<uint64_t>(bytes_written) : 0);
+  StatsAdd("ply_triangles_written", triangles.size());
 }
 
 void LoadPly(const std::string &path,
              std::vector<glm::vec3> *points,
              std::vector<glm::ivec3> *triangles) {
-  FILE *input = fopen(path.c_str(), "r");
-  if (input == NULL) {
-    fprintf(stderr, "Error opening input\n");
-    std::exit(1);
-  }
-
-  uint32_t vertex_count = 0;
-  uint32_t triangle_count = 0;
-
-  ReadPlyHeader(input, &vertex_count, &triangle_count);
-  fprintf(stderr, "Reading %u vertices, %u faces\n", vertex_count, triangle_count);
+  const ScopedStage stage("load_ply");
+  const MappedFile file(path);
+  const PlyHeader header = ParsePlyHeader(file.data(), file.size());
 
-  // Read vertices
-  points->clear();
-  points->reserve(vertex_count);
-  for (uint32_t k=0; k<vertex_count; k++) {
-    static_assert(sizeof(glm::vec3) == 3*sizeof(float));
-    glm::vec3 vertex;
-    ReadVertex(input, &vertex);
-    points->emplace_back(vertex);
+  uint64_t vertex_count = 0;
+  uint64_t face_count = 0;
+  for (const PlyElement &element : header.elements) {
+    vertex_count += (element.name == "vertex") ? element.count : 0;
+    face_count += (element.name == "face") ? element.count : 0;
   }
+  fprintf(stderr, "Reading %llu vertices, %llu faces\n",
+          static_cast<unsigned long long>(vertex_count), static_cast<unsigned long long>(face_count));
 
-  // Read triangles
+  points->clear();
   triangles->clear();
-  triangles->reserve(triangle_count);
-  for (uint32_t k=0; k<triangle_count; k++) {
-    ReadTriangleHeader(input);
-    glm::ivec3 triangle;
-    ReadVertexIndex(input, reinterpret_cast<uint32_t*>(&triangle[0]));
-    ReadVertexIndex(input, reinterpret_cast<uint32_t*>(&triangle[1]));
-    ReadVertexIndex(input, reinterpret_cast<uint32_t*>(&triangle[2]));
-    triangles->emplace_back(triangle);
+  uint64_t offset = header.header_bytes;
+  for (const PlyElement &element : header.elements) {
+    if (element.name == "vertex") {
+      ReadVertices(file.data(), file.size(), header, element, &offset, points);
+    } else if (element.name == "face") {
+      ReadFaces(file.data(), file.size(), header, element, &offset, triangles);
+    } else {
+      SkipElement(file.data(), file.size(), header, element, &offset);
+    }
   }
-
-  fclose(input);
+  CheckVertexIndices(*triangles, points->size());
+  StatsAdd("ply_bytes_read", file.size());
+  StatsAdd("ply_triangles_read", triangles->size());
 }
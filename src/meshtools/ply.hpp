@@ -6,13 +6,53 @@
 #include <vector>
 #include <glm/glm.hpp>
 
+enum class PlyFormat { kAscii, kBinaryLittleEndian, kBinaryBigEndian };
+
+enum class PlyType { kInt8, kUint8, kInt16, kUint16, kInt32, kUint32, kFloat32, kFloat64 };
+
+struct PlyProperty {
+  std::string name;
+  PlyType type = PlyType::kFloat32;
+  // List properties store a count of type count_type, then that many `type`.
+  bool is_list = false;
+  PlyType count_type = PlyType::kUint8;
+};
+
+struct PlyElement {
+  std::string name;
+  uint64_t count = 0;
+  std::vector<PlyProperty> properties;
+};
+
+struct PlyHeader {
+  PlyFormat format = PlyFormat::kBinaryLittleEndian;
+  std::vector<PlyElement> elements;
+  // Offset of the first byte after "end_header\n".
+  uint64_t header_bytes = 0;
+};
+
+// Parse a PLY header from the start of a file in memory. Handles ascii and
+// both binary encodings, comments and any elements and properties. Exits on
+// a malformed header.
+PlyHeader ParsePlyHeader(const uint8_t *data, uint64_t size);
+
 void WritePlyHeader(FILE * const output, const uint32_t vertex_count, const uint32_t triangle_count);
 void WriteTriangleHeader(FILE * const output);
 void WriteVertex(FILE * const output, const glm::vec3 &vertex);
 void WriteVertexIndex(FILE * const output, const uint32_t vertex_index);
+
+// Write binary little endian PLY with float x/y/z vertices and
+// `list uchar uint vertex_indices` faces. Each block is encoded into a buffer
+// and written with one call per chunk.
 void SavePly(const std::string &path,
              const std::vector<glm::vec3> &points,
              const std::vector<glm::ivec3> &triangles);
+
+// Read vertex x/y/z and faces (vertex_indices or vertex_index) from any PLY,
+// fan-triangulating faces with more than three vertices. Other elements and
+// properties are skipped. The file is mapped and decoded in bulk, with
+// parallel fast paths for fixed-stride binary vertices and triangle faces.
+// Exits on a malformed file, including a face index that is not a vertex.
 void LoadPly(const std::string &path,
              std::vector<glm::vec3> *points,
              std::vector<glm::ivec3> *triangles);
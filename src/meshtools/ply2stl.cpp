@@ -1,8 +1,11 @@
 #include <iostream>
-#include "src/meshtools/stl.hpp"
+#include "src/meshtools/mesh_io.hpp"
 #include "src/meshtools/ply.hpp"
+#include "src/meshtools/stats.hpp"
 
 int main(int argc, char* argv[]) {
+  InitStats(&argc, argv);
+  const MeshFormat format = ParseFormatFlag(&argc, argv);
   if (argc != 3) {
     std::cerr << "Need exactly 2 arguments, input and output" << std::endl;
     exit(1);
@@ -12,5 +15,6 @@ int main(int argc, char* argv[]) {
   std::vector<glm::vec3> points;
   std::vector<glm::ivec3> triangles;
   LoadPly(input_path, &points, &triangles);
-  WriteBinaryStl(output_path, points, triangles);
+  // Binary STL unless --format says otherwise.
+  WriteMeshFile(output_path, points, triangles, format == MeshFormat::kByExtension ? MeshFormat::kStl : format);
 }
@@ -1,51 +1,54 @@
 #include <cassert>
-#include <getopt.h>
+#include <cstring>
 #include <glm/glm.hpp>
 #include <iostream>
 #include <string>
-#include <vector>
 
-#include "src/meshtools/stl.hpp"
+#include "src/meshtools/mesh_stats.hpp"
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/terrain.hpp"
 
-// Usage: ./trim_bottom inputpath outputpath
+// Print the X/Y/Z extents of a mesh. Binary STL is scanned in place without
+// welding. --all adds the triangle count, bounding box and surface area, and
+// --unique_vertices a HyperLogLog estimate of the distinct vertices.
+// Usage: ./print_stl_dimensions inputpath [--all] [--unique_vertices]
 int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
   // Parse flags.
+  bool all = false;
+  bool unique_vertices = false;
+  int32_t kept = 1;
+  for (int32_t k = 1; k < argc; k++) {
+    if (strcmp(argv[k], "--all") == 0) {
+      all = true;
+    } else if (strcmp(argv[k], "--unique_vertices") == 0) {
+      unique_vertices = true;
+    } else {
+      argv[kept++] = argv[k];
+    }
+  }
+  argc = kept;
   if (argc != 2) {
-    fprintf(stderr, "Need 1 command line argument: input file\n");
+    fprintf(stderr, "Need 1 command line argument: input file, and optionally --all and --unique_vertices\n");
     std::exit(1);
   }
   std::string input_path = argv[1];
   assert(input_path.size() != 0);
 
-  // Read inputs.
-  std::vector<glm::vec3> vertices;
-  std::vector<glm::ivec3> triangles;
-  ReadBinarySTL(input_path, vertices, triangles);
-
-  if (vertices.size() == 0) {
+  const MeshStats stats = MeshFileStats(input_path, unique_vertices);
+  if (stats.num_triangles == 0) {
     std::cout << "No vertices in this mesh." << std::endl;
     std::exit(1);
   }
 
-  // Translate vertices.
-  float min_x = vertices.at(0).x;
-  float max_x = vertices.at(0).x;
-  float min_y = vertices.at(0).y;
-  float max_y = vertices.at(0).y;
-  float min_z = vertices.at(0).z;
-  float max_z = vertices.at(0).z;
-  for (const glm::vec3 &vertex : vertices) {
-    min_x = fmin(min_x, vertex.x);
-    max_x = fmax(max_x, vertex.x);
-
-    min_y = fmin(min_y, vertex.y);
-    max_y = fmax(max_y, vertex.y);
-
-    min_z = fmin(min_z, vertex.z);
-    max_z = fmax(max_z, vertex.z);
+  PrintDimensions(VertexBounds{stats.min, stats.max});
+  if (all) {
+    std::cout << "Triangles: " << stats.num_triangles << std::endl;
+    std::cout << "Min: " << stats.min.x << " " << stats.min.y << " " << stats.min.z << std::endl;
+    std::cout << "Max: " << stats.max.x << " " << stats.max.y << " " << stats.max.z << std::endl;
+    std::cout << "Surface area: " << stats.surface_area << std::endl;
+  }
+  if (unique_vertices) {
+    std::cout << "Unique vertices (estimate): " << static_cast<uint64_t>(std::llround(stats.unique_vertices)) << std::endl;
   }
-
-  std::cout << "X size: " << (max_x - min_x) << std::endl;
-  std::cout << "Y size: " << (max_y - min_y) << std::endl;
-  std::cout << "Z size: " << (max_z - min_z) << std::endl;
 }
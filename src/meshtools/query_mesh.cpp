@@ -0,0 +1,135 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/bvh.hpp"
+#include "src/meshtools/mesh_io.hpp"
+#include "src/meshtools/stats.hpp"
+
+// Answer height and ray queries against a mesh. Each line of the query file
+// is one of
+//   height x y
+//   ray origin_x origin_y origin_z direction_x direction_y direction_z
+// and gives one output line, in order:
+//   height: z triangle
+//   ray: t x y z triangle
+// with triangle -1 and nan values on a miss. Blank lines and lines starting
+// with # are skipped.
+int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  if (argc != 3 && argc != 4) {
+    fprintf(stderr, "Usage: ./query_mesh input.stl queries.txt [output.txt]\n");
+    std::exit(1);
+  }
+  const std::string input_path = argv[1];
+  const std::string queries_path = argv[2];
+
+  std::vector<glm::vec3> points;
+  std::vector<glm::ivec3> triangles;
+  ReadMeshFile(input_path, points, triangles);
+  std::cerr << "Loaded " << points.size() << " vertices and " << triangles.size() << " triangles from file." << std::endl;
+
+  // Queries of each kind are answered together; `order` remembers where each
+  // line's answer is, as an index into heights or (with the top bit set) rays.
+  std::vector<glm::vec2> heights;
+  std::vector<glm::vec3> origins;
+  std::vector<glm::vec3> directions;
+  std::vector<uint32_t> order;
+  constexpr uint32_t kRayBit = 1u << 31;
+  {
+    std::ifstream queries(queries_path);
+    if (!queries) {
+      fprintf(stderr, "Can't open %s\n", queries_path.c_str());
+      std::exit(1);
+    }
+    std::string line;
+    uint64_t line_number = 0;
+    while (std::getline(queries, line)) {
+      line_number++;
+      const char *cursor = line.c_str();
+      while (*cursor == ' ' || *cursor == '\t') {
+        cursor++;
+      }
+      if (*cursor == '\0' || *cursor == '#' || *cursor == '\r') {
+        continue;
+      }
+      size_t num_values = 0;
+      const std::string kind(cursor, std::strcspn(cursor, " \t"));
+      if (kind == "height") {
+        num_values = 2;
+      } else if (kind == "ray") {
+        num_values = 6;
+      } else {
+        fprintf(stderr, "%s:%llu: unknown query '%s'\n", queries_path.c_str(),
+                static_cast<unsigned long long>(line_number), kind.c_str());
+        std::exit(1);
+      }
+      cursor += kind.size();
+      float values[6];
+      for (size_t i = 0; i < num_values; i++) {
+        char *end = nullptr;
+        values[i] = std::strtof(cursor, &end);
+        if (end == cursor) {
+          fprintf(stderr, "%s:%llu: expected %zu numbers after %s\n", queries_path.c_str(),
+                  static_cast<unsigned long long>(line_number), num_values, kind.c_str());
+          std::exit(1);
+        }
+        cursor = end;
+      }
+      if (num_values == 2) {
+        order.push_back(static_cast<uint32_t>(heights.size()));
+        heights.emplace_back(values[0], values[1]);
+      } else {
+        order.push_back(kRayBit | static_cast<uint32_t>(origins.size()));
+        origins.emplace_back(values[0], values[1], values[2]);
+        directions.emplace_back(values[3], values[4], values[5]);
+      }
+    }
+  }
+
+  const Bvh bvh = BuildBvh(points, triangles);
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<HeightHit> height_hits;
+  std::vector<RayHit> ray_hits;
+  HeightsAt(bvh, heights, &height_hits);
+  IntersectRays(bvh, origins, directions, &ray_hits);
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "Answered %zu queries in %.3f s\n", order.size(), seconds);
+
+  FILE *output = stdout;
+  if (argc == 4) {
+    output = fopen(argv[3], "w");
+    if (output == nullptr) {
+      fprintf(stderr, "Can't open %s for writing\n", argv[3]);
+      std::exit(1);
+    }
+  }
+  for (const uint32_t index : order) {
+    if (index & kRayBit) {
+      const RayHit &hit = ray_hits[index & ~kRayBit];
+      if (hit.triangle < 0) {
+        fprintf(output, "nan nan nan nan -1\n");
+      } else {
+        fprintf(output, "%.9g %.9g %.9g %.9g %d\n", double{hit.t}, double{hit.point.x}, double{hit.point.y},
+                double{hit.point.z}, hit.triangle);
+      }
+    } else {
+      const HeightHit &hit = height_hits[index];
+      if (hit.triangle < 0) {
+        fprintf(output, "nan -1\n");
+      } else {
+        fprintf(output, "%.9g %d\n", double{hit.z}, hit.triangle);
+      }
+    }
+  }
+  if (output != stdout && fclose(output) != 0) {
+    fprintf(stderr, "Error writing %s\n", argv[3]);
+    std::exit(1);
+  }
+}
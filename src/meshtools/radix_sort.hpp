@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Stable LSD radix sort of entries by key, 16 bits per pass. Entry provides
+//
+//   static constexpr uint32_t kKeyDigits;  // 16 bit digits in the key.
+//   uint32_t Digit(uint32_t pass) const;   // Digit `pass`, least significant first.
+//
+// Passes where every entry has the same digit are skipped.
+template <typename Entry>
+void RadixSortByKey(std::vector<Entry> *entries) {
+  constexpr uint32_t kNumBuckets = 1 << 16;
+  constexpr uint32_t kNumPasses = Entry::kKeyDigits;
+  std::vector<Entry> scratch(entries->size());
+  std::vector<uint64_t> histograms(kNumPasses * kNumBuckets, 0);
+  for (const Entry &entry : *entries) {
+    for (uint32_t pass = 0; pass < kNumPasses; pass++) {
+      histograms[pass * kNumBuckets + entry.Digit(pass)]++;
+    }
+  }
+  for (uint32_t pass = 0; pass < kNumPasses; pass++) {
+    uint64_t *histogram = &histograms[pass * kNumBuckets];
+    if (std::find(histogram, histogram + kNumBuckets, entries->size()) != histogram + kNumBuckets) {
+      continue;
+    }
+    uint64_t sum = 0;
+    for (uint32_t b = 0; b < kNumBuckets; b++) {
+      const uint64_t count = histogram[b];
+      histogram[b] = sum;
+      sum += count;
+    }
+    for (const Entry &entry : *entries) {
+      scratch[histogram[entry.Digit(pass)]++] = entry;
+    }
+    entries->swap(scratch);
+  }
+}
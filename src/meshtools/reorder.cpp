@@ -0,0 +1,249 @@
+#include "reorder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/radix_sort.hpp"
+#include "src/meshtools/stats.hpp"
+
+namespace {
+
+constexpr uint32_t kMortonBits = 21;
+
+// Spread the low 21 bits of x out to every third bit.
+uint64_t SpreadBits(uint64_t x) {
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffull;
+  x = (x | x << 16) & 0x1f0000ff0000ffull;
+  x = (x | x << 8) & 0x100f00f00f00f00full;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+  x = (x | x << 2) & 0x1249249249249249ull;
+  return x;
+}
+
+struct MortonEntry {
+  static constexpr uint32_t kKeyDigits = 4;
+  uint64_t key;
+  uint32_t vertex;
+
+  uint32_t Digit(const uint32_t pass) const { return static_cast<uint32_t>(key >> (16 * pass) & 0xffff); }
+};
+
+// New index of each vertex, in Morton order of its position in the mesh's
+// bounding cube. Non-finite coordinates count as the low corner.
+std::vector<int32_t> MortonOrder(const std::vector<glm::vec3> &points) {
+  const ScopedStage stage("morton_order");
+  glm::vec3 min_corner(INFINITY);
+  glm::vec3 max_corner(-INFINITY);
+  for (const glm::vec3 &point : points) {
+    for (int k = 0; k < 3; k++) {
+      if (std::isfinite(point[k])) {
+        min_corner[k] = std::min(min_corner[k], point[k]);
+        max_corner[k] = std::max(max_corner[k], point[k]);
+      }
+    }
+  }
+  float extent = 0;
+  for (int k = 0; k < 3; k++) {
+    if (!(min_corner[k] <= max_corner[k])) {
+      min_corner[k] = max_corner[k] = 0;
+    }
+    extent = std::max(extent, max_corner[k] - min_corner[k]);
+  }
+  constexpr double kMaxCell = (1 << kMortonBits) - 1;
+  const double scale = extent > 0 ? kMaxCell / double{extent} : 0;
+
+  std::vector<MortonEntry> entries(points.size());
+  ParallelFor(points.size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t v = begin; v < end; v++) {
+      uint64_t key = 0;
+      for (int k = 0; k < 3; k++) {
+        double cell = (double{points[v][k]} - double{min_corner[k]}) * scale;
+        // Also catches NaN.
+        if (!(cell >= 0)) {
+          cell = 0;
+        }
+        key |= SpreadBits(static_cast<uint64_t>(std::min(cell, kMaxCell))) << k;
+      }
+      entries[v] = {key, static_cast<uint32_t>(v)};
+    }
+  });
+  RadixSortByKey(&entries);
+
+  std::vector<int32_t> new_index(points.size());
+  ParallelFor(entries.size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t i = begin; i < end; i++) {
+      new_index[entries[i].vertex] = static_cast<int32_t>(i);
+    }
+  });
+  return new_index;
+}
+
+// Tipsify: the order to emit the triangles in. Fans out all remaining
+// triangles around one vertex at a time, then moves to the vertex just used
+// that will still be in cache after its own remaining triangles, preferring
+// the oldest such, else pops recently used vertices off a dead-end stack,
+// else scans forward for the next vertex with triangles left.
+std::vector<uint32_t> TipsifyOrder(const std::vector<glm::ivec3> &triangles,
+                                   const uint64_t num_points,
+                                   const uint32_t cache_size) {
+  const ScopedStage stage("tipsify");
+  // Triangles around each vertex, by counting sort.
+  std::vector<uint32_t> offsets(num_points + 1, 0);
+  for (const glm::ivec3 &triangle : triangles) {
+    for (int k = 0; k < 3; k++) {
+      offsets[static_cast<uint64_t>(triangle[k]) + 1]++;
+    }
+  }
+  for (uint64_t v = 0; v < num_points; v++) {
+    offsets[v + 1] += offsets[v];
+  }
+  std::vector<uint32_t> adjacency(offsets.back());
+  {
+    std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+    for (uint64_t t = 0; t < triangles.size(); t++) {
+      for (int k = 0; k < 3; k++) {
+        adjacency[cursors[static_cast<uint64_t>(triangles[t][k])]++] = static_cast<uint32_t>(t);
+      }
+    }
+  }
+
+  // Triangles not yet emitted around each vertex.
+  std::vector<uint32_t> live(num_points);
+  for (uint64_t v = 0; v < num_points; v++) {
+    live[v] = offsets[v + 1] - offsets[v];
+  }
+  // Time each vertex last entered the cache, 0 for never, so a vertex is
+  // cached while time - cache_time[v] <= cache_size.
+  std::vector<uint64_t> cache_time(num_points, 0);
+  uint64_t time = uint64_t{cache_size} + 1;
+  std::vector<uint8_t> emitted(triangles.size(), 0);
+  std::vector<int32_t> dead_ends;
+  std::vector<int32_t> candidates;
+  std::vector<uint32_t> order;
+  order.reserve(triangles.size());
+  uint64_t cursor = 0;
+
+  int64_t fan = num_points > 0 ? 0 : -1;
+  while (fan >= 0) {
+    candidates.clear();
+    for (uint32_t i = offsets[static_cast<uint64_t>(fan)]; i < offsets[static_cast<uint64_t>(fan) + 1]; i++) {
+      const uint32_t t = adjacency[i];
+      if (emitted[t]) {
+        continue;
+      }
+      emitted[t] = 1;
+      order.push_back(t);
+      for (int k = 0; k < 3; k++) {
+        const int32_t v = triangles[t][k];
+        dead_ends.push_back(v);
+        candidates.push_back(v);
+        live[static_cast<uint64_t>(v)]--;
+        if (time - cache_time[static_cast<uint64_t>(v)] > cache_size) {
+          cache_time[static_cast<uint64_t>(v)] = time++;
+        }
+      }
+    }
+
+    fan = -1;
+    uint64_t best_priority = 0;
+    for (const int32_t v : candidates) {
+      const uint64_t vertex = static_cast<uint64_t>(v);
+      if (live[vertex] == 0) {
+        continue;
+      }
+      // Fanning v adds up to 2 new vertices per live triangle, so prefer the
+      // oldest candidate that would still be in cache afterwards.
+      const uint64_t age = time - cache_time[vertex];
+      const uint64_t priority = age + 2 * uint64_t{live[vertex]} <= cache_size ? age : 0;
+      if (fan < 0 || priority > best_priority) {
+        fan = v;
+        best_priority = priority;
+      }
+    }
+    while (fan < 0 && !dead_ends.empty()) {
+      const int32_t v = dead_ends.back();
+      dead_ends.pop_back();
+      if (live[static_cast<uint64_t>(v)] > 0) {
+        fan = v;
+      }
+    }
+    while (fan < 0 && cursor < num_points) {
+      if (live[cursor] > 0) {
+        fan = static_cast<int64_t>(cursor);
+      }
+      cursor++;
+    }
+  }
+  return order;
+}
+
+}  // namespace
+
+void ReorderMesh(std::vector<glm::vec3> *points, std::vector<glm::ivec3> *triangles, const uint32_t cache_size) {
+  const ScopedStage stage("reorder_mesh");
+  if (points->size() > INT32_MAX || triangles->size() > UINT32_MAX / 3) {
+    fprintf(stderr, "Too many points or triangles to reorder.\n");
+    std::exit(1);
+  }
+  for (const glm::ivec3 &triangle : *triangles) {
+    for (int k = 0; k < 3; k++) {
+      if (triangle[k] < 0 || static_cast<uint64_t>(triangle[k]) >= points->size()) {
+        fprintf(stderr, "Can't reorder a mesh with vertex index %d out of range.\n", triangle[k]);
+        std::exit(1);
+      }
+    }
+  }
+
+  const std::vector<int32_t> new_index = MortonOrder(*points);
+  {
+    std::vector<glm::vec3> sorted(points->size());
+    ParallelFor(points->size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+      for (uint64_t v = begin; v < end; v++) {
+        sorted[static_cast<uint64_t>(new_index[v])] = (*points)[v];
+      }
+    });
+    points->swap(sorted);
+  }
+  ParallelFor(triangles->size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t t = begin; t < end; t++) {
+      for (int k = 0; k < 3; k++) {
+        (*triangles)[t][k] = new_index[static_cast<uint64_t>((*triangles)[t][k])];
+      }
+    }
+  });
+
+  const std::vector<uint32_t> order = TipsifyOrder(*triangles, points->size(), std::max(cache_size, 3u));
+  std::vector<glm::ivec3> sorted(triangles->size());
+  ParallelFor(order.size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t i = begin; i < end; i++) {
+      sorted[i] = (*triangles)[order[i]];
+    }
+  });
+  triangles->swap(sorted);
+}
+
+double AverageCacheMissRatio(const std::vector<glm::ivec3> &triangles,
+                             const uint64_t num_points,
+                             const uint32_t cache_size) {
+  if (triangles.empty()) {
+    return 0;
+  }
+  // A vertex is in the FIFO cache if fewer than cache_size misses happened
+  // since it was loaded.
+  std::vector<uint64_t> loaded_at(num_points, 0);
+  uint64_t misses = 0;
+  for (const glm::ivec3 &triangle : triangles) {
+    for (int k = 0; k < 3; k++) {
+      uint64_t &loaded = loaded_at[static_cast<uint64_t>(triangle[k])];
+      if (loaded == 0 || misses - loaded >= cache_size) {
+        misses++;
+        loaded = misses;
+      }
+    }
+  }
+  return static_cast<double>(misses) / static_cast<double>(triangles.size());
+}
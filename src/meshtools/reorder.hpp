@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Vertices a triangle order is tuned to keep in cache, as in the Tipsify
+// paper. Small enough to also suit CPU caches on the passes that follow.
+constexpr uint32_t kDefaultReorderCacheSize = 16;
+
+// Reorder a welded mesh in place for memory locality. Vertices are sorted
+// along a 3D Morton curve, with one scale for all axes so a flat terrain is
+// ordered mostly by x and y, and triangle indices are remapped. Triangles are
+// then ordered with Tipsify (Sander, Nehab and Barczak 2007), which fans
+// around recently used vertices and restarts at the next vertex along the
+// curve when it runs out, so passes over the triangles walk the vertex array
+// mostly forwards. Corner order within each triangle is kept, so winding does
+// not change. The result only depends on the input.
+void ReorderMesh(std::vector<glm::vec3> *points,
+                 std::vector<glm::ivec3> *triangles,
+                 uint32_t cache_size = kDefaultReorderCacheSize);
+
+// Average cache miss ratio: vertex misses per triangle of a FIFO cache of
+// `cache_size` vertices fed the triangles in order. 3 is the worst case and
+// about 0.5 to 0.7 is typical of good orders for a cache of 16 to 32.
+double AverageCacheMissRatio(const std::vector<glm::ivec3> &triangles,
+                             uint64_t num_points,
+                             uint32_t cache_size = kDefaultReorderCacheSize);
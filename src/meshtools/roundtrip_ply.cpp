@@ -7,9 +7,11 @@
 #include <glm/glm.hpp>
 
 #include "src/meshtools/ply.hpp"
+#include "src/meshtools/stats.hpp"
 
 // Usage: ./trim_bottom inputpath outputpath
 int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
   // Parse flags.
   if (argc != 3) {
     fprintf(stderr, "Need 2 command line arguments, input and output\n");
@@ -1,27 +1,19 @@
 #include <string>
-#include <getopt.h>
 #include <cassert>
+#include <cstdio>
 #include <iostream>
-#include <fstream>
-#include <sstream>
-#include <ostream>
 #include <vector>
 #include <glm/glm.hpp>
 
+#include "src/meshtools/mesh_format.hpp"
+#include "src/meshtools/stats.hpp"
 #include "src/meshtools/stl.hpp"
 
-std::ostream& operator << (std::ostream &out, const glm::vec3 &v) {
-  out << "{" << v.x << ", " << v.y << ", " << v.z << "}";
-  return out;
-}
-std::ostream& operator << (std::ostream &out, const glm::ivec3 &v) {
-  out << "{" << v.x << ", " << v.y << ", " << v.z << "}";
-  return out;
-}
-
-
-// Usage: ./trim_bottom inputpath outputpath
+// Read an STL, write it to outputpath, read that back and check the mesh
+// content hash is unchanged.
+// Usage: ./roundtrip_stl inputpath outputpath
 int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
   // Parse flags.
   if (argc != 3) {
     fprintf(stderr, "Need 2 command line arguments, input and output\n");
@@ -41,41 +33,17 @@ int32_t main(int32_t argc, char *argv[]) {
   // Write outputs.
   WriteBinaryStl(output_path, vertices, triangles);
 
-  // read inputs again and see if they're the same
+  // Read the output back and see if it's the same.
   std::vector<glm::vec3> new_vertices;
   std::vector<glm::ivec3> new_triangles;
-  ReadBinarySTL(input_path, new_vertices, new_triangles);
-
-  bool fail = false;
-  if (vertices.size() == new_vertices.size()) {
-    for (size_t k=0; k<vertices.size(); k++) {
-      glm::vec3 v0 = vertices.at(k);
-      glm::vec3 v1 = new_vertices.at(k);
-      if (v0 != v1) {
-        std::cerr << "Vertex " << k << " changed from " << v0 << " to " << v1 << std::endl;
-        fail = true;
-      }
-    }
-  }
-  if (triangles.size() == new_triangles.size()) {
-    for (size_t k=0; k<triangles.size(); k++) {
-      glm::ivec3 v0 = triangles.at(k);
-      glm::ivec3 v1 = new_triangles.at(k);
-      if (v0 != v1) {
-        std::cerr << "Triangle index " << k << " changed from " << v0 << " to " << v1 << std::endl;
-        fail = true;
-      }
-    }
-  }
-  if (vertices.size() != new_vertices.size()) {
-    std::cerr << "Vertices length " << vertices.size() << " changed to " << new_vertices.size() << std::endl;
-    fail = true;
-  }
-  if (triangles.size() != new_triangles.size()) {
-    std::cerr << "Triangles length " << triangles.size() << " changed to " << new_triangles.size() << std::endl;
-    fail = true;
-  }
-  if (fail) {
+  ReadBinarySTL(output_path, new_vertices, new_triangles);
+  const uint64_t hash = MeshContentHash(vertices.data(), vertices.size(), triangles.data(), triangles.size());
+  const uint64_t new_hash =
+      MeshContentHash(new_vertices.data(), new_vertices.size(), new_triangles.data(), new_triangles.size());
+  if (hash != new_hash) {
+    fprintf(stderr, "Mesh changed from %zu vertices and %zu triangles (hash %016llx) to %zu and %zu (hash %016llx)\n",
+            vertices.size(), triangles.size(), static_cast<unsigned long long>(hash), new_vertices.size(),
+            new_triangles.size(), static_cast<unsigned long long>(new_hash));
     std::exit(1);
   }
 }
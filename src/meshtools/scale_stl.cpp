@@ -8,13 +8,19 @@
 #include <vector>
 #include <glm/glm.hpp>
 
+#include "src/meshtools/mesh_io.hpp"
+#include "src/meshtools/stats.hpp"
 #include "src/meshtools/stl.hpp"
 
-// Usage: ./trim_bottom inputpath outputpath
+// Usage: ./scale_stl inputpath outputpath scale [--format=stl|ply|mesh|3mf] [--streaming]
+// --streaming scales an STL chunk by chunk without loading it.
 int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  const MeshFormat format = ParseFormatFlag(&argc, argv);
+  const bool streaming = ParseStreamingFlag(&argc, argv);
   // Parse flags.
   if (argc != 4) {
-    fprintf(stderr, "Need 3 command line arguments: input, output, scale.\n");
+    fprintf(stderr, "Need 3 command line arguments: input, output, scale, and optionally --format=stl|ply|mesh|3mf and --streaming.\n");
     exit(1);
   }
   const std::string input_path = argv[1];
@@ -23,10 +29,20 @@ int32_t main(int32_t argc, char *argv[]) {
   assert(input_path.size() != 0);
   assert(output_path.size() != 0);
 
+  if (streaming) {
+    CheckStreamingPaths(input_path, output_path, format);
+    StreamTransformStl(input_path, output_path, [&](std::vector<glm::vec3> *corners) {
+      for (glm::vec3 &corner : *corners) {
+        corner *= scale_factor;
+      }
+    }, nullptr);
+    return 0;
+  }
+
   // Read inputs.
   std::vector<glm::vec3> vertices;
   std::vector<glm::ivec3> triangles;
-  ReadBinarySTL(input_path, vertices, triangles);
+  ReadMeshFile(input_path, vertices, triangles);
   std::cerr << "Loaded " << vertices.size() << " vertices and " << triangles.size() << " triangles from file." << std::endl;
 
   // Translate vertices.
@@ -37,5 +53,5 @@ int32_t main(int32_t argc, char *argv[]) {
   }
 
   // Write outputs.
-  WriteBinaryStl(output_path, vertices, triangles);
+  WriteMeshFile(output_path, vertices, triangles, format);
 }
@@ -0,0 +1,308 @@
+#include "solidify.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/topology.hpp"
+
+namespace {
+
+double Orient(const glm::dvec2 &a, const glm::dvec2 &b, const glm::dvec2 &c) {
+  return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// Triangulate a counterclockwise polygon that is monotone along `axis` (0 for
+// x, 1 for y), as counterclockwise triangles of polygon indices, in linear
+// time. Points are ordered by that coordinate, then by the other times `tie`,
+// which decides which chain an edge along the other axis belongs to. Returns
+// false, leaving `triangles` in an unspecified state, if the polygon is not
+// monotone in that order or a triangle would have no area.
+bool TriangulateMonotone(const std::vector<glm::dvec2> &polygon,
+                         const int axis,
+                         const double tie,
+                         std::vector<glm::ivec3> *triangles) {
+  const size_t n = polygon.size();
+  const auto less = [&](const size_t a, const size_t b) {
+    const glm::dvec2 &p = polygon[a];
+    const glm::dvec2 &q = polygon[b];
+    return p[axis] < q[axis] || (p[axis] == q[axis] && tie * p[1 - axis] < tie * q[1 - axis]);
+  };
+  size_t lo = 0;
+  size_t hi = 0;
+  for (size_t i = 1; i < n; i++) {
+    lo = less(i, lo) ? i : lo;
+    hi = less(hi, i) ? i : hi;
+  }
+  // Counterclockwise from lo to hi is the lower chain, from hi back to lo the
+  // upper chain. Both must be strictly monotone.
+  std::vector<uint8_t> upper(n, 0);
+  for (size_t i = lo; i != hi; i = (i + 1) % n) {
+    if (!less(i, (i + 1) % n)) {
+      return false;
+    }
+  }
+  for (size_t i = hi; i != lo; i = (i + 1) % n) {
+    if (!less((i + 1) % n, i)) {
+      return false;
+    }
+    upper[i] = 1;
+  }
+
+  // Merge the chains into one sorted sequence.
+  std::vector<size_t> order;
+  order.reserve(n);
+  size_t a = (lo + 1) % n;
+  size_t b = (lo + n - 1) % n;
+  order.push_back(lo);
+  while (a != hi || b != hi) {
+    if (b == hi || (a != hi && less(a, b))) {
+      order.push_back(a);
+      a = (a + 1) % n;
+    } else {
+      order.push_back(b);
+      b = (b + n - 1) % n;
+    }
+  }
+  order.push_back(hi);
+
+  triangles->clear();
+  triangles->reserve(n - 2);
+  const auto emit = [&](const size_t p, const size_t q, const size_t r) {
+    const double orientation = Orient(polygon[p], polygon[q], polygon[r]);
+    if (orientation == 0) {
+      return false;
+    }
+    const int32_t i = static_cast<int32_t>(p);
+    const int32_t j = static_cast<int32_t>(q);
+    const int32_t k = static_cast<int32_t>(r);
+    triangles->push_back(orientation > 0 ? glm::ivec3(i, j, k) : glm::ivec3(i, k, j));
+    return true;
+  };
+  std::vector<size_t> stack = {order[0], order[1]};
+  for (size_t j = 2; j + 1 < n; j++) {
+    const size_t u = order[j];
+    if (upper[u] != upper[stack.back()]) {
+      for (size_t s = 0; s + 1 < stack.size(); s++) {
+        if (!emit(u, stack[s], stack[s + 1])) {
+          return false;
+        }
+      }
+      stack = {order[j - 1], u};
+      continue;
+    }
+    size_t last = stack.back();
+    stack.pop_back();
+    // The diagonal from u to the vertex below `last` is inside if the chain
+    // turns toward the interior at `last`.
+    while (!stack.empty()) {
+      const double turn = Orient(polygon[stack.back()], polygon[last], polygon[u]);
+      if (!(upper[u] ? turn < 0 : turn > 0)) {
+        break;
+      }
+      if (!emit(u, last, stack.back())) {
+        return false;
+      }
+      last = stack.back();
+      stack.pop_back();
+    }
+    stack.push_back(last);
+    stack.push_back(u);
+  }
+  for (size_t s = 0; s + 1 < stack.size(); s++) {
+    if (!emit(order[n - 1], stack[s], stack[s + 1])) {
+      return false;
+    }
+  }
+  return triangles->size() == n - 2;
+}
+
+// Triangulate a counterclockwise simple polygon by ear clipping, as
+// counterclockwise triangles of polygon indices. Quadratic, so only for
+// boundaries that are not monotone. Only reflex and collinear vertices can be
+// inside an ear, so convex ones are skipped in the test. Exits if no ear is
+// left, as with a self-touching boundary, rather than fold the base.
+std::vector<glm::ivec3> EarClip(const std::vector<glm::dvec2> &polygon) {
+  const int32_t n = static_cast<int32_t>(polygon.size());
+  std::vector<int32_t> prev(polygon.size());
+  std::vector<int32_t> next(polygon.size());
+  for (int32_t i = 0; i < n; i++) {
+    prev[static_cast<size_t>(i)] = (i + n - 1) % n;
+    next[static_cast<size_t>(i)] = (i + 1) % n;
+  }
+  const auto at = [&](const int32_t i) -> const glm::dvec2 & { return polygon[static_cast<size_t>(i)]; };
+  const auto is_convex = [&](const int32_t i) {
+    return Orient(at(prev[static_cast<size_t>(i)]), at(i), at(next[static_cast<size_t>(i)])) > 0;
+  };
+  const auto is_ear = [&](const int32_t i) {
+    const int32_t p = prev[static_cast<size_t>(i)];
+    const int32_t q = next[static_cast<size_t>(i)];
+    if (!is_convex(i)) {
+      return false;
+    }
+    for (int32_t j = next[static_cast<size_t>(q)]; j != p; j = next[static_cast<size_t>(j)]) {
+      if (is_convex(j) || at(j) == at(p) || at(j) == at(i) || at(j) == at(q)) {
+        continue;
+      }
+      if (Orient(at(p), at(i), at(j)) >= 0 && Orient(at(i), at(q), at(j)) >= 0 && Orient(at(q), at(p), at(j)) >= 0) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  std::vector<glm::ivec3> triangles;
+  triangles.reserve(polygon.size() - 2);
+  int32_t remaining = n;
+  int32_t i = 0;
+  int32_t misses = 0;
+  while (remaining > 3) {
+    if (misses > remaining) {
+      fprintf(stderr, "Can't triangulate the base: no ear left with %d of %d boundary vertices remaining.\n",
+              remaining, n);
+      std::exit(1);
+    }
+    if (is_ear(i)) {
+      const int32_t p = prev[static_cast<size_t>(i)];
+      const int32_t q = next[static_cast<size_t>(i)];
+      triangles.emplace_back(p, i, q);
+      next[static_cast<size_t>(p)] = q;
+      prev[static_cast<size_t>(q)] = p;
+      remaining--;
+      misses = 0;
+      i = p;
+    } else {
+      i = next[static_cast<size_t>(i)];
+      misses++;
+    }
+  }
+  triangles.emplace_back(prev[static_cast<size_t>(i)], i, next[static_cast<size_t>(i)]);
+  return triangles;
+}
+
+}  // namespace
+
+void SolidifyMesh(const float base_thickness, std::vector<glm::vec3> *points, std::vector<glm::ivec3> *triangles) {
+  const ScopedStage stage("solidify");
+  if (points->empty() || triangles->empty()) {
+    fprintf(stderr, "Can't solidify an empty mesh.\n");
+    std::exit(1);
+  }
+  std::vector<int32_t> loop;
+  {
+    const HalfEdgeMesh half_edges = BuildHalfEdges(points->size(), *triangles);
+    if (half_edges.num_non_manifold_half_edges > 0) {
+      fprintf(stderr, "Can't solidify a mesh with %llu non-manifold half-edges.\n",
+              static_cast<unsigned long long>(half_edges.num_non_manifold_half_edges));
+      std::exit(1);
+    }
+    const std::vector<std::vector<int32_t>> loops = BoundaryLoops(half_edges, *triangles);
+    if (loops.size() != 1 || loops[0].size() != half_edges.num_boundary_half_edges) {
+      fprintf(stderr, "Can only solidify a surface with one boundary loop, this one has %zu.\n", loops.size());
+      std::exit(1);
+    }
+    for (const int32_t h : loops[0]) {
+      loop.push_back(HalfEdgeOrigin(*triangles, h));
+    }
+  }
+  std::vector<uint8_t> on_loop(points->size(), 0);
+  for (const int32_t v : loop) {
+    if (on_loop[static_cast<size_t>(v)]++) {
+      fprintf(stderr, "Can't solidify a surface whose boundary touches itself at vertex %d.\n", v);
+      std::exit(1);
+    }
+  }
+
+  // The boundary runs counterclockwise seen from above around an upward
+  // facing surface.
+  const size_t n = loop.size();
+  std::vector<glm::dvec2> polygon(n);
+  double twice_area = 0;
+  for (size_t i = 0; i < n; i++) {
+    const glm::vec3 &point = (*points)[static_cast<size_t>(loop[i])];
+    polygon[i] = glm::dvec2(double{point.x}, double{point.y});
+  }
+  for (size_t i = 0; i < n; i++) {
+    const glm::dvec2 &a = polygon[i];
+    const glm::dvec2 &b = polygon[(i + 1) % n];
+    twice_area += a.x * b.y - b.x * a.y;
+  }
+  if (twice_area == 0) {
+    fprintf(stderr, "Can't solidify a surface whose boundary encloses no area from above.\n");
+    std::exit(1);
+  }
+  if (twice_area < 0) {
+    fprintf(stderr, "The surface faces down, flipping it before solidifying.\n");
+    for (glm::ivec3 &triangle : *triangles) {
+      std::swap(triangle[1], triangle[2]);
+    }
+    std::reverse(loop.begin(), loop.end());
+    std::reverse(polygon.begin(), polygon.end());
+    twice_area = -twice_area;
+  }
+
+  float min_z = (*points)[0].z;
+  for (const glm::vec3 &point : *points) {
+    min_z = std::min(min_z, point.z);
+  }
+  const float base_z = min_z - base_thickness;
+  const int32_t first_base = static_cast<int32_t>(points->size());
+  for (const int32_t v : loop) {
+    const glm::vec3 &point = (*points)[static_cast<size_t>(v)];
+    points->emplace_back(point.x, point.y, base_z);
+  }
+
+  // Each boundary edge a -> b gets a quad down to its base edge a' -> b',
+  // using b -> a so it shares the edge with the surface.
+  const size_t num_surface_triangles = triangles->size();
+  for (size_t i = 0; i < n; i++) {
+    const size_t j = (i + 1) % n;
+    const int32_t a = loop[i];
+    const int32_t b = loop[j];
+    const int32_t a_base = first_base + static_cast<int32_t>(i);
+    const int32_t b_base = first_base + static_cast<int32_t>(j);
+    triangles->emplace_back(b, a, a_base);
+    triangles->emplace_back(b, a_base, b_base);
+  }
+
+  // The base faces down, so its triangles run clockwise seen from above and
+  // use each base edge as b' -> a'.
+  double centroid_x = 0;
+  double centroid_y = 0;
+  for (size_t i = 0; i < n; i++) {
+    const glm::dvec2 &a = polygon[i];
+    const glm::dvec2 &b = polygon[(i + 1) % n];
+    centroid_x += (a.x + b.x) * (a.x * b.y - b.x * a.y);
+    centroid_y += (a.y + b.y) * (a.x * b.y - b.x * a.y);
+  }
+  const glm::dvec2 centroid(centroid_x / (3 * twice_area), centroid_y / (3 * twice_area));
+  bool star_shaped = true;
+  for (size_t i = 0; i < n && star_shaped; i++) {
+    star_shaped = Orient(polygon[i], polygon[(i + 1) % n], centroid) > 0;
+  }
+  if (star_shaped) {
+    const int32_t center = static_cast<int32_t>(points->size());
+    points->emplace_back(static_cast<float>(centroid.x), static_cast<float>(centroid.y), base_z);
+    for (size_t i = 0; i < n; i++) {
+      triangles->emplace_back(center, first_base + static_cast<int32_t>((i + 1) % n),
+                              first_base + static_cast<int32_t>(i));
+    }
+  } else {
+    // Raster boundaries are monotone in x and y unless something cut into
+    // them, and one of their sides runs along the other axis.
+    std::vector<glm::ivec3> base;
+    if (!TriangulateMonotone(polygon, 0, 1, &base) && !TriangulateMonotone(polygon, 0, -1, &base) &&
+        !TriangulateMonotone(polygon, 1, 1, &base) && !TriangulateMonotone(polygon, 1, -1, &base)) {
+      fprintf(stderr, "The boundary is not monotone, ear clipping the base.\n");
+      base = EarClip(polygon);
+    }
+    for (const glm::ivec3 &triangle : base) {
+      triangles->emplace_back(first_base + triangle[2], first_base + triangle[1], first_base + triangle[0]);
+    }
+  }
+  StatsAdd("solid_boundary_vertices", n);
+  StatsAdd("solid_added_triangles", triangles->size() - num_surface_triangles);
+  StatsSet("solid_base_fan", star_shaped ? 1 : 0);
+}
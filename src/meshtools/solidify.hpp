@@ -0,0 +1,18 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Close a welded height surface into a solid for printing or milling: walls
+// run straight down from the boundary to a flat base `base_thickness` below
+// the lowest point, and the base is triangulated.
+//
+// The surface must be manifold with exactly one boundary loop, like hmm,
+// triangulate_dem and stitch_tiles output after any output scaling. It is
+// re-wound first if it faces down. Walls and base reuse the boundary
+// vertices, so the result is a closed manifold with outward facing
+// triangles. The base is a fan around the boundary's centroid when every
+// boundary edge faces it, as it does for rectangular rasters. Otherwise it is
+// triangulated in linear time if the boundary is monotone in x or y, and ear
+// clipped as a last resort. Exits on input it can't close.
+void SolidifyMesh(float base_thickness, std::vector<glm::vec3> *points, std::vector<glm::ivec3> *triangles);
@@ -0,0 +1,43 @@
+#include <cstdio>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/mesh_io.hpp"
+#include "src/meshtools/solidify.hpp"
+#include "src/meshtools/stats.hpp"
+
+// Close a scaled height surface into a watertight solid with walls down to a
+// flat base, ready to print or mill. base_thickness is in output units below
+// the lowest point of the surface.
+// Usage: ./solidify_stl input output base_thickness [--format=stl|ply|mesh|3mf]
+int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  const MeshFormat format = ParseFormatFlag(&argc, argv);
+  // Parse flags.
+  if (argc != 4) {
+    fprintf(stderr, "Usage: ./solidify_stl input output base_thickness [--format=stl|ply|mesh|3mf]\n");
+    std::exit(1);
+  }
+  const std::string input_path = argv[1];
+  const std::string output_path = argv[2];
+  const float base_thickness = std::stof(argv[3]);
+  if (!(base_thickness > 0)) {
+    fprintf(stderr, "base_thickness must be positive, got %s\n", argv[3]);
+    std::exit(1);
+  }
+
+  // Read inputs.
+  std::vector<glm::vec3> vertices;
+  std::vector<glm::ivec3> triangles;
+  ReadMeshFile(input_path, vertices, triangles);
+  std::cerr << "Loaded " << vertices.size() << " vertices and " << triangles.size() << " triangles from file." << std::endl;
+
+  SolidifyMesh(base_thickness, &vertices, &triangles);
+  std::cerr << "Solid has " << vertices.size() << " vertices and " << triangles.size() << " triangles." << std::endl;
+
+  // Write outputs.
+  WriteMeshFile(output_path, vertices, triangles, format);
+}
@@ -0,0 +1,206 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sys/resource.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct StageStats {
+  std::string name;
+  uint64_t calls = 0;
+  double seconds = 0;
+  uint64_t peak_rss_bytes = 0;
+};
+
+struct StatsState {
+  std::mutex mutex;
+  bool enabled = false;
+  std::string path;
+  std::string binary;
+  std::vector<std::string> args;
+  std::chrono::steady_clock::time_point start;
+  // Kept in first-recorded order so reports diff cleanly.
+  std::vector<StageStats> stages;
+  std::vector<std::pair<std::string, uint64_t>> counters;
+  std::vector<std::pair<std::string, double>> values;
+};
+
+StatsState &State() {
+  static StatsState *state = new StatsState;
+  return *state;
+}
+
+uint64_t PeakRssBytes() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  return 1024 * static_cast<uint64_t>(usage.ru_maxrss);
+}
+
+template <typename T>
+T &FindOrAdd(std::vector<std::pair<std::string, T>> *entries, const char *name) {
+  for (auto &entry : *entries) {
+    if (entry.first == name) {
+      return entry.second;
+    }
+  }
+  entries->emplace_back(name, T{});
+  return entries->back().second;
+}
+
+std::string JsonString(const std::string &text) {
+  std::string quoted = "\"";
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned int>(c));
+      quoted += escape;
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+void WriteStatsAtExit() {
+  WriteStats(State().path);
+}
+
+}  // namespace
+
+void InitStats(int32_t *argc, char *argv[]) {
+  StatsState &state = State();
+  const char *slash = strrchr(argv[0], '/');
+  state.binary = slash ? slash + 1 : argv[0];
+  state.start = std::chrono::steady_clock::now();
+
+  int32_t kept = 1;
+  for (int32_t k = 1; k < *argc; k++) {
+    if (strncmp(argv[k], "--stats=", 8) == 0) {
+      state.path = argv[k] + 8;
+      if (state.path.empty()) {
+        fprintf(stderr, "--stats needs a path, e.g. --stats=stats.json\n");
+        std::exit(1);
+      }
+      continue;
+    }
+    state.args.push_back(argv[k]);
+    argv[kept++] = argv[k];
+  }
+  argv[kept] = nullptr;
+  *argc = kept;
+
+  if (!state.path.empty() && !state.enabled) {
+    state.enabled = true;
+    std::atexit(WriteStatsAtExit);
+  }
+}
+
+bool StatsEnabled() {
+  return State().enabled;
+}
+
+void StatsAdd(const char *counter, const uint64_t amount) {
+  StatsState &state = State();
+  if (!state.enabled) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(state.mutex);
+  FindOrAdd(&state.counters, counter) += amount;
+}
+
+void StatsSet(const char *name, const double value) {
+  StatsState &state = State();
+  if (!state.enabled) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(state.mutex);
+  FindOrAdd(&state.values, name) = value;
+}
+
+ScopedStage::ScopedStage(const char *name) : name_(StatsEnabled() ? name : nullptr) {
+  if (name_ != nullptr) {
+    start_ = std::chrono::steady_clock::now();
+  }
+}
+
+ScopedStage::~ScopedStage() {
+  if (name_ == nullptr) {
+    return;
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+  const uint64_t peak_rss_bytes = PeakRssBytes();
+  StatsState &state = State();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  StageStats *stage = nullptr;
+  for (StageStats &existing : state.stages) {
+    if (existing.name == name_) {
+      stage = &existing;
+    }
+  }
+  if (stage == nullptr) {
+    state.stages.emplace_back();
+    stage = &state.stages.back();
+    stage->name = name_;
+  }
+  stage->calls++;
+  stage->seconds += seconds;
+  stage->peak_rss_bytes = std::max(stage->peak_rss_bytes, peak_rss_bytes);
+}
+
+void WriteStats(const std::string &path) {
+  StatsState &state = State();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  FILE *output = fopen(path.c_str(), "w");
+  if (output == NULL) {
+    fprintf(stderr, "Error opening stats output %s.\n", path.c_str());
+    return;
+  }
+  const double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - state.start).count();
+
+  fprintf(output, "{\n  \"binary\": %s,\n  \"args\": [", JsonString(state.binary).c_str());
+  for (uint64_t k = 0; k < state.args.size(); k++) {
+    fprintf(output, "%s%s", k ? ", " : "", JsonString(state.args[k]).c_str());
+  }
+  fprintf(output, "],\n  \"wall_seconds\": %.6f,\n", wall_seconds);
+  fprintf(output, "  \"peak_rss_bytes\": %llu,\n", static_cast<unsigned long long>(PeakRssBytes()));
+
+  fprintf(output, "  \"stages\": [");
+  for (uint64_t k = 0; k < state.stages.size(); k++) {
+    const StageStats &stage = state.stages[k];
+    fprintf(output, "%s\n    {\"name\": %s, \"calls\": %llu, \"seconds\": %.6f, \"peak_rss_bytes\": %llu}",
+            k ? "," : "", JsonString(stage.name).c_str(), static_cast<unsigned long long>(stage.calls),
+            stage.seconds, static_cast<unsigned long long>(stage.peak_rss_bytes));
+  }
+  fprintf(output, "\n  ],\n  \"counters\": {");
+  for (uint64_t k = 0; k < state.counters.size(); k++) {
+    fprintf(output, "%s\n    %s: %llu", k ? "," : "", JsonString(state.counters[k].first).c_str(),
+            static_cast<unsigned long long>(state.counters[k].second));
+  }
+  fprintf(output, "\n  },\n  \"values\": {");
+  for (uint64_t k = 0; k < state.values.size(); k++) {
+    // JSON has no NaN or infinity, e.g. for a ratio over empty input.
+    const double value = state.values[k].second;
+    fprintf(output, "%s\n    %s: ", k ? "," : "", JsonString(state.values[k].first).c_str());
+    if (std::isfinite(value)) {
+      fprintf(output, "%.9g", value);
+    } else {
+      fprintf(output, "null");
+    }
+  }
+  fprintf(output, "\n  }\n}\n");
+  if (fclose(output) != 0) {
+    fprintf(stderr, "Error writing stats output %s.\n", path.c_str());
+  }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Process-wide instrumentation: named stage timers, counters and values,
+// written as JSON when the process exits. Everything is a cheap no-op until
+// InitStats sees a --stats flag.
+//
+// Example report:
+//   {"binary": "terrain_pipeline", "args": [...], "wall_seconds": 12.3,
+//    "peak_rss_bytes": 123, "stages": [{"name": "read_stl", "calls": 1,
+//    "seconds": 4.5, "peak_rss_bytes": 100}], "counters": {...},
+//    "values": {...}}
+
+// Remove a --stats=path.json argument from argv, if present, and arrange for
+// the report to be written to that path at exit. Call first thing in main so
+// the remaining positional argument checks are unchanged.
+void InitStats(int32_t *argc, char *argv[]);
+
+bool StatsEnabled();
+
+// Add to a counter, e.g. bytes read or triangles written. Thread safe.
+void StatsAdd(const char *counter, uint64_t amount);
+
+// Set a value, keeping the last one written, e.g. a load factor. NaN and
+// infinity are reported as null.
+void StatsSet(const char *name, double value);
+
+// Time a stage from construction to destruction. Nested and repeated stages
+// are recorded separately by name, accumulating seconds and calls. Peak RSS
+// is sampled when the stage ends.
+class ScopedStage {
+ public:
+  explicit ScopedStage(const char *name);
+  ~ScopedStage();
+
+  ScopedStage(const ScopedStage &) = delete;
+  ScopedStage &operator=(const ScopedStage &) = delete;
+
+ private:
+  const char *name_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Write the report now. InitStats already does this at exit.
+void WriteStats(const std::string &path);
@@ -0,0 +1,35 @@
+#include <cstdio>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/mesh_io.hpp"
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/terrain.hpp"
+#include "src/meshtools/tiles.hpp"
+
+// Stitch per-tile hmm meshes into one unscaled mesh of the whole raster.
+// Tiles are listed row by row from the top left, as cut by tile_window.
+// Usage: ./stitch_tiles gdalinfo.json tiles_x tiles_y output tile_0_0 tile_1_0 ...
+int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  if (argc < 6) {
+    fprintf(stderr, "Usage: ./stitch_tiles gdalinfo.json tiles_x tiles_y output tile_0_0 tile_1_0 ...\n");
+    std::exit(1);
+  }
+  const GdalInfo info = ReadGdalInfo(argv[1]);
+  const int32_t tiles_x = std::stoi(argv[2]);
+  const int32_t tiles_y = std::stoi(argv[3]);
+  const std::string output_path = argv[4];
+  const std::vector<std::string> tile_paths(argv + 5, argv + argc);
+
+  std::vector<glm::vec3> vertices;
+  std::vector<glm::ivec3> triangles;
+  StitchTiles(tile_paths, info.width, info.height, tiles_x, tiles_y, &vertices, &triangles);
+  std::cerr << "Stitched " << tile_paths.size() << " tiles into " << vertices.size() << " vertices and "
+            << triangles.size() << " triangles." << std::endl;
+
+  WriteMeshFile(output_path, vertices, triangles);
+}
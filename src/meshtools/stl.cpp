@@ -1,25 +1,138 @@
 #include "stl.hpp"
 
-#define GLM_ENABLE_EXPERIMENTAL
-
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
 #include <cstring>
-#include <fstream>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <iostream>
-#include <unordered_map>
+#include <thread>
+#include <unistd.h>
+
+#include "src/meshtools/mapped_file.hpp"
+#include "src/meshtools/normals.hpp"
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+
+namespace {
+
+// Triangles whose normals are computed at once before encoding their records.
+constexpr uint64_t kEncodeBlockTriangles = 1024;
+
+// Encode one 50 byte record.
+inline void EncodeStlRecord(const glm::vec3 &normal, const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, uint8_t *record) {
+    memcpy(record, &normal, 12);
+    memcpy(record + 12, &p0, 12);
+    memcpy(record + 24, &p1, 12);
+    memcpy(record + 36, &p2, 12);
+    memset(record + 48, 0, 2);
+}
+
+// Encode records [begin, end) of `triangles` into `dst`, one 50 byte record
+// each, with normals recomputed from the vertices.
+void EncodeStlRecords(
+    const std::vector<glm::vec3> &points,
+    const std::vector<glm::ivec3> &triangles,
+    const uint64_t begin,
+    const uint64_t end,
+    uint8_t *dst)
+{
+    glm::vec3 normals[kEncodeBlockTriangles];
+    for (uint64_t first = begin; first < end; first += kEncodeBlockTriangles) {
+        const uint64_t last = std::min(first + kEncodeBlockTriangles, end);
+        FaceNormals(points, triangles, first, last, normals, nullptr);
+        for (uint64_t i = first; i < last; i++) {
+            const glm::ivec3 t = triangles[i];
+            EncodeStlRecord(normals[i - first], points[static_cast<uint64_t>(t.x)], points[static_cast<uint64_t>(t.y)],
+                            points[static_cast<uint64_t>(t.z)], dst + (i - begin) * kStlRecordBytes);
+        }
+    }
+}
+
+void ReadAll(const int fd, uint8_t *data, uint64_t size, uint64_t offset, const std::string &path) {
+    while (size > 0) {
+        const ssize_t got = pread(fd, data, size, static_cast<off_t>(offset));
+        if (got <= 0) {
+            std::cerr << "Error reading " << path << ": " << (got == 0 ? "unexpected end of file" : strerror(errno)) << std::endl;
+            std::exit(1);
+        }
+        data += got;
+        size -= static_cast<uint64_t>(got);
+        offset += static_cast<uint64_t>(got);
+    }
+}
+
+// Stream the records of a binary STL to `consume` a chunk at a time, reading
+// the next chunk on another thread while the current one is consumed.
+void ReadStlChunks(const int fd,
+                   const std::string &path,
+                   const uint64_t num_triangles,
+                   const uint64_t chunk_triangles,
+                   const std::function<void(const uint8_t *records, uint64_t count)> &consume) {
+  std::vector<uint8_t> buffers[2];
+  auto read_chunk = [&](const uint64_t chunk) {
+    const uint64_t begin = chunk * chunk_triangles;
+    std::vector<uint8_t> &buffer = buffers[chunk % 2];
+    buffer.resize(std::min(chunk_triangles, num_triangles - begin) * kStlRecordBytes);
+    ReadAll(fd, buffer.data(), buffer.size(), kStlHeaderBytes + begin * kStlRecordBytes, path);
+  };
+  const uint64_t num_chunks = (num_triangles + chunk_triangles - 1) / chunk_triangles;
+  if (num_chunks > 0) {
+    read_chunk(0);
+  }
+  for (uint64_t chunk = 0; chunk < num_chunks; chunk++) {
+    std::thread reader;
+    if (chunk + 1 < num_chunks) {
+      reader = std::thread(read_chunk, chunk + 1);
+    }
+    const std::vector<uint8_t> &buffer = buffers[chunk % 2];
+    consume(buffer.data(), buffer.size() / kStlRecordBytes);
+    if (reader.joinable()) {
+      reader.join();
+    }
+  }
+}
 
-#include <glm/gtx/normal.hpp>
+// Decode the corners of `count` records, three per triangle.
+void DecodeCorners(const uint8_t *records, const uint64_t count, std::vector<glm::vec3> *corners) {
+  corners->resize(3 * count);
+  glm::vec3 *data = corners->data();
+  ParallelFor(count, 1 << 14, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t t = begin; t < end; t++) {
+      memcpy(&data[3 * t], records + t * kStlRecordBytes + 12, 36);
+    }
+  });
+}
+
+VertexBounds BoundsOf(const std::vector<glm::vec3> &vertices) {
+  const uint32_t num_chunks = NumThreads();
+  std::vector<VertexBounds> chunk_bounds(num_chunks, {glm::vec3(INFINITY), glm::vec3(-INFINITY)});
+  ParallelForChunks(vertices.size(), num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    VertexBounds &bounds = chunk_bounds[chunk];
+    for (uint64_t i = begin; i < end; i++) {
+      bounds.min = glm::min(bounds.min, vertices[i]);
+      bounds.max = glm::max(bounds.max, vertices[i]);
+    }
+  });
+  VertexBounds bounds = chunk_bounds[0];
+  for (const VertexBounds &other : chunk_bounds) {
+    bounds.min = glm::min(bounds.min, other.min);
+    bounds.max = glm::max(bounds.max, other.max);
+  }
+  return bounds;
+}
 
-#include "src/meshtools/hash.hpp"
+}  // namespace
 
 void WriteBinaryStl(
     const std::string &path,
     const std::vector<glm::vec3> &points,
-    const std::vector<glm::ivec3> &triangles)
+    const std::vector<glm::ivec3> &triangles,
+    const uint64_t max_buffer_bytes)
 {
+    const ScopedStage stage("write_stl");
     // TODO(greg): properly handle endian-ness
-    const uint64_t numBytes = triangles.size() * 50 + 84;
-    char *dst = (char *)calloc(numBytes, 1);
-
     const uint32_t count = static_cast<uint32_t>(triangles.size());
 
     // Check for overflow. Quit if num triangles too big.
@@ -28,100 +141,187 @@ void WriteBinaryStl(
       std::exit(1);
     }
 
-    memcpy(dst + 80, &count, 4);
-
-    for (uint32_t i = 0; i < triangles.size(); i++) {
-        const glm::ivec3 t = triangles[i];
-        const glm::vec3 p0 = points[static_cast<uint64_t>(t.x)];
-        const glm::vec3 p1 = points[static_cast<uint64_t>(t.y)];
-        const glm::vec3 p2 = points[static_cast<uint64_t>(t.z)];
-        const glm::vec3 normal = glm::triangleNormal(p0, p1, p2);
-        const uint64_t idx = 84 + i * 50;
-        memcpy(dst + idx, &normal, 12);
-        memcpy(dst + idx + 12, &p0, 12);
-        memcpy(dst + idx + 24, &p1, 12);
-        memcpy(dst + idx + 36, &p2, 12);
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+      std::cerr << "Error opening " << path << " for writing: " << strerror(errno) << std::endl;
+      std::exit(1);
     }
 
-    std::fstream file(path, std::ios::out | std::ios::binary);
-    file.write(dst, static_cast<int64_t>(numBytes));
-    file.close();
+    uint8_t header[kStlHeaderBytes] = {};
+    memcpy(header + 80, &count, 4);
+    WriteAll(fd, header, kStlHeaderBytes, path);
+
+    // Two buffers: one is encoded in parallel while the other is written.
+    const uint64_t chunk_triangles = std::max<uint64_t>(1, max_buffer_bytes / 2 / kStlRecordBytes);
+    std::vector<uint8_t> buffers[2];
+    std::thread writer;
+    for (uint64_t begin = 0, chunk = 0; begin < triangles.size(); begin += chunk_triangles, chunk++) {
+        const uint64_t end = std::min<uint64_t>(begin + chunk_triangles, triangles.size());
+        std::vector<uint8_t> &buffer = buffers[chunk % 2];
+        buffer.resize((end - begin) * kStlRecordBytes);
+        ParallelFor(end - begin, 1 << 14, [&](const uint64_t chunk_begin, const uint64_t chunk_end, uint32_t) {
+            EncodeStlRecords(points, triangles, begin + chunk_begin, begin + chunk_end,
+                             buffer.data() + chunk_begin * kStlRecordBytes);
+        });
+        if (writer.joinable()) {
+            writer.join();
+        }
+        writer = std::thread([fd, &buffer, &path] { WriteAll(fd, buffer.data(), buffer.size(), path); });
+    }
+    if (writer.joinable()) {
+        writer.join();
+    }
 
-    free(dst);
+    if (close(fd) != 0) {
+      std::cerr << "Error closing " << path << ": " << strerror(errno) << std::endl;
+      std::exit(1);
+    }
+    StatsAdd("stl_bytes_written", kStlHeaderBytes + kStlRecordBytes * triangles.size());
+    StatsAdd("stl_triangles_written", triangles.size());
 }
 
-void ReadBinarySTL(
-    const std::string &path,
-    std::vector<glm::vec3> &points,
-    std::vector<glm::ivec3> &triangles)
-{
-  std::ifstream is(path, std::ios::in | std::ifstream::binary);
-  if (!is) {
-    std::cerr << "Error opening " << path << ".";
+StlRecordView ParseBinaryStl(const uint8_t *data, const uint64_t file_size) {
+  if (file_size < kStlHeaderBytes) {
+    std::cerr << "Invalid STL file." << std::endl;
+    std::cerr << "File is " << file_size << " bytes, too small for the " << kStlHeaderBytes << " byte header." << std::endl;
     std::exit(1);
   }
-  is.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-
-  // Get length of file:
-  is.seekg (0, is.end);
-  std::streamoff file_size = is.tellg();
-  is.seekg (0, is.beg);
 
-  std::unordered_map<glm::vec3, int32_t> point_map;
-
-  // 80 bytes header (ignored)
-  char buffer[80];
-  is.read(buffer, 80);
-
-  // number of triangles
+  // 80 bytes header (ignored), then number of triangles
   uint32_t expected_num_triangles = 0;
-  is.read(reinterpret_cast<char*>(&expected_num_triangles), sizeof(uint32_t));
+  memcpy(&expected_num_triangles, data + 80, sizeof(uint32_t));
 
   // Check file size.
-  int64_t expected_file_size = 84 + 50*static_cast<int64_t>(expected_num_triangles);
+  const uint64_t expected_file_size = kStlHeaderBytes + kStlRecordBytes * static_cast<uint64_t>(expected_num_triangles);
   if (expected_file_size != file_size) {
     std::cerr << "Invalid STL file." << std::endl;
     std::cerr << "Header shows " << expected_num_triangles << " so file should be 84 + 50 * " << expected_num_triangles << " = " << expected_file_size << "." << std::endl;
     std::cerr << "Actual file is " << file_size << std::endl;
     std::exit(1);
   }
-  
-  // read each triangle
-  for (int64_t count=0; count<static_cast<int64_t>(expected_num_triangles); count++) {
-    // Read and discard normal.
-    glm::vec3 normal;
-    static_assert(sizeof(normal) == 3*sizeof(float));
-    is.read(reinterpret_cast<char*>(&normal), 3*sizeof(float));
-
-    // Read three vertices.
-    glm::vec3 vertices[3];
-    static_assert(sizeof(vertices) == 9*sizeof(float));
-    is.read(reinterpret_cast<char*>(vertices), 9*sizeof(float));
-
-    // Record the triangle
-    int32_t point_indices[3];
-    for (int k=0; k<3; k++) {
-      const glm::vec3 &point = vertices[k];
-
-      if (point_map.find(point) != point_map.end()) {
-        // If point is already known, reference it.
-        point_indices[k] = point_map.at(point);
-      } else {
-        // If point is not known, insert it.
-        const int32_t new_index = static_cast<int32_t>(points.size());
-        point_indices[k] = new_index;
-        points.push_back(point);
-        point_map.insert({point, new_index});
-      }
+
+  StlRecordView view;
+  view.records = data + kStlHeaderBytes;
+  view.num_triangles = expected_num_triangles;
+  return view;
+}
+
+void ReadBinarySTL(
+    const std::string &path,
+    std::vector<glm::vec3> &points,
+    std::vector<glm::ivec3> &triangles,
+    const bool check_attribute_byte_count)
+{
+  const ScopedStage stage("read_stl");
+  const MappedFile file(path);
+  const StlRecordView view = ParseBinaryStl(file.data(), file.size());
+
+  // Attribute byte count. According to wikipedia this should always be zero.
+  if (check_attribute_byte_count) {
+    for (uint64_t count=0; count<view.num_triangles; count++) {
+      assert(view.AttributeByteCount(count) == 0);
     }
-    glm::ivec3 triangle_index = {point_indices[0], point_indices[1], point_indices[2]};
-    triangles.push_back(triangle_index);
+  }
 
-    // Read attribute byte count. According to wikipedia this should always be zero.
-    uint16_t attribute_byte_count;
-    is.read(reinterpret_cast<char*>(&attribute_byte_count), sizeof(uint16_t));
-    assert(attribute_byte_count == 0);
+  points.reserve(points.size() + view.num_triangles / 2 + 3);
+  // Unscaled heightmap meshes weld on compact grid keys.
+  WeldVertices(view.Corners(), WeldMethod::kGrid, &points, &triangles);
+  StatsAdd("stl_bytes_read", file.size());
+  StatsAdd("stl_triangles_read", view.num_triangles);
+}
+
+VertexBounds StreamTransformStl(
+    const std::string &input_path,
+    const std::string &output_path,
+    const std::function<void(std::vector<glm::vec3> *corners)> &transform,
+    const std::function<void(const VertexBounds &bounds, std::vector<glm::vec3> *corners)> &finish,
+    const uint64_t chunk_triangles)
+{
+  const int input_fd = open(input_path.c_str(), O_RDONLY);
+  struct stat input_stat;
+  if (input_fd < 0 || fstat(input_fd, &input_stat) != 0) {
+    std::cerr << "Error opening " << input_path << ": " << strerror(errno) << std::endl;
+    std::exit(1);
+  }
+  posix_fadvise(input_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  const uint64_t file_size = static_cast<uint64_t>(input_stat.st_size);
+  // ParseBinaryStl only reads the header, which is all it checks the size with.
+  uint8_t header[kStlHeaderBytes] = {};
+  ReadAll(input_fd, header, std::min(file_size, kStlHeaderBytes), 0, input_path);
+  const uint32_t num_triangles = ParseBinaryStl(header, file_size).num_triangles;
+  const uint64_t chunk = std::max<uint64_t>(1, chunk_triangles);
+  std::vector<glm::vec3> corners;
+
+  // Pass one: bounds of the transformed corners.
+  VertexBounds bounds{glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+  if (finish) {
+    const ScopedStage stage("stream_bounds");
+    ReadStlChunks(input_fd, input_path, num_triangles, chunk, [&](const uint8_t *records, const uint64_t count) {
+      DecodeCorners(records, count, &corners);
+      transform(&corners);
+      const VertexBounds chunk_bounds = BoundsOf(corners);
+      bounds.min = glm::min(bounds.min, chunk_bounds.min);
+      bounds.max = glm::max(bounds.max, chunk_bounds.max);
+    });
+  }
+
+  // Pass two: transform, finish and write, like WriteBinaryStl with the
+  // encoded chunk written on another thread while the next one is computed.
+  const ScopedStage stage("stream_transform");
+  const int output_fd = open(output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (output_fd < 0) {
+    std::cerr << "Error opening " << output_path << " for writing: " << strerror(errno) << std::endl;
+    std::exit(1);
+  }
+  memset(header, 0, 80);
+  WriteAll(output_fd, header, kStlHeaderBytes, output_path);
+  VertexBounds written{glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+  std::vector<uint8_t> buffers[2];
+  uint64_t num_chunks = 0;
+  std::thread writer;
+  ReadStlChunks(input_fd, input_path, num_triangles, chunk, [&](const uint8_t *records, const uint64_t count) {
+    DecodeCorners(records, count, &corners);
+    transform(&corners);
+    if (finish) {
+      finish(bounds, &corners);
+    }
+    const VertexBounds chunk_bounds = BoundsOf(corners);
+    written.min = glm::min(written.min, chunk_bounds.min);
+    written.max = glm::max(written.max, chunk_bounds.max);
+
+    std::vector<uint8_t> &buffer = buffers[num_chunks++ % 2];
+    buffer.resize(count * kStlRecordBytes);
+    CornerView view;
+    view.base = reinterpret_cast<const uint8_t *>(corners.data());
+    view.num_triangles = count;
+    ParallelFor(count, 1 << 14, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+      glm::vec3 normals[kEncodeBlockTriangles];
+      for (uint64_t first = begin; first < end; first += kEncodeBlockTriangles) {
+        const uint64_t last = std::min(first + kEncodeBlockTriangles, end);
+        FaceNormals(view, first, last, normals, nullptr);
+        for (uint64_t t = first; t < last; t++) {
+          EncodeStlRecord(normals[t - first], corners[3 * t], corners[3 * t + 1], corners[3 * t + 2],
+                          buffer.data() + t * kStlRecordBytes);
+        }
+      }
+    });
+    if (writer.joinable()) {
+      writer.join();
+    }
+    writer = std::thread([output_fd, &buffer, &output_path] { WriteAll(output_fd, buffer.data(), buffer.size(), output_path); });
+  });
+  if (writer.joinable()) {
+    writer.join();
   }
 
-  is.close();
+  close(input_fd);
+  if (close(output_fd) != 0) {
+    std::cerr << "Error closing " << output_path << ": " << strerror(errno) << std::endl;
+    std::exit(1);
+  }
+  StatsAdd("stl_bytes_read", (finish ? 2 : 1) * file_size);
+  StatsAdd("stl_triangles_read", (finish ? 2 : 1) * uint64_t{num_triangles});
+  StatsAdd("stl_bytes_written", file_size);
+  StatsAdd("stl_triangles_written", num_triangles);
+  return written;
 }
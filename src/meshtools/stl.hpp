@@ -1,15 +1,98 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <glm/glm.hpp>
 #include <string>
 #include <vector>
 
+#include "src/meshtools/weld.hpp"
+
+// Binary STL layout: 80 byte header, uint32 triangle count, then one 50 byte
+// record per triangle (normal, three vertices, uint16 attribute byte count).
+constexpr uint64_t kStlHeaderBytes = 84;
+constexpr uint64_t kStlRecordBytes = 50;
+
+// Read-only view of the triangle records of a binary STL held in memory.
+// Records are not aligned, so every access goes through memcpy.
+struct StlRecordView {
+  const uint8_t *records = nullptr;
+  uint32_t num_triangles = 0;
+
+  glm::vec3 Normal(const uint64_t triangle) const {
+    glm::vec3 normal;
+    memcpy(&normal, records + triangle * kStlRecordBytes, 12);
+    return normal;
+  }
+  glm::vec3 Vertex(const uint64_t triangle, const uint64_t k) const {
+    glm::vec3 vertex;
+    memcpy(&vertex, records + triangle * kStlRecordBytes + 12 + 12 * k, 12);
+    return vertex;
+  }
+  CornerView Corners() const {
+    CornerView corners;
+    corners.base = records + 12;
+    corners.num_triangles = num_triangles;
+    corners.triangle_stride = kStlRecordBytes;
+    return corners;
+  }
+  uint16_t AttributeByteCount(const uint64_t triangle) const {
+    uint16_t count;
+    memcpy(&count, records + triangle * kStlRecordBytes + 48, 2);
+    return count;
+  }
+};
+
+// Validate the header of a binary STL of `file_size` bytes starting at `data`
+// and return a view of its records. Exits on a malformed file.
+StlRecordView ParseBinaryStl(const uint8_t *data, uint64_t file_size);
+
+// Default cap on the extra memory WriteBinaryStl uses for encoded records.
+constexpr uint64_t kDefaultStlWriteBufferBytes = 64 << 20;
+
+// Write a binary STL. Records are encoded in parallel, a chunk at a time, into
+// two buffers of max_buffer_bytes / 2 that alternate between being encoded and
+// being written, so memory use does not grow with the mesh.
 void WriteBinaryStl(
     const std::string &path,
     const std::vector<glm::vec3> &points,
-    const std::vector<glm::ivec3> &triangles);
+    const std::vector<glm::ivec3> &triangles,
+    uint64_t max_buffer_bytes = kDefaultStlWriteBufferBytes);
+
+// Default triangles per chunk for StreamTransformStl, about 25 MB of records.
+// Memory stays at a few chunks whatever the file size.
+constexpr uint64_t kDefaultStlStreamChunkTriangles = 1 << 19;
+
+// Float bounds of a set of vertices.
+struct VertexBounds {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// Transform a binary STL into another without loading or welding it, for
+// per-vertex transforms of meshes larger than memory. `transform` maps the
+// corners of a chunk of triangles in place, three per triangle, and must be a
+// pure function of each corner since it runs twice. Pass one streams the
+// input and only takes the bounds of the transformed corners. Pass two
+// streams it again, transforms, applies `finish` with the bounds from pass
+// one, recomputes normals and writes. Reading the next chunk and writing the
+// previous one overlap with the parallel transform of the current one.
+// Without `finish` there is only pass two. Returns the bounds of the written
+// vertices.
+VertexBounds StreamTransformStl(
+    const std::string &input_path,
+    const std::string &output_path,
+    const std::function<void(std::vector<glm::vec3> *corners)> &transform,
+    const std::function<void(const VertexBounds &bounds, std::vector<glm::vec3> *corners)> &finish,
+    uint64_t chunk_triangles = kDefaultStlStreamChunkTriangles);
 
+// Read a binary STL and weld identical vertices, appending to `points` and
+// `triangles`. Vertices are numbered in first-seen order, see WeldVertices.
+// Set `check_attribute_byte_count` to false to skip the per-record check that
+// the attribute byte count is zero.
 void ReadBinarySTL(
     const std::string &path,
     std::vector<glm::vec3> &points,
-    std::vector<glm::ivec3> &triangles);
+    std::vector<glm::ivec3> &triangles,
+    bool check_attribute_byte_count = true);
@@ -0,0 +1,18 @@
+#include <iostream>
+#include "src/meshtools/mesh_format.hpp"
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/stl.hpp"
+
+int main(int argc, char* argv[]) {
+  InitStats(&argc, argv);
+  if (argc != 3) {
+    std::cerr << "Need exactly 2 arguments, input.stl and output.mesh" << std::endl;
+    exit(1);
+  }
+  const std::string input_path = argv[1];
+  const std::string output_path = argv[2];
+  std::vector<glm::vec3> points;
+  std::vector<glm::ivec3> triangles;
+  ReadBinarySTL(input_path, points, triangles);
+  WriteMesh(output_path, points, triangles);
+}
@@ -0,0 +1,70 @@
+#include "terrain.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include "src/meshtools/stats.hpp"
+
+HeightmapGeoreference GdalInfo::Georeference(const double z_exag) const {
+  HeightmapGeoreference georeference;
+  georeference.lon0_deg = geo_transform[0].AsDouble();
+  georeference.dlon_deg_dpixel = geo_transform[1].AsDouble();
+  georeference.lat0_deg = geo_transform[3].AsDouble();
+  georeference.dlat_deg_dpixel = geo_transform[5].AsDouble();
+  georeference.n_lon = width;
+  georeference.n_lat = height;
+  georeference.min_height = computed_min.AsDouble();
+  georeference.max_height = computed_max.AsDouble();
+  georeference.z_exag = z_exag;
+  return georeference;
+}
+
+GdalInfo ReadGdalInfo(const std::string &path) {
+  const JsonValue json = ReadJsonFile(path);
+
+  const JsonValue &bands = json["bands"];
+  if (bands.size() != 1) {
+    fprintf(stderr, "Error: %s has %llu bands, expected 1.\n", path.c_str(), static_cast<unsigned long long>(bands.size()));
+    std::exit(1);
+  }
+
+  GdalInfo info;
+  const JsonValue &geo_transform = json["geoTransform"];
+  if (geo_transform.size() != 6) {
+    fprintf(stderr, "Error: %s geoTransform has %llu entries, expected 6.\n", path.c_str(), static_cast<unsigned long long>(geo_transform.size()));
+    std::exit(1);
+  }
+  info.geo_transform = geo_transform.array;
+
+  // The transforms assume north-up rasters.
+  if (info.geo_transform[2].AsDouble() != 0.0 || info.geo_transform[4].AsDouble() != 0.0) {
+    fprintf(stderr, "Error: %s geoTransform has rotation terms %s and %s, expected 0.\n", path.c_str(),
+            info.geo_transform[2].text.c_str(), info.geo_transform[4].text.c_str());
+    std::exit(1);
+  }
+
+  info.width = json["size"][0].AsInt();
+  info.height = json["size"][1].AsInt();
+  info.computed_min = bands[0]["computedMin"];
+  info.computed_max = bands[0]["computedMax"];
+  return info;
+}
+
+void PrintDimensions(const std::vector<glm::vec3> &vertices) {
+  VertexBounds bounds{vertices.at(0), vertices.at(0)};
+  for (const glm::vec3 &vertex : vertices) {
+    for (int k = 0; k < 3; k++) {
+      bounds.min[k] = fmin(bounds.min[k], vertex[k]);
+      bounds.max[k] = fmax(bounds.max[k], vertex[k]);
+    }
+  }
+  PrintDimensions(bounds);
+}
+
+void PrintDimensions(const VertexBounds &bounds) {
+  std::cout << "X size: " << (bounds.max.x - bounds.min.x) << std::endl;
+  std::cout << "Y size: " << (bounds.max.y - bounds.min.y) << std::endl;
+  std::cout << "Z size: " << (bounds.max.z - bounds.min.z) << std::endl;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/geodetic.hpp"
+#include "src/meshtools/json.hpp"
+#include "src/meshtools/stl.hpp"
+
+// The parts of `gdalinfo -json -mm` output the terrain pipeline uses.
+// Numbers are kept as JSON values so errors can quote their original text.
+struct GdalInfo {
+  std::vector<JsonValue> geo_transform;
+  int32_t width = 0;
+  int32_t height = 0;
+  JsonValue computed_min;
+  JsonValue computed_max;
+
+  HeightmapGeoreference Georeference(double z_exag) const;
+};
+
+// Read gdalinfo JSON, checking that there is exactly one band and that the
+// geoTransform has no rotation terms. Exits otherwise.
+GdalInfo ReadGdalInfo(const std::string &path);
+
+// Print X/Y/Z extents of a mesh to stdout, as print_stl_dimensions does.
+// Requires at least one vertex.
+void PrintDimensions(const std::vector<glm::vec3> &vertices);
+void PrintDimensions(const VertexBounds &bounds);
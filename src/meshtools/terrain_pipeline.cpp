@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cassert>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/geodetic.hpp"
+#include "src/meshtools/mesh_io.hpp"
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/stl.hpp"
+#include "src/meshtools/terrain.hpp"
+
+// Everything after triangulation in one process: load the unscaled hmm mesh
+// once, apply the output scaling from the gdalinfo JSON in memory, and write
+// the final STL. Every output scaling goes through the same projection engine,
+// so this is the one binary for all of them. The center defaults to the raster
+// center and is ignored by llh2gnomonic and ned.
+//
+// With --streaming the input STL is never loaded or welded: it is streamed
+// twice, once for the bounds of the projected mesh and once to project, scale
+// and write, so meshes larger than memory work. For hmm output the result is
+// the same STL.
+int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  const MeshFormat format = ParseFormatFlag(&argc, argv);
+  const bool streaming = ParseStreamingFlag(&argc, argv);
+  // Parse flags.
+  if (argc != 7 && argc != 9) {
+    fprintf(stderr, "Usage: ./terrain_pipeline input.stl gdalinfo.json output.stl "
+                    "(llh2ecef|llh2gnomonic|ned|polar_stereographic|transverse_mercator) target_size z_exag "
+                    "[center_lat_deg center_lon_deg] [--format=stl|ply|mesh|3mf] [--streaming]\n");
+    std::exit(1);
+  }
+  const std::string input_path = argv[1];
+  const std::string gdalinfo_path = argv[2];
+  const std::string output_path = argv[3];
+  const OutputScaling output_scaling = ParseOutputScaling(argv[4]);
+  const double target_size = std::stod(argv[5]);
+  const double z_exag = std::stod(argv[6]);
+  assert(input_path.size() != 0);
+  assert(output_path.size() != 0);
+  if (argc == 9 && (output_scaling == OutputScaling::kGnomonic || output_scaling == OutputScaling::kNed)) {
+    fprintf(stderr, "A center lat/lon is not supported for %s.\n", OutputScalingName(output_scaling));
+    std::exit(1);
+  }
+
+  const GdalInfo info = ReadGdalInfo(gdalinfo_path);
+  const HeightmapGeoreference georeference = info.Georeference(z_exag);
+  double center_lat_deg = georeference.CenterLatDeg();
+  double center_lon_deg = georeference.CenterLonDeg();
+  if (argc == 9) {
+    center_lat_deg = std::stod(argv[7]);
+    center_lon_deg = std::stod(argv[8]);
+  }
+
+  if (streaming) {
+    CheckStreamingPaths(input_path, output_path, format);
+    const HeightmapProjection projection(output_scaling, georeference, center_lat_deg, center_lon_deg);
+    const VertexBounds written = StreamTransformStl(
+        input_path, output_path, [&](std::vector<glm::vec3> *corners) { projection.Apply(corners); },
+        [&](const VertexBounds &bounds, std::vector<glm::vec3> *corners) {
+          ScaleToTargetSize(output_scaling, Bounds{glm::dvec3(bounds.min), glm::dvec3(bounds.max)}, target_size,
+                            corners);
+        });
+    if (!(written.min.x <= written.max.x)) {
+      std::cerr << "No vertices in this mesh." << std::endl;
+      std::exit(1);
+    }
+    std::cout << OutputScalingName(output_scaling) << " dimensions:" << std::endl;
+    PrintDimensions(written);
+    fprintf(stderr, "streamed mesh to %s\n", output_path.c_str());
+    return 0;
+  }
+
+  // Load the input mesh.
+  std::vector<glm::vec3> points;
+  std::vector<glm::ivec3> triangles;
+  ReadMeshFile(input_path, points, triangles);
+  std::cerr << "Loaded " << points.size() << " vertices and " << triangles.size() << " triangles from file." << std::endl;
+  if (points.size() == 0) {
+    std::cerr << "No vertices in this mesh." << std::endl;
+    std::exit(1);
+  }
+  std::cout << "unscaled dimensions:" << std::endl;
+  PrintDimensions(points);
+
+  const Bounds bounds = ProjectHeightmap(output_scaling, georeference, center_lat_deg, center_lon_deg, &points);
+  ScaleToTargetSize(output_scaling, bounds, target_size, &points);
+
+  std::cout << OutputScalingName(output_scaling) << " dimensions:" << std::endl;
+  PrintDimensions(points);
+
+  WriteMeshFile(output_path, points, triangles, format);
+  fprintf(stderr, "wrote mesh to %s\n", output_path.c_str());
+}
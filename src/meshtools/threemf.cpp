@@ -0,0 +1,429 @@
+#include "threemf.hpp"
+
+#define ZLIB_CONST
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "src/meshtools/mapped_file.hpp"
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+
+namespace {
+
+// Vertices or triangles per piece of model XML, about 1.5 MB of text.
+constexpr uint64_t kPieceItems = 1 << 15;
+// Longest XML line for a vertex or triangle: the tags plus three floats of at
+// most 15 characters, or three non-negative int32 of at most 10, which
+// CheckVertexIndices guarantees.
+constexpr uint64_t kMaxVertexBytes = 25 + 3 * 15;
+constexpr uint64_t kMaxTriangleBytes = 30 + 3 * 10;
+constexpr int32_t kCompressionLevel = 6;
+constexpr uint64_t kDictionaryBytes = 32 << 10;
+// 1980-01-01 00:00 in MS-DOS format, so builds are reproducible.
+constexpr uint16_t kDosDate = (1 << 5) | 1;
+constexpr uint32_t kZip32Max = 0xffffffff;
+
+constexpr char kContentTypes[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+    "<Default Extension=\"rels\" ContentType=\"application/vnd.openxmlformats-package.relationships+xml\"/>"
+    "<Default Extension=\"model\" ContentType=\"application/vnd.ms-package.3dmanufacturing-3dmodel+xml\"/>"
+    "</Types>\n";
+constexpr char kRelationships[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+    "<Relationship Target=\"/3D/3dmodel.model\" Id=\"rel0\" "
+    "Type=\"http://schemas.microsoft.com/3dmanufacturing/2013/01/3dmodel\"/>"
+    "</Relationships>\n";
+constexpr char kModelHeader[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<model unit=\"millimeter\" xml:lang=\"en-US\" "
+    "xmlns=\"http://schemas.microsoft.com/3dmanufacturing/core/2015/02\">\n"
+    "<resources>\n<object id=\"1\" type=\"model\">\n<mesh>\n<vertices>\n";
+constexpr char kModelMiddle[] = "</vertices>\n<triangles>\n";
+constexpr char kModelFooter[] =
+    "</triangles>\n</mesh>\n</object>\n</resources>\n<build>\n<item objectid=\"1\"/>\n</build>\n</model>\n";
+
+// A run of model XML: literal text, or the lines of items [begin, end).
+struct Piece {
+  enum class Kind { kText, kVertices, kTriangles };
+  Kind kind = Kind::kText;
+  const char *text = nullptr;
+  uint64_t begin = 0;
+  uint64_t end = 0;
+};
+
+char *AppendFloat(char *out, const float value) {
+  return std::to_chars(out, out + 16, value).ptr;
+}
+
+char *AppendIndex(char *out, const int32_t value) {
+  return std::to_chars(out, out + 11, value).ptr;
+}
+
+// Exit if any triangle refers to a vertex the mesh does not have, before any
+// of its indices are formatted.
+void CheckVertexIndices(const std::string &path,
+                        const std::vector<glm::ivec3> &triangles,
+                        const uint64_t num_vertices) {
+  const uint32_t num_chunks = NumThreads();
+  std::vector<uint64_t> first_bad(num_chunks, triangles.size());
+  ParallelForChunks(triangles.size(), num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    for (uint64_t t = begin; t < end; t++) {
+      bool ok = true;
+      for (int k = 0; k < 3; k++) {
+        ok &= triangles[t][k] >= 0 && static_cast<uint64_t>(triangles[t][k]) < num_vertices;
+      }
+      if (!ok) {
+        first_bad[chunk] = t;
+        return;
+      }
+    }
+  });
+  const uint64_t bad = *std::min_element(first_bad.begin(), first_bad.end());
+  if (bad < triangles.size()) {
+    fprintf(stderr, "Error writing %s: triangle %llu has vertex indices %d %d %d, but there are %llu vertices\n",
+            path.c_str(), static_cast<unsigned long long>(bad), triangles[bad].x, triangles[bad].y,
+            triangles[bad].z, static_cast<unsigned long long>(num_vertices));
+    std::exit(1);
+  }
+}
+
+template <uint64_t N>
+char *AppendLiteral(char *out, const char (&text)[N]) {
+  memcpy(out, text, N - 1);
+  return out + N - 1;
+}
+
+void FormatPiece(const Piece &piece,
+                 const std::vector<glm::vec3> &points,
+                 const std::vector<glm::ivec3> &triangles,
+                 std::string *text) {
+  switch (piece.kind) {
+    case Piece::Kind::kText:
+      text->assign(piece.text);
+      return;
+    case Piece::Kind::kVertices: {
+      text->resize((piece.end - piece.begin) * kMaxVertexBytes);
+      char *out = &(*text)[0];
+      for (uint64_t i = piece.begin; i < piece.end; i++) {
+        const glm::vec3 &point = points[i];
+        out = AppendLiteral(out, "<vertex x=\"");
+        out = AppendFloat(out, point.x);
+        out = AppendLiteral(out, "\" y=\"");
+        out = AppendFloat(out, point.y);
+        out = AppendLiteral(out, "\" z=\"");
+        out = AppendFloat(out, point.z);
+        out = AppendLiteral(out, "\"/>\n");
+      }
+      text->resize(static_cast<uint64_t>(out - text->data()));
+      return;
+    }
+    case Piece::Kind::kTriangles: {
+      text->resize((piece.end - piece.begin) * kMaxTriangleBytes);
+      char *out = &(*text)[0];
+      for (uint64_t i = piece.begin; i < piece.end; i++) {
+        const glm::ivec3 &triangle = triangles[i];
+        out = AppendLiteral(out, "<triangle v1=\"");
+        out = AppendIndex(out, triangle.x);
+        out = AppendLiteral(out, "\" v2=\"");
+        out = AppendIndex(out, triangle.y);
+        out = AppendLiteral(out, "\" v3=\"");
+        out = AppendIndex(out, triangle.z);
+        out = AppendLiteral(out, "\"/>\n");
+      }
+      text->resize(static_cast<uint64_t>(out - text->data()));
+      return;
+    }
+    default:
+      return;
+  }
+}
+
+// Deflate `text` as a non-final, byte aligned run of blocks, primed with the
+// tail of the text before it.
+void DeflatePiece(z_stream *stream, const std::string &dictionary, const std::string &text,
+                  std::vector<uint8_t> *out) {
+  if (deflateReset(stream) != Z_OK ||
+      deflateSetDictionary(stream, reinterpret_cast<const Bytef *>(dictionary.data()),
+                           static_cast<uInt>(dictionary.size())) != Z_OK) {
+    fprintf(stderr, "Error resetting the 3MF deflate stream.\n");
+    std::exit(1);
+  }
+  out->resize(deflateBound(stream, text.size()) + 16);
+  stream->next_in = reinterpret_cast<const Bytef *>(text.data());
+  stream->avail_in = static_cast<uInt>(text.size());
+  uint64_t used = 0;
+  while (true) {
+    stream->next_out = out->data() + used;
+    stream->avail_out = static_cast<uInt>(out->size() - used);
+    if (deflate(stream, Z_SYNC_FLUSH) != Z_OK) {
+      fprintf(stderr, "Error deflating 3MF model.\n");
+      std::exit(1);
+    }
+    used = out->size() - stream->avail_out;
+    // A full output buffer means the flush may not be complete.
+    if (stream->avail_out != 0) {
+      break;
+    }
+    out->resize(2 * out->size());
+  }
+  out->resize(used);
+}
+
+std::string Tail(const std::string &text) {
+  return text.substr(text.size() - std::min<uint64_t>(text.size(), kDictionaryBytes));
+}
+
+void Put16(std::vector<uint8_t> *out, const uint16_t value) {
+  out->push_back(static_cast<uint8_t>(value));
+  out->push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void Put32(std::vector<uint8_t> *out, const uint32_t value) {
+  Put16(out, static_cast<uint16_t>(value));
+  Put16(out, static_cast<uint16_t>(value >> 16));
+}
+
+void Put64(std::vector<uint8_t> *out, const uint64_t value) {
+  Put32(out, static_cast<uint32_t>(value));
+  Put32(out, static_cast<uint32_t>(value >> 32));
+}
+
+struct ZipEntry {
+  std::string name;
+  uint16_t method = 0;
+  uint32_t crc = 0;
+  uint64_t compressed_size = 0;
+  uint64_t uncompressed_size = 0;
+  uint64_t offset = 0;
+  // Sizes live in a zip64 extra field. Offsets always fit in 32 bits, since
+  // the model is the last entry.
+  bool zip64 = false;
+};
+
+// The local header or central directory record of an entry.
+std::vector<uint8_t> ZipHeader(const ZipEntry &entry, const bool central) {
+  std::vector<uint8_t> header;
+  const uint16_t version = entry.zip64 ? 45 : 20;
+  Put32(&header, central ? 0x02014b50 : 0x04034b50);
+  if (central) {
+    Put16(&header, version);
+  }
+  Put16(&header, version);
+  Put16(&header, 0);  // flags
+  Put16(&header, entry.method);
+  Put16(&header, 0);  // time
+  Put16(&header, kDosDate);
+  Put32(&header, entry.crc);
+  Put32(&header, entry.zip64 ? kZip32Max : static_cast<uint32_t>(entry.compressed_size));
+  Put32(&header, entry.zip64 ? kZip32Max : static_cast<uint32_t>(entry.uncompressed_size));
+  Put16(&header, static_cast<uint16_t>(entry.name.size()));
+  Put16(&header, entry.zip64 ? 20 : 0);  // extra field length
+  if (central) {
+    Put16(&header, 0);  // comment length
+    Put16(&header, 0);  // disk number
+    Put16(&header, 0);  // internal attributes
+    Put32(&header, 0);  // external attributes
+    Put32(&header, static_cast<uint32_t>(entry.offset));
+  }
+  header.insert(header.end(), entry.name.begin(), entry.name.end());
+  if (entry.zip64) {
+    Put16(&header, 0x0001);
+    Put16(&header, 16);
+    Put64(&header, entry.uncompressed_size);
+    Put64(&header, entry.compressed_size);
+  }
+  return header;
+}
+
+struct ZipOutput {
+  std::string path;
+  int fd = -1;
+  uint64_t offset = 0;
+
+  void Write(const uint8_t *data, const uint64_t size) {
+    offset += size;
+    WriteAll(fd, data, size, path);
+  }
+
+  void Write(const std::vector<uint8_t> &data) { Write(data.data(), data.size()); }
+
+  void WriteAt(const std::vector<uint8_t> &data, const uint64_t at) {
+    if (pwrite(fd, data.data(), data.size(), static_cast<off_t>(at)) != static_cast<ssize_t>(data.size())) {
+      fprintf(stderr, "Error writing %s: %s\n", path.c_str(), strerror(errno));
+      std::exit(1);
+    }
+  }
+
+  ZipEntry WriteStored(const std::string &name, const char *text) {
+    ZipEntry entry;
+    entry.name = name;
+    entry.uncompressed_size = strlen(text);
+    entry.compressed_size = entry.uncompressed_size;
+    entry.crc = static_cast<uint32_t>(
+        crc32(0, reinterpret_cast<const Bytef *>(text), static_cast<uInt>(entry.uncompressed_size)));
+    entry.offset = offset;
+    Write(ZipHeader(entry, false));
+    Write(reinterpret_cast<const uint8_t *>(text), entry.uncompressed_size);
+    return entry;
+  }
+};
+
+}  // namespace
+
+void WriteThreeMf(const std::string &path,
+                  const std::vector<glm::vec3> &points,
+                  const std::vector<glm::ivec3> &triangles,
+                  const uint64_t max_buffer_bytes) {
+  const ScopedStage stage("write_3mf");
+  CheckVertexIndices(path, triangles, points.size());
+  std::vector<Piece> pieces;
+  pieces.push_back({Piece::Kind::kText, kModelHeader, 0, 0});
+  for (uint64_t begin = 0; begin < points.size(); begin += kPieceItems) {
+    pieces.push_back({Piece::Kind::kVertices, nullptr, begin, std::min<uint64_t>(begin + kPieceItems, points.size())});
+  }
+  pieces.push_back({Piece::Kind::kText, kModelMiddle, 0, 0});
+  for (uint64_t begin = 0; begin < triangles.size(); begin += kPieceItems) {
+    pieces.push_back(
+        {Piece::Kind::kTriangles, nullptr, begin, std::min<uint64_t>(begin + kPieceItems, triangles.size())});
+  }
+  pieces.push_back({Piece::Kind::kText, kModelFooter, 0, 0});
+
+  // Half the budget holds the batch being encoded, half the one being written.
+  const uint64_t batch_pieces = std::max<uint64_t>(1, max_buffer_bytes / 2 / (kPieceItems * kMaxVertexBytes));
+  const uint64_t max_text_bytes = points.size() * kMaxVertexBytes + triangles.size() * kMaxTriangleBytes + 4096;
+
+  ZipOutput output;
+  output.path = path;
+  output.fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (output.fd < 0) {
+    fprintf(stderr, "Error opening %s for writing: %s\n", path.c_str(), strerror(errno));
+    std::exit(1);
+  }
+  std::vector<ZipEntry> entries;
+  entries.push_back(output.WriteStored("[Content_Types].xml", kContentTypes));
+  entries.push_back(output.WriteStored("_rels/.rels", kRelationships));
+
+  // The model header is rewritten with the CRC and sizes at the end.
+  ZipEntry model;
+  model.name = "3D/3dmodel.model";
+  model.method = Z_DEFLATED;
+  // Deflate adds at most a few bytes per 16 KB and per piece.
+  model.zip64 = max_text_bytes + max_text_bytes / 256 + 64 * pieces.size() >= kZip32Max;
+  model.offset = output.offset;
+  output.Write(ZipHeader(model, false));
+
+  std::vector<z_stream> streams(std::min<uint64_t>(batch_pieces, pieces.size()));
+  for (z_stream &stream : streams) {
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, kCompressionLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      fprintf(stderr, "Error initializing deflate.\n");
+      std::exit(1);
+    }
+  }
+  std::vector<std::string> texts(streams.size());
+  std::vector<uint32_t> crcs(streams.size());
+  std::vector<std::vector<uint8_t>> compressed[2];
+  std::string dictionary;
+  std::thread writer;
+  uint64_t data_start = output.offset;
+  for (uint64_t begin = 0, batch = 0; begin < pieces.size(); begin += batch_pieces, batch++) {
+    const uint64_t count = std::min<uint64_t>(batch_pieces, pieces.size() - begin);
+    std::vector<std::vector<uint8_t>> &out = compressed[batch % 2];
+    out.resize(count);
+    ParallelFor(count, 1, [&](const uint64_t chunk_begin, const uint64_t chunk_end, uint32_t) {
+      for (uint64_t k = chunk_begin; k < chunk_end; k++) {
+        FormatPiece(pieces[begin + k], points, triangles, &texts[k]);
+      }
+    });
+    ParallelFor(count, 1, [&](const uint64_t chunk_begin, const uint64_t chunk_end, uint32_t) {
+      for (uint64_t k = chunk_begin; k < chunk_end; k++) {
+        DeflatePiece(&streams[k], k == 0 ? dictionary : Tail(texts[k - 1]), texts[k], &out[k]);
+        crcs[k] = static_cast<uint32_t>(
+            crc32(0, reinterpret_cast<const Bytef *>(texts[k].data()), static_cast<uInt>(texts[k].size())));
+      }
+    });
+    for (uint64_t k = 0; k < count; k++) {
+      model.crc = static_cast<uint32_t>(
+          crc32_combine(model.crc, crcs[k], static_cast<z_off_t>(texts[k].size())));
+      model.uncompressed_size += texts[k].size();
+    }
+    dictionary = Tail(texts[count - 1]);
+
+    if (writer.joinable()) {
+      writer.join();
+    }
+    writer = std::thread([&output, &out] {
+      for (const std::vector<uint8_t> &piece : out) {
+        output.Write(piece);
+      }
+    });
+  }
+  if (writer.joinable()) {
+    writer.join();
+  }
+  for (z_stream &stream : streams) {
+    deflateEnd(&stream);
+  }
+  // An empty final block ends the deflate stream.
+  const uint8_t final_block[2] = {0x03, 0x00};
+  output.Write(final_block, sizeof(final_block));
+  model.compressed_size = output.offset - data_start;
+  if (!model.zip64 && (model.compressed_size >= kZip32Max || model.uncompressed_size >= kZip32Max)) {
+    fprintf(stderr, "Error: 3MF model outgrew its size estimate.\n");
+    std::exit(1);
+  }
+  output.WriteAt(ZipHeader(model, false), model.offset);
+  entries.push_back(model);
+
+  // Central directory.
+  const uint64_t directory_offset = output.offset;
+  for (const ZipEntry &entry : entries) {
+    output.Write(ZipHeader(entry, true));
+  }
+  const uint64_t directory_size = output.offset - directory_offset;
+  std::vector<uint8_t> end;
+  if (model.zip64) {
+    const uint64_t zip64_end_offset = output.offset;
+    Put32(&end, 0x06064b50);
+    Put64(&end, 44);  // size of the rest of this record
+    Put16(&end, 45);
+    Put16(&end, 45);
+    Put32(&end, 0);  // this disk
+    Put32(&end, 0);  // directory disk
+    Put64(&end, entries.size());
+    Put64(&end, entries.size());
+    Put64(&end, directory_size);
+    Put64(&end, directory_offset);
+    Put32(&end, 0x07064b50);
+    Put32(&end, 0);  // disk with the zip64 end record
+    Put64(&end, zip64_end_offset);
+    Put32(&end, 1);  // number of disks
+  }
+  Put32(&end, 0x06054b50);
+  Put16(&end, 0);  // this disk
+  Put16(&end, 0);  // directory disk
+  Put16(&end, static_cast<uint16_t>(entries.size()));
+  Put16(&end, static_cast<uint16_t>(entries.size()));
+  Put32(&end, static_cast<uint32_t>(directory_size));
+  Put32(&end, model.zip64 ? kZip32Max : static_cast<uint32_t>(directory_offset));
+  Put16(&end, 0);  // comment length
+  output.Write(end);
+
+  if (close(output.fd) != 0) {
+    fprintf(stderr, "Error closing %s: %s\n", path.c_str(), strerror(errno));
+    std::exit(1);
+  }
+  StatsAdd("threemf_xml_bytes", model.uncompressed_size);
+  StatsAdd("threemf_bytes_written", output.offset);
+}
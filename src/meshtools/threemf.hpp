@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Default cap on the extra memory WriteThreeMf uses for XML and deflate
+// buffers, not counting a fixed amount of deflate state per thread.
+constexpr uint64_t kDefaultThreeMfBufferBytes = 64 << 20;
+
+// Write a 3MF package: one mesh object with indexed vertices and triangles,
+// in millimeters, built once. The model XML is generated in fixed size pieces
+// that are formatted and deflated in parallel, a batch of at most
+// max_buffer_bytes / 2 at a time, and streamed into the zip container while
+// the next batch is encoded, so memory use does not grow with the mesh.
+//
+// Each piece is an independent raw deflate stream ended with Z_SYNC_FLUSH and
+// primed with the last 32 KB of the previous piece, so the pieces concatenate
+// into one deflate stream that compresses almost as well as a serial one.
+// Piece CRCs are merged with crc32_combine. Zip64 records are written when
+// the model could reach 4 GB. Output only depends on the mesh. Exits if a
+// triangle refers to a vertex outside points.
+void WriteThreeMf(const std::string &path,
+                  const std::vector<glm::vec3> &points,
+                  const std::vector<glm::ivec3> &triangles,
+                  uint64_t max_buffer_bytes = kDefaultThreeMfBufferBytes);
@@ -0,0 +1,22 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/terrain.hpp"
+#include "src/meshtools/tiles.hpp"
+
+// Print the gdal_translate -srcwin arguments "x0 y0 width height" of one tile
+// of a raster, for the tiled meshing genrules.
+// Usage: ./tile_window gdalinfo.json tiles_x tiles_y i j
+int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  if (argc != 6) {
+    fprintf(stderr, "Usage: ./tile_window gdalinfo.json tiles_x tiles_y i j\n");
+    std::exit(1);
+  }
+  const GdalInfo info = ReadGdalInfo(argv[1]);
+  const TileWindow window = ComputeTileWindow(info.width, info.height, std::stoi(argv[2]), std::stoi(argv[3]),
+                                              std::stoi(argv[4]), std::stoi(argv[5]));
+  printf("%d %d %d %d\n", window.x0, window.y0, window.width, window.height);
+}
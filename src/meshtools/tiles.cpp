@@ -0,0 +1,245 @@
+#include "tiles.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+#include "src/meshtools/mesh_io.hpp"
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/weld.hpp"
+
+namespace {
+
+struct SeamSample {
+  float along;
+  float z;
+  bool operator<(const SeamSample &other) const { return along < other.along; }
+};
+
+// Vertical seams at x = xs[k] and horizontal seams at y = ys[k], each with the
+// samples any tile has on it, sorted along the seam.
+struct Seams {
+  std::vector<float> xs;
+  std::vector<float> ys;
+  std::vector<std::vector<SeamSample>> on_x;
+  std::vector<std::vector<SeamSample>> on_y;
+
+  void Add(const glm::vec3 &point) {
+    const auto x = std::lower_bound(xs.begin(), xs.end(), point.x);
+    if (x != xs.end() && *x == point.x) {
+      on_x[static_cast<uint64_t>(x - xs.begin())].push_back({point.y, point.z});
+    }
+    const auto y = std::lower_bound(ys.begin(), ys.end(), point.y);
+    if (y != ys.end() && *y == point.y) {
+      on_y[static_cast<uint64_t>(y - ys.begin())].push_back({point.x, point.z});
+    }
+  }
+
+  void Sort() {
+    for (std::vector<std::vector<SeamSample>> *samples : {&on_x, &on_y}) {
+      for (std::vector<SeamSample> &line : *samples) {
+        std::stable_sort(line.begin(), line.end());
+        line.erase(std::unique(line.begin(), line.end(),
+                               [](const SeamSample &a, const SeamSample &b) { return a.along == b.along; }),
+                   line.end());
+      }
+    }
+  }
+
+  // Seam samples strictly between p and q, in order from p to q, if the edge
+  // p-q lies along a seam.
+  void Between(const glm::vec3 &p, const glm::vec3 &q, std::vector<glm::vec3> *out) const {
+    out->clear();
+    const bool vertical = p.x == q.x;
+    const bool horizontal = p.y == q.y;
+    if (vertical == horizontal) {
+      return;
+    }
+    const float across = vertical ? p.x : p.y;
+    const std::vector<float> &lines = vertical ? xs : ys;
+    const auto line = std::lower_bound(lines.begin(), lines.end(), across);
+    if (line == lines.end() || *line != across) {
+      return;
+    }
+    const std::vector<SeamSample> &samples = (vertical ? on_x : on_y)[static_cast<uint64_t>(line - lines.begin())];
+    const float from = vertical ? p.y : p.x;
+    const float to = vertical ? q.y : q.x;
+    const auto begin = std::upper_bound(samples.begin(), samples.end(), SeamSample{std::min(from, to), 0});
+    const auto end = std::lower_bound(samples.begin(), samples.end(), SeamSample{std::max(from, to), 0});
+    for (auto sample = begin; sample < end; sample++) {
+      out->push_back(vertical ? glm::vec3(across, sample->along, sample->z)
+                              : glm::vec3(sample->along, across, sample->z));
+    }
+    if (from > to) {
+      std::reverse(out->begin(), out->end());
+    }
+  }
+};
+
+// Append triangle (a, b, c) as corners, fanning it from the opposite corner
+// wherever one of its edges runs along a seam past other tiles' samples.
+void SplitAlongSeams(const Seams &seams, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c,
+                     std::vector<glm::vec3> *corners) {
+  const glm::vec3 triangle[3] = {a, b, c};
+  std::vector<glm::vec3> between;
+  for (int e = 0; e < 3; e++) {
+    const glm::vec3 &p = triangle[e];
+    const glm::vec3 &q = triangle[(e + 1) % 3];
+    const glm::vec3 &opposite = triangle[(e + 2) % 3];
+    seams.Between(p, q, &between);
+    if (between.empty()) {
+      continue;
+    }
+    // The fan keeps the winding of (p, q, opposite). Its first and last
+    // triangles hold the other two original edges, which may need splits too.
+    glm::vec3 previous = p;
+    for (const glm::vec3 &sample : between) {
+      SplitAlongSeams(seams, previous, sample, opposite, corners);
+      previous = sample;
+    }
+    SplitAlongSeams(seams, previous, q, opposite, corners);
+    return;
+  }
+  corners->insert(corners->end(), {a, b, c});
+}
+
+}  // namespace
+
+TileWindow ComputeTileWindow(const int32_t width, const int32_t height, const int32_t tiles_x, const int32_t tiles_y,
+                             const int32_t i, const int32_t j) {
+  if (tiles_x < 1 || tiles_y < 1 || (width - 1) / tiles_x < 1 || (height - 1) / tiles_y < 1) {
+    fprintf(stderr, "Error: cannot split a %dx%d raster into %dx%d tiles.\n", width, height, tiles_x, tiles_y);
+    std::exit(1);
+  }
+  if (i < 0 || i >= tiles_x || j < 0 || j >= tiles_y) {
+    fprintf(stderr, "Error: tile (%d, %d) is outside a %dx%d split.\n", i, j, tiles_x, tiles_y);
+    std::exit(1);
+  }
+  // Tiles share their last column/row with the next tile.
+  const int64_t last_x = width - 1;
+  const int64_t last_y = height - 1;
+  TileWindow window;
+  window.x0 = static_cast<int32_t>(last_x * i / tiles_x);
+  window.y0 = static_cast<int32_t>(last_y * j / tiles_y);
+  window.width = static_cast<int32_t>(last_x * (i + 1) / tiles_x) - window.x0 + 1;
+  window.height = static_cast<int32_t>(last_y * (j + 1) / tiles_y) - window.y0 + 1;
+  return window;
+}
+
+void StitchTiles(const std::vector<std::string> &tile_paths,
+                 const int32_t width,
+                 const int32_t height,
+                 const int32_t tiles_x,
+                 const int32_t tiles_y,
+                 std::vector<glm::vec3> *points,
+                 std::vector<glm::ivec3> *triangles) {
+  const ScopedStage stage("stitch_tiles");
+  const uint64_t num_tiles = static_cast<uint64_t>(tiles_x) * static_cast<uint64_t>(tiles_y);
+  if (tile_paths.size() != num_tiles) {
+    fprintf(stderr, "Error: expected %llu tiles, got %llu.\n", static_cast<unsigned long long>(num_tiles),
+            static_cast<unsigned long long>(tile_paths.size()));
+    std::exit(1);
+  }
+
+  // Read every tile and move it to raster coordinates. hmm's y counts up from
+  // the bottom of its image, so a tile is offset by the rows below it.
+  std::vector<std::vector<glm::vec3>> tile_points(num_tiles);
+  std::vector<std::vector<glm::ivec3>> tile_triangles(num_tiles);
+  std::vector<glm::vec3> bounds_min(num_tiles, glm::vec3(std::numeric_limits<float>::infinity()));
+  std::vector<glm::vec3> bounds_max(num_tiles, glm::vec3(-std::numeric_limits<float>::infinity()));
+  for (int32_t j = 0; j < tiles_y; j++) {
+    for (int32_t i = 0; i < tiles_x; i++) {
+      const uint64_t tile = static_cast<uint64_t>(j * tiles_x + i);
+      ReadMeshFile(tile_paths[tile], tile_points[tile], tile_triangles[tile]);
+      if (tile_triangles[tile].empty()) {
+        fprintf(stderr, "Error: tile %s has no triangles.\n", tile_paths[tile].c_str());
+        std::exit(1);
+      }
+      const TileWindow window = ComputeTileWindow(width, height, tiles_x, tiles_y, i, j);
+      const glm::vec3 offset(static_cast<float>(window.x0), static_cast<float>(height - (window.y0 + window.height)),
+                             0.0f);
+      for (glm::vec3 &point : tile_points[tile]) {
+        point += offset;
+        bounds_min[tile] = glm::min(bounds_min[tile], point);
+        bounds_max[tile] = glm::max(bounds_max[tile], point);
+      }
+    }
+  }
+
+  // Seams are where neighbouring tiles' extents meet. hmm always keeps the
+  // corners of its image, so the extents are exact.
+  // Seam i - 1 is left of tile column i, seam j - 1 is above tile row j.
+  std::vector<float> seam_x;
+  std::vector<float> seam_y;
+  for (int32_t i = 1; i < tiles_x; i++) {
+    seam_x.push_back(bounds_min[static_cast<uint64_t>(i)].x);
+  }
+  for (int32_t j = 1; j < tiles_y; j++) {
+    seam_y.push_back(bounds_max[static_cast<uint64_t>(j * tiles_x)].y);
+  }
+  for (int32_t j = 0; j < tiles_y; j++) {
+    for (int32_t i = 0; i < tiles_x; i++) {
+      const uint64_t tile = static_cast<uint64_t>(j * tiles_x + i);
+      const bool x_ok = i == 0 || (bounds_min[tile].x == seam_x[static_cast<uint64_t>(i - 1)] &&
+                                   bounds_max[tile - 1].x == seam_x[static_cast<uint64_t>(i - 1)]);
+      const bool y_ok = j == 0 || (bounds_max[tile].y == seam_y[static_cast<uint64_t>(j - 1)] &&
+                                   bounds_min[tile - static_cast<uint64_t>(tiles_x)].y ==
+                                       seam_y[static_cast<uint64_t>(j - 1)]);
+      if (!x_ok || !y_ok) {
+        fprintf(stderr, "Error: tile %s does not line up with its neighbours.\n", tile_paths[tile].c_str());
+        std::exit(1);
+      }
+    }
+  }
+  Seams seams;
+  seams.xs = seam_x;
+  seams.ys = seam_y;
+  std::sort(seams.xs.begin(), seams.xs.end());
+  std::sort(seams.ys.begin(), seams.ys.end());
+  seams.on_x.resize(seams.xs.size());
+  seams.on_y.resize(seams.ys.size());
+  for (const std::vector<glm::vec3> &tile : tile_points) {
+    for (const glm::vec3 &point : tile) {
+      seams.Add(point);
+    }
+  }
+  seams.Sort();
+
+  // Split seam edges, then weld everything at once.
+  std::vector<std::vector<glm::vec3>> tile_corners(num_tiles);
+  ParallelForChunks(num_tiles, static_cast<uint32_t>(std::min<uint64_t>(num_tiles, NumThreads())),
+                    [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t tile = begin; tile < end; tile++) {
+      const std::vector<glm::vec3> &tile_point = tile_points[tile];
+      tile_corners[tile].reserve(3 * tile_triangles[tile].size());
+      for (const glm::ivec3 &triangle : tile_triangles[tile]) {
+        SplitAlongSeams(seams, tile_point[static_cast<uint64_t>(triangle[0])],
+                        tile_point[static_cast<uint64_t>(triangle[1])],
+                        tile_point[static_cast<uint64_t>(triangle[2])], &tile_corners[tile]);
+      }
+      std::vector<glm::vec3>().swap(tile_points[tile]);
+      std::vector<glm::ivec3>().swap(tile_triangles[tile]);
+    }
+  });
+
+  std::vector<glm::vec3> corners;
+  uint64_t num_corners = 0;
+  for (const std::vector<glm::vec3> &tile : tile_corners) {
+    num_corners += tile.size();
+  }
+  corners.reserve(num_corners);
+  for (std::vector<glm::vec3> &tile : tile_corners) {
+    corners.insert(corners.end(), tile.begin(), tile.end());
+    std::vector<glm::vec3>().swap(tile);
+  }
+
+  CornerView view;
+  view.base = reinterpret_cast<const uint8_t *>(corners.data());
+  view.num_triangles = corners.size() / 3;
+  points->clear();
+  triangles->clear();
+  WeldVertices(view, WeldMethod::kGrid, points, triangles);
+  StatsAdd("stitched_tiles", num_tiles);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Tiled meshing of rasters too large for one hmm process. The raster is cut
+// into tiles that overlap by one pixel, so neighbouring tiles share the samples
+// on their common edge. Each tile is triangulated on its own and the tiles are
+// stitched back into one unscaled hmm mesh in raster pixel coordinates.
+
+// A gdal_translate -srcwin window, in pixels.
+struct TileWindow {
+  int32_t x0 = 0;
+  int32_t y0 = 0;
+  int32_t width = 0;
+  int32_t height = 0;
+};
+
+// Window of tile (i, j) of a tiles_x by tiles_y split of a width by height
+// raster. i counts from the left and j from the top. Exits if the tiles
+// would be less than two pixels wide.
+TileWindow ComputeTileWindow(int32_t width, int32_t height, int32_t tiles_x, int32_t tiles_y, int32_t i, int32_t j);
+
+// Read hmm meshes of the tiles, given row by row from the top left, and
+// stitch them into one mesh of the whole raster, replacing `points` and
+// `triangles`.
+//
+// Tiles are moved into raster coordinates using hmm's convention that y grows
+// upwards from the bottom edge. Every tile edge along a seam is split at the
+// boundary vertices the neighbouring tiles have on that seam, so all tiles
+// share exactly the same seam vertices, which then weld exactly.
+void StitchTiles(const std::vector<std::string> &tile_paths,
+                 int32_t width,
+                 int32_t height,
+                 int32_t tiles_x,
+                 int32_t tiles_y,
+                 std::vector<glm::vec3> *points,
+                 std::vector<glm::ivec3> *triangles);
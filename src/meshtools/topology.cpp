@@ -0,0 +1,231 @@
+#include "topology.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+
+namespace {
+
+// Half-edges written per scan of the triangles while scattering, 16 MB.
+constexpr uint64_t kScatterRangeKeys = 1 << 21;
+
+// The next boundary half-edge after boundary half-edge h, found by turning
+// around h's target through the triangles there, or -1 if that runs into a
+// non-manifold edge.
+int32_t NextBoundaryHalfEdge(const HalfEdgeMesh &mesh, const std::vector<glm::ivec3> &triangles, const int32_t h) {
+  const uint64_t vertex = static_cast<uint64_t>(HalfEdgeTarget(triangles, h));
+  uint64_t steps = mesh.vertex_offsets[vertex + 1] - mesh.vertex_offsets[vertex];
+  int32_t edge = NextHalfEdge(h);
+  while (steps-- > 0) {
+    const int32_t twin = mesh.twins[static_cast<uint64_t>(edge)];
+    if (twin == HalfEdgeMesh::kBoundary) {
+      return edge;
+    }
+    if (twin == HalfEdgeMesh::kNonManifold) {
+      return -1;
+    }
+    edge = NextHalfEdge(twin);
+  }
+  return -1;
+}
+
+}  // namespace
+
+HalfEdgeMesh BuildHalfEdges(const uint64_t num_points, const std::vector<glm::ivec3> &triangles) {
+  const ScopedStage stage("build_half_edges");
+  const uint64_t num_half_edges = 3 * triangles.size();
+  if (num_half_edges > INT32_MAX) {
+    fprintf(stderr, "Too many triangles for half-edges: %zu\n", triangles.size());
+    std::exit(1);
+  }
+  HalfEdgeMesh mesh;
+
+  // Counting sort by origin.
+  {
+    std::vector<std::atomic<uint32_t>> counts(num_points);
+    ParallelFor(triangles.size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+      for (uint64_t t = begin; t < end; t++) {
+        for (int k = 0; k < 3; k++) {
+          assert(triangles[t][k] >= 0 && static_cast<uint64_t>(triangles[t][k]) < num_points);
+          counts[static_cast<uint64_t>(triangles[t][k])].fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    });
+    mesh.vertex_offsets.resize(num_points + 1);
+    mesh.vertex_offsets[0] = 0;
+    for (uint64_t v = 0; v < num_points; v++) {
+      mesh.vertex_offsets[v + 1] = mesh.vertex_offsets[v] + counts[v].load(std::memory_order_relaxed);
+    }
+  }
+
+  // Keys carry the target in the high half, so sorting a vertex's keys
+  // orders its half-edges by target and nothing below touches the triangles
+  // again. Writing them straight to their slots is a cache and TLB miss per
+  // half-edge when neighbouring triangles are far apart in the array, so the
+  // half-edges are first radix partitioned by ranges of vertices whose keys
+  // fit in cache, and each range then scatters only its own partition.
+  std::vector<uint64_t> range_starts = {0};
+  for (uint64_t v = 0; v < num_points; v++) {
+    if (mesh.vertex_offsets[v + 1] - mesh.vertex_offsets[range_starts.back()] > kScatterRangeKeys) {
+      range_starts.push_back(v + 1);
+    }
+  }
+  if (range_starts.back() != num_points) {
+    range_starts.push_back(num_points);
+  }
+  const uint64_t num_ranges = range_starts.size() - 1;
+  auto range_of = [&range_starts](const int32_t vertex) {
+    return static_cast<uint64_t>(std::upper_bound(range_starts.begin(), range_starts.end(),
+                                                  static_cast<uint64_t>(vertex)) -
+                                 range_starts.begin()) - 1;
+  };
+
+  // Partition r holds the half-edges leaving range r, chunk by chunk, so
+  // within it they are in increasing order.
+  const uint32_t num_chunks = static_cast<uint32_t>(
+      std::max<uint64_t>(1, std::min<uint64_t>(NumThreads(), triangles.size() >> 16)));
+  std::vector<uint64_t> partition_offsets(num_ranges * num_chunks + 1, 0);
+  ParallelForChunks(triangles.size(), num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    std::vector<uint64_t> counts(num_ranges, 0);
+    for (uint64_t t = begin; t < end; t++) {
+      for (int k = 0; k < 3; k++) {
+        counts[range_of(triangles[t][k])]++;
+      }
+    }
+    for (uint64_t range = 0; range < num_ranges; range++) {
+      partition_offsets[range * num_chunks + chunk + 1] = counts[range];
+    }
+  });
+  for (uint64_t i = 1; i < partition_offsets.size(); i++) {
+    partition_offsets[i] += partition_offsets[i - 1];
+  }
+  std::vector<int32_t> partitioned(num_half_edges);
+  ParallelForChunks(triangles.size(), num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    std::vector<uint64_t> cursors(num_ranges);
+    for (uint64_t range = 0; range < num_ranges; range++) {
+      cursors[range] = partition_offsets[range * num_chunks + chunk];
+    }
+    for (uint64_t t = begin; t < end; t++) {
+      for (int k = 0; k < 3; k++) {
+        partitioned[cursors[range_of(triangles[t][k])]++] = static_cast<int32_t>(3 * t + static_cast<uint64_t>(k));
+      }
+    }
+  });
+
+  std::vector<uint64_t> keys(num_half_edges);
+  ParallelForChunks(num_ranges, static_cast<uint32_t>(std::min<uint64_t>(num_ranges, NumThreads())),
+                    [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    std::vector<uint64_t> cursors;
+    for (uint64_t range = begin; range < end; range++) {
+      const uint64_t first = range_starts[range];
+      cursors.assign(mesh.vertex_offsets.begin() + static_cast<int64_t>(first),
+                     mesh.vertex_offsets.begin() + static_cast<int64_t>(range_starts[range + 1]));
+      for (uint64_t i = partition_offsets[range * num_chunks]; i < partition_offsets[(range + 1) * num_chunks]; i++) {
+        const int32_t h = partitioned[i];
+        const uint64_t v = static_cast<uint64_t>(HalfEdgeOrigin(triangles, h)) - first;
+        keys[cursors[v]++] = static_cast<uint64_t>(HalfEdgeTarget(triangles, h)) << 32 | static_cast<uint64_t>(h);
+      }
+    }
+  });
+  partitioned = std::vector<int32_t>();
+  ParallelFor(num_points, 1 << 14, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t v = begin; v < end; v++) {
+      std::sort(keys.begin() + static_cast<int64_t>(mesh.vertex_offsets[v]),
+                keys.begin() + static_cast<int64_t>(mesh.vertex_offsets[v + 1]));
+    }
+  });
+
+  // An edge a -> b is manifold if it is the only half-edge from a to b and
+  // there is exactly one from b to a, both found by a short search.
+  mesh.twins.resize(num_half_edges);
+  mesh.outgoing.resize(num_half_edges);
+  std::vector<uint64_t> num_boundary(NumThreads(), 0);
+  std::vector<uint64_t> num_non_manifold(NumThreads(), 0);
+  std::vector<uint64_t> num_flipped(NumThreads(), 0);
+  ParallelFor(num_points, 1 << 14, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    for (uint64_t v = begin; v < end; v++) {
+      const uint64_t *first = keys.data() + mesh.vertex_offsets[v];
+      const uint64_t *last = keys.data() + mesh.vertex_offsets[v + 1];
+      for (const uint64_t *run = first; run != last;) {
+        const uint64_t target = *run >> 32;
+        const uint64_t *run_end = run + 1;
+        while (run_end != last && *run_end >> 32 == target) {
+          run_end++;
+        }
+        int32_t twin = HalfEdgeMesh::kNonManifold;
+        if (target != v) {
+          const uint64_t *back_first = keys.data() + mesh.vertex_offsets[target];
+          const uint64_t *back_last = keys.data() + mesh.vertex_offsets[target + 1];
+          const uint64_t *back = std::lower_bound(back_first, back_last, v << 32);
+          const uint64_t *back_end = back;
+          while (back_end != back_last && *back_end >> 32 == v) {
+            back_end++;
+          }
+          if (run_end - run == 1 && back_end == back) {
+            twin = HalfEdgeMesh::kBoundary;
+          } else if (run_end - run == 1 && back_end - back == 1) {
+            twin = static_cast<int32_t>(*back & 0xffffffff);
+          } else if (run_end - run == 2 && back_end == back) {
+            num_flipped[chunk] += 2;
+          }
+        }
+        if (twin == HalfEdgeMesh::kBoundary) {
+          num_boundary[chunk]++;
+        } else if (twin == HalfEdgeMesh::kNonManifold) {
+          num_non_manifold[chunk] += static_cast<uint64_t>(run_end - run);
+        }
+        for (; run != run_end; run++) {
+          const int32_t h = static_cast<int32_t>(*run & 0xffffffff);
+          mesh.twins[static_cast<uint64_t>(h)] = twin;
+          mesh.outgoing[static_cast<uint64_t>(run - keys.data())] = h;
+        }
+      }
+    }
+  });
+  for (uint32_t chunk = 0; chunk < NumThreads(); chunk++) {
+    mesh.num_boundary_half_edges += num_boundary[chunk];
+    mesh.num_non_manifold_half_edges += num_non_manifold[chunk];
+    mesh.num_flipped_half_edges += num_flipped[chunk];
+  }
+  StatsAdd("boundary_half_edges", mesh.num_boundary_half_edges);
+  StatsAdd("non_manifold_half_edges", mesh.num_non_manifold_half_edges);
+  StatsAdd("flipped_half_edges", mesh.num_flipped_half_edges);
+  return mesh;
+}
+
+std::vector<std::vector<int32_t>> BoundaryLoops(const HalfEdgeMesh &mesh, const std::vector<glm::ivec3> &triangles) {
+  const ScopedStage stage("boundary_loops");
+  std::vector<std::vector<int32_t>> loops;
+  std::vector<uint8_t> visited(mesh.twins.size(), 0);
+  for (uint64_t start = 0; start < mesh.twins.size(); start++) {
+    if (mesh.twins[start] != HalfEdgeMesh::kBoundary || visited[start]) {
+      continue;
+    }
+    std::vector<int32_t> loop;
+    int32_t h = static_cast<int32_t>(start);
+    bool closed = false;
+    while (true) {
+      visited[static_cast<uint64_t>(h)] = 1;
+      loop.push_back(h);
+      h = NextBoundaryHalfEdge(mesh, triangles, h);
+      if (h == static_cast<int32_t>(start)) {
+        closed = true;
+        break;
+      }
+      if (h < 0 || visited[static_cast<uint64_t>(h)]) {
+        break;
+      }
+    }
+    if (closed) {
+      loops.push_back(std::move(loop));
+    }
+  }
+  StatsAdd("boundary_loops", loops.size());
+  return loops;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Half-edge adjacency for an indexed mesh. Half-edge h = 3 * t + k runs from
+// corner k of triangle t to corner (k + 1) % 3, so next and previous half-edges
+// and their vertices come straight from the triangle array and only twins and
+// the per-vertex index are stored.
+struct HalfEdgeMesh {
+  // Twin of an edge only one triangle uses.
+  static constexpr int32_t kBoundary = -1;
+  // Twin of an edge three or more triangles share, that two triangles share
+  // in the same direction, or that has zero length.
+  static constexpr int32_t kNonManifold = -2;
+
+  // Opposite half-edge of each half-edge, or kBoundary or kNonManifold.
+  std::vector<int32_t> twins;
+  // Half-edges leaving vertex v are outgoing[vertex_offsets[v]] up to
+  // outgoing[vertex_offsets[v + 1]], sorted by target vertex, then index.
+  std::vector<uint64_t> vertex_offsets;
+  std::vector<int32_t> outgoing;
+
+  uint64_t num_boundary_half_edges = 0;
+  uint64_t num_non_manifold_half_edges = 0;
+  // Non-manifold half-edges that are one of two running the same way along
+  // an edge, where one of their triangles is wound the wrong way.
+  uint64_t num_flipped_half_edges = 0;
+};
+
+inline int32_t NextHalfEdge(const int32_t h) { return h % 3 == 2 ? h - 2 : h + 1; }
+inline int32_t PrevHalfEdge(const int32_t h) { return h % 3 == 0 ? h + 2 : h - 1; }
+
+inline int32_t HalfEdgeOrigin(const std::vector<glm::ivec3> &triangles, const int32_t h) {
+  return triangles[static_cast<uint64_t>(h / 3)][h % 3];
+}
+inline int32_t HalfEdgeTarget(const std::vector<glm::ivec3> &triangles, const int32_t h) {
+  return HalfEdgeOrigin(triangles, NextHalfEdge(h));
+}
+
+// Build the half-edges of a welded mesh whose triangles index into
+// `num_points` vertices. Edges are matched by a parallel counting sort of the
+// half-edges by origin vertex and a sort of each vertex's few half-edges by
+// target, rather than by hashing, so the result is independent of the thread
+// count.
+HalfEdgeMesh BuildHalfEdges(uint64_t num_points, const std::vector<glm::ivec3> &triangles);
+
+// Every closed boundary loop as half-edges in order, each starting at its
+// lowest half-edge, in order of that half-edge. Loops follow the triangles'
+// orientation, so the outer boundary of an upward facing surface runs
+// counterclockwise seen from above. Boundary chains that reach a non-manifold
+// edge are left out.
+std::vector<std::vector<int32_t>> BoundaryLoops(const HalfEdgeMesh &mesh, const std::vector<glm::ivec3> &triangles);
@@ -0,0 +1,504 @@
+#include "triangulate.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "src/meshtools/mapped_file.hpp"
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+
+namespace {
+
+constexpr int32_t kNone = -1;
+// Candidate searches over more pixels than this are split into row ranges.
+constexpr int64_t kMinJobPixels = int64_t{1} << 16;
+
+// Twice the signed area of (a, b, c), positive for the triangles built below.
+int64_t Orient(const glm::ivec2 &a, const glm::ivec2 &b, const glm::ivec2 &c) {
+  return static_cast<int64_t>(b.x - c.x) * (a.y - c.y) - static_cast<int64_t>(b.y - c.y) * (a.x - c.x);
+}
+
+// Whether p is strictly inside the circumcircle of (a, b, c). Exact, so flips
+// never create overlapping triangles.
+bool InCircle(const glm::ivec2 &a, const glm::ivec2 &b, const glm::ivec2 &c, const glm::ivec2 &p) {
+  const int64_t dx = a.x - p.x;
+  const int64_t dy = a.y - p.y;
+  const int64_t ex = b.x - p.x;
+  const int64_t ey = b.y - p.y;
+  const int64_t fx = c.x - p.x;
+  const int64_t fy = c.y - p.y;
+  const int64_t ap = dx * dx + dy * dy;
+  const int64_t bp = ex * ex + ey * ey;
+  const int64_t cp = fx * fx + fy * fy;
+  const __int128 det = static_cast<__int128>(dx) * (ey * cp - bp * fy) -
+                       static_cast<__int128>(dy) * (ex * cp - bp * fx) +
+                       static_cast<__int128>(ap) * (ex * fy - ey * fx);
+  return det < 0;
+}
+
+struct Candidate {
+  float error = 0;
+  glm::ivec2 point = glm::ivec2(0);
+};
+
+// Delaunay triangulation of inserted raster pixels, stored as in hmm and
+// delaunator: triangle t has corners 3t..3t+2, and halfedges[e] is the corner
+// of the neighbouring triangle across the edge starting at corner e.
+struct Triangulation {
+  const Heightmap &heightmap;
+  std::vector<glm::ivec2> points;
+  std::vector<int32_t> corners;
+  std::vector<int32_t> halfedges;
+  std::vector<Candidate> candidates;
+  // Max heap of triangles by candidate error, with each triangle's position.
+  std::vector<int32_t> queue;
+  std::vector<int32_t> queue_index;
+  // Triangles created or changed since the last Flush.
+  std::vector<int32_t> pending;
+  std::vector<uint8_t> is_pending;
+
+  explicit Triangulation(const Heightmap &map) : heightmap(map) {
+    const int32_t right = heightmap.width - 1;
+    const int32_t bottom = heightmap.height - 1;
+    const int32_t p0 = AddPoint(glm::ivec2(0, 0));
+    const int32_t p1 = AddPoint(glm::ivec2(right, 0));
+    const int32_t p2 = AddPoint(glm::ivec2(0, bottom));
+    const int32_t p3 = AddPoint(glm::ivec2(right, bottom));
+    const int32_t t0 = AddTriangle(p3, p0, p2, kNone, kNone, kNone, kNone);
+    AddTriangle(p0, p3, p1, t0, kNone, kNone, kNone);
+  }
+
+  uint64_t NumTriangles() const { return corners.size() / 3; }
+
+  int32_t AddPoint(const glm::ivec2 &point) {
+    points.push_back(point);
+    return static_cast<int32_t>(points.size() - 1);
+  }
+
+  // Write triangle (a, b, c) with edge neighbours ab, bc, ca into corner e, or
+  // append it if e is kNone, and link the neighbours back. Returns its first
+  // corner.
+  int32_t AddTriangle(const int32_t a, const int32_t b, const int32_t c, const int32_t ab, const int32_t bc,
+                      const int32_t ca, int32_t e) {
+    if (e == kNone) {
+      e = static_cast<int32_t>(corners.size());
+      corners.insert(corners.end(), {a, b, c});
+      halfedges.insert(halfedges.end(), {ab, bc, ca});
+      candidates.emplace_back();
+      queue_index.push_back(kNone);
+      is_pending.push_back(0);
+    } else {
+      const uint64_t corner = static_cast<uint64_t>(e);
+      corners[corner] = a;
+      corners[corner + 1] = b;
+      corners[corner + 2] = c;
+      halfedges[corner] = ab;
+      halfedges[corner + 1] = bc;
+      halfedges[corner + 2] = ca;
+    }
+    if (ab != kNone) {
+      halfedges[static_cast<uint64_t>(ab)] = e;
+    }
+    if (bc != kNone) {
+      halfedges[static_cast<uint64_t>(bc)] = e + 1;
+    }
+    if (ca != kNone) {
+      halfedges[static_cast<uint64_t>(ca)] = e + 2;
+    }
+    const uint64_t t = static_cast<uint64_t>(e / 3);
+    if (!is_pending[t]) {
+      is_pending[t] = 1;
+      pending.push_back(e / 3);
+    }
+    return e;
+  }
+
+  const glm::ivec2 &PointAt(const int32_t corner) const {
+    return points[static_cast<uint64_t>(corners[static_cast<uint64_t>(corner)])];
+  }
+
+  // Flip the edge starting at corner a if the opposite point of its
+  // neighbour lies in the circumcircle, and recurse on the two edges that
+  // become exposed.
+  void Legalize(const int32_t a) {
+    const int32_t b = halfedges[static_cast<uint64_t>(a)];
+    if (b == kNone) {
+      return;
+    }
+    const int32_t a0 = a - a % 3;
+    const int32_t b0 = b - b % 3;
+    const int32_t al = a0 + (a + 1) % 3;
+    const int32_t ar = a0 + (a + 2) % 3;
+    const int32_t bl = b0 + (b + 2) % 3;
+    const int32_t br = b0 + (b + 1) % 3;
+    if (!InCircle(PointAt(ar), PointAt(a), PointAt(al), PointAt(bl))) {
+      return;
+    }
+    const int32_t p0 = corners[static_cast<uint64_t>(ar)];
+    const int32_t pr = corners[static_cast<uint64_t>(a)];
+    const int32_t pl = corners[static_cast<uint64_t>(al)];
+    const int32_t p1 = corners[static_cast<uint64_t>(bl)];
+    const int32_t hal = halfedges[static_cast<uint64_t>(al)];
+    const int32_t har = halfedges[static_cast<uint64_t>(ar)];
+    const int32_t hbl = halfedges[static_cast<uint64_t>(bl)];
+    const int32_t hbr = halfedges[static_cast<uint64_t>(br)];
+    QueueRemove(a / 3);
+    QueueRemove(b / 3);
+    const int32_t t0 = AddTriangle(p0, p1, pl, kNone, hbl, hal, a0);
+    const int32_t t1 = AddTriangle(p1, p0, pr, t0, har, hbr, b0);
+    Legalize(t0 + 1);
+    Legalize(t1 + 2);
+  }
+
+  // Insert point pn, which lies on the edge starting at corner a.
+  void InsertOnEdge(const int32_t pn, const int32_t a) {
+    const int32_t a0 = a - a % 3;
+    const int32_t al = a0 + (a + 1) % 3;
+    const int32_t ar = a0 + (a + 2) % 3;
+    const int32_t p0 = corners[static_cast<uint64_t>(ar)];
+    const int32_t pr = corners[static_cast<uint64_t>(a)];
+    const int32_t pl = corners[static_cast<uint64_t>(al)];
+    const int32_t hal = halfedges[static_cast<uint64_t>(al)];
+    const int32_t har = halfedges[static_cast<uint64_t>(ar)];
+    const int32_t b = halfedges[static_cast<uint64_t>(a)];
+    if (b == kNone) {
+      const int32_t t0 = AddTriangle(pn, p0, pr, kNone, har, kNone, a0);
+      const int32_t t1 = AddTriangle(p0, pn, pl, t0, kNone, hal, kNone);
+      Legalize(t0 + 1);
+      Legalize(t1 + 2);
+      return;
+    }
+    const int32_t b0 = b - b % 3;
+    const int32_t bl = b0 + (b + 2) % 3;
+    const int32_t br = b0 + (b + 1) % 3;
+    const int32_t p1 = corners[static_cast<uint64_t>(bl)];
+    const int32_t hbl = halfedges[static_cast<uint64_t>(bl)];
+    const int32_t hbr = halfedges[static_cast<uint64_t>(br)];
+    QueueRemove(b / 3);
+    const int32_t t0 = AddTriangle(p0, pr, pn, har, kNone, kNone, a0);
+    const int32_t t1 = AddTriangle(pr, p1, pn, hbr, kNone, t0 + 1, b0);
+    const int32_t t2 = AddTriangle(p1, pl, pn, hbl, kNone, t1 + 1, kNone);
+    const int32_t t3 = AddTriangle(pl, p0, pn, hal, t0 + 2, t2 + 1, kNone);
+    Legalize(t0);
+    Legalize(t1);
+    Legalize(t2);
+    Legalize(t3);
+  }
+
+  // Insert the candidate of triangle t, which must not be queued.
+  void Insert(const int32_t t) {
+    const int32_t e0 = 3 * t;
+    const int32_t e1 = e0 + 1;
+    const int32_t e2 = e0 + 2;
+    const int32_t p0 = corners[static_cast<uint64_t>(e0)];
+    const int32_t p1 = corners[static_cast<uint64_t>(e1)];
+    const int32_t p2 = corners[static_cast<uint64_t>(e2)];
+    const glm::ivec2 a = PointAt(e0);
+    const glm::ivec2 b = PointAt(e1);
+    const glm::ivec2 c = PointAt(e2);
+    const glm::ivec2 p = candidates[static_cast<uint64_t>(t)].point;
+    const int32_t pn = AddPoint(p);
+    if (Orient(a, b, p) == 0) {
+      InsertOnEdge(pn, e0);
+    } else if (Orient(b, c, p) == 0) {
+      InsertOnEdge(pn, e1);
+    } else if (Orient(c, a, p) == 0) {
+      InsertOnEdge(pn, e2);
+    } else {
+      const int32_t h0 = halfedges[static_cast<uint64_t>(e0)];
+      const int32_t h1 = halfedges[static_cast<uint64_t>(e1)];
+      const int32_t h2 = halfedges[static_cast<uint64_t>(e2)];
+      const int32_t t0 = AddTriangle(p0, p1, pn, h0, kNone, kNone, e0);
+      const int32_t t1 = AddTriangle(p1, p2, pn, h1, kNone, t0 + 1, kNone);
+      const int32_t t2 = AddTriangle(p2, p0, pn, h2, t0 + 2, t1 + 1, kNone);
+      Legalize(t0);
+      Legalize(t1);
+      Legalize(t2);
+    }
+  }
+
+  // The worst pixel of triangle t in rows [y_begin, y_end], scanning rows
+  // with forward differenced barycentric weights as hmm does.
+  Candidate Search(const int32_t t, const int32_t y_begin, const int32_t y_end) const {
+    const glm::ivec2 a = PointAt(3 * t);
+    const glm::ivec2 b = PointAt(3 * t + 1);
+    const glm::ivec2 c = PointAt(3 * t + 2);
+    const int32_t min_x = std::min({a.x, b.x, c.x});
+    const int32_t max_x = std::max({a.x, b.x, c.x});
+    const int64_t a01 = b.y - a.y;
+    const int64_t b01 = a.x - b.x;
+    const int64_t a12 = c.y - b.y;
+    const int64_t b12 = b.x - c.x;
+    const int64_t a20 = a.y - c.y;
+    const int64_t b20 = c.x - a.x;
+    const double area = static_cast<double>(Orient(a, b, c));
+    const double z0 = static_cast<double>(heightmap.At(a.x, a.y)) / area;
+    const double z1 = static_cast<double>(heightmap.At(b.x, b.y)) / area;
+    const double z2 = static_cast<double>(heightmap.At(c.x, c.y)) / area;
+
+    Candidate best;
+    int64_t w00 = Orient(b, c, glm::ivec2(min_x, y_begin));
+    int64_t w01 = Orient(c, a, glm::ivec2(min_x, y_begin));
+    int64_t w02 = Orient(a, b, glm::ivec2(min_x, y_begin));
+    for (int32_t y = y_begin; y <= y_end; y++) {
+      // Skip ahead to near the left edge of the triangle.
+      int64_t dx = 0;
+      if (w00 < 0 && a12 != 0) {
+        dx = std::max(dx, -w00 / a12);
+      }
+      if (w01 < 0 && a20 != 0) {
+        dx = std::max(dx, -w01 / a20);
+      }
+      if (w02 < 0 && a01 != 0) {
+        dx = std::max(dx, -w02 / a01);
+      }
+      int64_t w0 = w00 + a12 * dx;
+      int64_t w1 = w01 + a20 * dx;
+      int64_t w2 = w02 + a01 * dx;
+      bool was_inside = false;
+      for (int32_t x = min_x + static_cast<int32_t>(dx); x <= max_x; x++) {
+        if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
+          was_inside = true;
+          const double z = z0 * static_cast<double>(w0) + z1 * static_cast<double>(w1) + z2 * static_cast<double>(w2);
+          const float error = static_cast<float>(std::fabs(z - static_cast<double>(heightmap.At(x, y))));
+          if (error > best.error) {
+            best.error = error;
+            best.point = glm::ivec2(x, y);
+          }
+        } else if (was_inside) {
+          break;
+        }
+        w0 += a12;
+        w1 += a20;
+        w2 += a01;
+      }
+      w00 += b12;
+      w01 += b20;
+      w02 += b01;
+    }
+    return best;
+  }
+
+  // Find the candidate of every pending triangle and queue it.
+  void Flush() {
+    struct Job {
+      int32_t triangle;
+      int32_t y_begin;
+      int32_t y_end;
+    };
+    std::vector<Job> jobs;
+    std::vector<uint64_t> first_job;
+    int64_t total_pixels = 0;
+    for (const int32_t t : pending) {
+      const glm::ivec2 a = PointAt(3 * t);
+      const glm::ivec2 b = PointAt(3 * t + 1);
+      const glm::ivec2 c = PointAt(3 * t + 2);
+      const int32_t min_y = std::min({a.y, b.y, c.y});
+      const int32_t max_y = std::max({a.y, b.y, c.y});
+      const int64_t rows = max_y - min_y + 1;
+      const int64_t pixels = Orient(a, b, c) / 2 + rows;
+      const int64_t pieces = std::min(rows, std::max<int64_t>(1, pixels / kMinJobPixels));
+      first_job.push_back(jobs.size());
+      for (int64_t k = 0; k < pieces; k++) {
+        jobs.push_back({t, min_y + static_cast<int32_t>(rows * k / pieces),
+                        min_y + static_cast<int32_t>(rows * (k + 1) / pieces) - 1});
+      }
+      total_pixels += pixels;
+    }
+    first_job.push_back(jobs.size());
+
+    // Jobs vary a lot in size, so threads take them one at a time.
+    std::vector<Candidate> results(jobs.size());
+    std::atomic<uint64_t> next_job(0);
+    const uint64_t num_chunks = std::min<uint64_t>(
+        {NumThreads(), jobs.size(), 1 + static_cast<uint64_t>(total_pixels / kMinJobPixels)});
+    ParallelForChunks(num_chunks, static_cast<uint32_t>(num_chunks), [&](uint64_t, uint64_t, uint32_t) {
+      for (uint64_t job = next_job++; job < jobs.size(); job = next_job++) {
+        results[job] = Search(jobs[job].triangle, jobs[job].y_begin, jobs[job].y_end);
+      }
+    });
+
+    // Combine row ranges in order, so ties go to the first pixel like a
+    // single scan would.
+    for (uint64_t k = 0; k < pending.size(); k++) {
+      const int32_t t = pending[k];
+      Candidate best = results[first_job[k]];
+      for (uint64_t job = first_job[k] + 1; job < first_job[k + 1]; job++) {
+        if (results[job].error > best.error) {
+          best = results[job];
+        }
+      }
+      // Vertices are exact, whatever rounding says.
+      for (int32_t corner = 3 * t; corner < 3 * t + 3; corner++) {
+        if (best.point == PointAt(corner)) {
+          best.error = 0;
+        }
+      }
+      candidates[static_cast<uint64_t>(t)] = best;
+      is_pending[static_cast<uint64_t>(t)] = 0;
+      QueuePush(t);
+    }
+    pending.clear();
+  }
+
+  float ErrorAt(const uint64_t position) const {
+    return candidates[static_cast<uint64_t>(queue[position])].error;
+  }
+
+  bool QueueLess(const uint64_t i, const uint64_t j) const {
+    // Higher error first, then the older triangle.
+    if (ErrorAt(i) != ErrorAt(j)) {
+      return ErrorAt(i) > ErrorAt(j);
+    }
+    return queue[i] < queue[j];
+  }
+
+  void QueueSwap(const uint64_t i, const uint64_t j) {
+    std::swap(queue[i], queue[j]);
+    queue_index[static_cast<uint64_t>(queue[i])] = static_cast<int32_t>(i);
+    queue_index[static_cast<uint64_t>(queue[j])] = static_cast<int32_t>(j);
+  }
+
+  void QueueUp(uint64_t i) {
+    while (i > 0) {
+      const uint64_t parent = (i - 1) / 2;
+      if (!QueueLess(i, parent)) {
+        break;
+      }
+      QueueSwap(i, parent);
+      i = parent;
+    }
+  }
+
+  void QueueDown(uint64_t i) {
+    while (true) {
+      const uint64_t left = 2 * i + 1;
+      if (left >= queue.size()) {
+        break;
+      }
+      uint64_t child = left;
+      if (left + 1 < queue.size() && QueueLess(left + 1, left)) {
+        child = left + 1;
+      }
+      if (!QueueLess(child, i)) {
+        break;
+      }
+      QueueSwap(i, child);
+      i = child;
+    }
+  }
+
+  void QueuePush(const int32_t t) {
+    queue.push_back(t);
+    queue_index[static_cast<uint64_t>(t)] = static_cast<int32_t>(queue.size() - 1);
+    QueueUp(queue.size() - 1);
+  }
+
+  int32_t QueuePop() {
+    const int32_t t = queue[0];
+    QueueRemove(t);
+    return t;
+  }
+
+  void QueueRemove(const int32_t t) {
+    const int32_t index = queue_index[static_cast<uint64_t>(t)];
+    if (index == kNone) {
+      return;
+    }
+    const uint64_t i = static_cast<uint64_t>(index);
+    const uint64_t last = queue.size() - 1;
+    if (i != last) {
+      QueueSwap(i, last);
+    }
+    queue.pop_back();
+    queue_index[static_cast<uint64_t>(t)] = kNone;
+    if (i != last) {
+      QueueDown(i);
+      QueueUp(i);
+    }
+  }
+};
+
+}  // namespace
+
+Heightmap ReadFloatRaster(const std::string &path, const int32_t width, const int32_t height,
+                          const double min_height, const double max_height) {
+  const ScopedStage stage("read_float_raster");
+  if (width < 2 || height < 2) {
+    fprintf(stderr, "Error: a %dx%d raster is too small to triangulate.\n", width, height);
+    std::exit(1);
+  }
+  const MappedFile file(path);
+  const uint64_t num_pixels = static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+  if (file.size() != num_pixels * sizeof(float)) {
+    fprintf(stderr, "Error: %s has %zu bytes, expected %dx%d float32 pixels.\n", path.c_str(), file.size(), width,
+            height);
+    std::exit(1);
+  }
+
+  Heightmap heightmap;
+  heightmap.width = width;
+  heightmap.height = height;
+  heightmap.data.resize(num_pixels);
+  const double range = max_height - min_height;
+  const double scale = range > 0 ? 1 / range : 0;
+  ParallelFor(num_pixels, 1 << 20, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    float *data = heightmap.data.data();
+    memcpy(data + begin, file.data() + begin * sizeof(float), (end - begin) * sizeof(float));
+    for (uint64_t k = begin; k < end; k++) {
+      const double z = (static_cast<double>(data[k]) - min_height) * scale;
+      // NaN fails both comparisons and becomes 0.
+      data[k] = z < 1 ? (z > 0 ? static_cast<float>(z) : 0.0f) : 1.0f;
+    }
+  });
+  StatsAdd("raster_bytes_read", file.size());
+  return heightmap;
+}
+
+double TriangulateHeightmap(const Heightmap &heightmap,
+                            const TriangulateOptions &options,
+                            std::vector<glm::vec3> *points,
+                            std::vector<glm::ivec3> *triangles) {
+  const ScopedStage stage("triangulate_heightmap");
+  Triangulation triangulation(heightmap);
+  triangulation.Flush();
+
+  auto done = [&]() {
+    return triangulation.queue.empty() ||
+           static_cast<double>(triangulation.ErrorAt(0)) <= options.max_error ||
+           (options.max_triangles > 0 && triangulation.NumTriangles() >= options.max_triangles) ||
+           (options.max_points > 0 && triangulation.points.size() >= options.max_points);
+  };
+  uint64_t rounds = 0;
+  while (!done()) {
+    const uint64_t batch = 1 + triangulation.NumTriangles() / 64;
+    for (uint64_t k = 0; k < batch && !done(); k++) {
+      triangulation.Insert(triangulation.QueuePop());
+    }
+    triangulation.Flush();
+    rounds++;
+  }
+  const double max_error = triangulation.queue.empty() ? 0.0 : static_cast<double>(triangulation.ErrorAt(0));
+
+  // Flipping y to count up from the bottom also makes the triangles face +z.
+  points->resize(triangulation.points.size());
+  for (uint64_t k = 0; k < points->size(); k++) {
+    const glm::ivec2 &point = triangulation.points[k];
+    (*points)[k] = glm::vec3(static_cast<float>(point.x), static_cast<float>(heightmap.height - 1 - point.y),
+                             heightmap.At(point.x, point.y));
+  }
+  triangles->resize(triangulation.NumTriangles());
+  for (uint64_t t = 0; t < triangles->size(); t++) {
+    (*triangles)[t] = glm::ivec3(triangulation.corners[3 * t], triangulation.corners[3 * t + 1],
+                                 triangulation.corners[3 * t + 2]);
+  }
+
+  StatsAdd("triangulation_rounds", rounds);
+  StatsAdd("triangulated_points", points->size());
+  StatsSet("triangulation_max_error", max_error);
+  return max_error;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// A raster of heights normalized to [0, 1], row by row from the top left.
+struct Heightmap {
+  int32_t width = 0;
+  int32_t height = 0;
+  std::vector<float> data;
+
+  float At(const int32_t x, const int32_t y) const {
+    return data[static_cast<uint64_t>(y) * static_cast<uint64_t>(width) + static_cast<uint64_t>(x)];
+  }
+};
+
+// Read a headerless native-endian float32 raster, e.g. from
+// `gdal_translate -of ENVI -ot Float32`, and map [min_height, max_height] to
+// [0, 1]. Heights outside that range, like nodata, are clamped as
+// `gdal_translate -scale` clamps them. Exits if the file size does not match.
+Heightmap ReadFloatRaster(const std::string &path, int32_t width, int32_t height, double min_height,
+                          double max_height);
+
+struct TriangulateOptions {
+  // Stop once the largest error is at most this, in normalized height.
+  double max_error = 0.001;
+  // Stop at this many triangles or points. 0 means no limit.
+  uint64_t max_triangles = 0;
+  uint64_t max_points = 0;
+};
+
+// Triangulate a heightmap by greedy insertion, like hmm: start with two
+// triangles covering the raster, then repeatedly insert the pixel with the
+// largest vertical error and restore the Delaunay property by edge flips.
+// Returns the largest remaining error.
+//
+// Each round inserts the worst candidates of the triangles queued at the start
+// of the round, up to 1/64 of the triangle count, then rasterizes every new
+// triangle in parallel to find its worst pixel. Rounds only depend on the
+// triangle count, so the result does not depend on the number of threads.
+//
+// Output is in hmm's unscaled coordinates: x is the column, y counts rows up
+// from the bottom and z is the normalized height. Triangles face +z. Replaces
+// `points` and `triangles`.
+double TriangulateHeightmap(const Heightmap &heightmap,
+                            const TriangulateOptions &options,
+                            std::vector<glm::vec3> *points,
+                            std::vector<glm::ivec3> *triangles);
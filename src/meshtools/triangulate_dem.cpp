@@ -0,0 +1,58 @@
+#include <cstdio>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/mesh_io.hpp"
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/terrain.hpp"
+#include "src/meshtools/triangulate.hpp"
+
+// Triangulate a float32 raster into an unscaled mesh in hmm's coordinates,
+// without going through a 16-bit PNG. Heights are normalized with the
+// computedMin/computedMax of the gdalinfo JSON, so the output scaling tools
+// treat the mesh exactly like hmm output. --max_error is in normalized
+// height, like hmm's -e, and defaults to 0.001.
+// Usage: ./triangulate_dem raster.f32 gdalinfo.json output [--triangles=N] [--points=N] [--max_error=E]
+int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  // Parse flags.
+  if (argc < 4 || argc > 7) {
+    fprintf(stderr, "Usage: ./triangulate_dem raster.f32 gdalinfo.json output "
+                    "[--triangles=N] [--points=N] [--max_error=E]\n");
+    std::exit(1);
+  }
+  const std::string raster_path = argv[1];
+  const std::string gdalinfo_path = argv[2];
+  const std::string output_path = argv[3];
+  TriangulateOptions options;
+  for (int32_t k = 4; k < argc; k++) {
+    const std::string arg = argv[k];
+    if (arg.rfind("--triangles=", 0) == 0) {
+      options.max_triangles = std::stoull(arg.substr(12));
+    } else if (arg.rfind("--points=", 0) == 0) {
+      options.max_points = std::stoull(arg.substr(9));
+    } else if (arg.rfind("--max_error=", 0) == 0) {
+      options.max_error = std::stod(arg.substr(12));
+    } else {
+      fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+      std::exit(1);
+    }
+  }
+
+  // Read inputs.
+  const GdalInfo info = ReadGdalInfo(gdalinfo_path);
+  const Heightmap heightmap = ReadFloatRaster(raster_path, info.width, info.height, info.computed_min.AsDouble(),
+                                              info.computed_max.AsDouble());
+
+  std::vector<glm::vec3> vertices;
+  std::vector<glm::ivec3> triangles;
+  const double max_error = TriangulateHeightmap(heightmap, options, &vertices, &triangles);
+  std::cerr << "Triangulated " << info.width << "x" << info.height << " pixels into " << vertices.size()
+            << " vertices and " << triangles.size() << " triangles, max error " << max_error << "." << std::endl;
+
+  // Write outputs.
+  WriteMeshFile(output_path, vertices, triangles);
+}
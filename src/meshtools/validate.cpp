@@ -0,0 +1,141 @@
+#include "validate.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/topology.hpp"
+
+namespace {
+
+void Merge(const MeshCheck &from, MeshCheck *into) {
+  into->count += from.count;
+  into->first = into->first < 0 ? from.first : into->first;
+}
+
+glm::ivec3 SortedCorners(const glm::ivec3 &triangle) {
+  int32_t a = triangle[0];
+  int32_t b = triangle[1];
+  int32_t c = triangle[2];
+  if (a > b) std::swap(a, b);
+  if (b > c) std::swap(b, c);
+  if (a > b) std::swap(a, b);
+  return glm::ivec3(a, b, c);
+}
+
+void PrintCheck(const char *name, const MeshCheck &check) {
+  if (check.count == 0) {
+    fprintf(stderr, "%s: 0\n", name);
+  } else {
+    fprintf(stderr, "%s: %llu, first %lld\n", name, static_cast<unsigned long long>(check.count),
+            static_cast<long long>(check.first));
+  }
+}
+
+}  // namespace
+
+bool MeshReport::Valid(const bool require_closed) const {
+  return non_finite_points.count == 0 && out_of_range_triangles.count == 0 && degenerate_triangles.count == 0 &&
+         zero_area_triangles.count == 0 && duplicate_triangles.count == 0 && edges_checked &&
+         non_manifold_half_edges == 0 && (!require_closed || boundary_half_edges == 0);
+}
+
+MeshReport ValidateMesh(const std::vector<glm::vec3> &points, const std::vector<glm::ivec3> &triangles) {
+  const ScopedStage stage("validate_mesh");
+  MeshReport report;
+  report.num_points = points.size();
+  report.num_triangles = triangles.size();
+
+  // Each chunk fills its own report, merged in chunk order so the first
+  // failures are the lowest indices.
+  std::vector<MeshReport> chunks(NumThreads());
+  ParallelFor(points.size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    for (uint64_t i = begin; i < end; i++) {
+      const glm::vec3 &point = points[i];
+      if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) {
+        chunks[chunk].non_finite_points.Add(i);
+      }
+    }
+  });
+  const uint64_t num_points = points.size();
+  ParallelFor(triangles.size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    for (uint64_t t = begin; t < end; t++) {
+      const glm::ivec3 &triangle = triangles[t];
+      if (triangle[0] < 0 || triangle[1] < 0 || triangle[2] < 0 ||
+          static_cast<uint64_t>(triangle[0]) >= num_points || static_cast<uint64_t>(triangle[1]) >= num_points ||
+          static_cast<uint64_t>(triangle[2]) >= num_points) {
+        chunks[chunk].out_of_range_triangles.Add(t);
+        continue;
+      }
+      if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) {
+        chunks[chunk].degenerate_triangles.Add(t);
+        continue;
+      }
+      // In double, so thin but valid triangles don't round to zero area.
+      const glm::dvec3 a(points[static_cast<uint64_t>(triangle[0])]);
+      const glm::dvec3 b(points[static_cast<uint64_t>(triangle[1])]);
+      const glm::dvec3 c(points[static_cast<uint64_t>(triangle[2])]);
+      const glm::dvec3 normal = glm::cross(b - a, c - a);
+      if (normal.x == 0 && normal.y == 0 && normal.z == 0) {
+        chunks[chunk].zero_area_triangles.Add(t);
+      }
+    }
+  });
+
+  if (std::all_of(chunks.begin(), chunks.end(),
+                  [](const MeshReport &chunk) { return chunk.out_of_range_triangles.count == 0; })) {
+    const HalfEdgeMesh half_edges = BuildHalfEdges(points.size(), triangles);
+    report.edges_checked = true;
+    report.boundary_half_edges = half_edges.num_boundary_half_edges;
+    report.non_manifold_half_edges = half_edges.num_non_manifold_half_edges;
+    report.flipped_half_edges = half_edges.num_flipped_half_edges;
+
+    // A duplicate shares its lowest vertex with the earlier triangle, so
+    // only the triangles around that vertex need comparing.
+    ParallelFor(triangles.size(), 1 << 16, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+      for (uint64_t t = begin; t < end; t++) {
+        const glm::ivec3 corners = SortedCorners(triangles[t]);
+        if (corners[0] == corners[1] || corners[1] == corners[2]) {
+          continue;
+        }
+        const uint64_t v = static_cast<uint64_t>(corners[0]);
+        for (uint64_t i = half_edges.vertex_offsets[v]; i < half_edges.vertex_offsets[v + 1]; i++) {
+          const uint64_t other = static_cast<uint64_t>(half_edges.outgoing[i] / 3);
+          if (other < t && SortedCorners(triangles[other]) == corners) {
+            chunks[chunk].duplicate_triangles.Add(t);
+            break;
+          }
+        }
+      }
+    });
+  }
+
+  for (const MeshReport &chunk : chunks) {
+    Merge(chunk.non_finite_points, &report.non_finite_points);
+    Merge(chunk.out_of_range_triangles, &report.out_of_range_triangles);
+    Merge(chunk.degenerate_triangles, &report.degenerate_triangles);
+    Merge(chunk.zero_area_triangles, &report.zero_area_triangles);
+    Merge(chunk.duplicate_triangles, &report.duplicate_triangles);
+  }
+  return report;
+}
+
+void PrintMeshReport(const MeshReport &report) {
+  fprintf(stderr, "points: %llu\n", static_cast<unsigned long long>(report.num_points));
+  fprintf(stderr, "triangles: %llu\n", static_cast<unsigned long long>(report.num_triangles));
+  PrintCheck("non-finite points", report.non_finite_points);
+  PrintCheck("out of range triangles", report.out_of_range_triangles);
+  PrintCheck("degenerate triangles", report.degenerate_triangles);
+  PrintCheck("zero area triangles", report.zero_area_triangles);
+  PrintCheck("duplicate triangles", report.duplicate_triangles);
+  if (report.edges_checked) {
+    fprintf(stderr, "boundary half-edges: %llu\n", static_cast<unsigned long long>(report.boundary_half_edges));
+    fprintf(stderr, "non-manifold half-edges: %llu, %llu of them flipped\n",
+            static_cast<unsigned long long>(report.non_manifold_half_edges),
+            static_cast<unsigned long long>(report.flipped_half_edges));
+  } else {
+    fprintf(stderr, "edges: not checked, some indices are out of range\n");
+  }
+}
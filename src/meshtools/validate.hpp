@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Failures of one kind, and the first point or triangle with it, or -1.
+struct MeshCheck {
+  uint64_t count = 0;
+  int64_t first = -1;
+
+  void Add(uint64_t index) {
+    count++;
+    first = first < 0 ? static_cast<int64_t>(index) : first;
+  }
+};
+
+struct MeshReport {
+  uint64_t num_points = 0;
+  uint64_t num_triangles = 0;
+
+  // Points with a NaN or infinite coordinate.
+  MeshCheck non_finite_points;
+  // Triangles with an index outside the points.
+  MeshCheck out_of_range_triangles;
+  // Triangles using the same vertex twice.
+  MeshCheck degenerate_triangles;
+  // Triangles of three distinct but collinear or coincident points.
+  MeshCheck zero_area_triangles;
+  // Triangles with the same vertices as an earlier one, in either winding.
+  MeshCheck duplicate_triangles;
+
+  // Edge checks need every index in range, so they are skipped otherwise.
+  bool edges_checked = false;
+  uint64_t boundary_half_edges = 0;
+  // Includes the flipped half-edges and the zero length edges of
+  // degenerate triangles.
+  uint64_t non_manifold_half_edges = 0;
+  uint64_t flipped_half_edges = 0;
+
+  // Whether nothing failed. Boundary edges are allowed unless the mesh
+  // should be closed, since height surfaces are open until solidified.
+  bool Valid(bool require_closed) const;
+};
+
+// Check a mesh in parallel passes linear in its size.
+MeshReport ValidateMesh(const std::vector<glm::vec3> &points, const std::vector<glm::ivec3> &triangles);
+
+// Print one line per check to stderr.
+void PrintMeshReport(const MeshReport &report);
@@ -0,0 +1,87 @@
+#include <cstdio>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "src/meshtools/hash.hpp"
+#include "src/meshtools/mapped_file.hpp"
+#include "src/meshtools/mesh_format.hpp"
+#include "src/meshtools/mesh_io.hpp"
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/validate.hpp"
+
+// Check a mesh for NaN or infinite coordinates, out of range indices,
+// degenerate, zero area and duplicate triangles, and non-manifold or flipped
+// edges. --closed also fails on boundary edges, for solids. --roundtrip
+// writes the mesh to the given path, reads it back and checks the content
+// hash matches, and if the path has the input's extension, that the files
+// are byte for byte identical.
+// Usage: ./validate_mesh input [--closed] [--roundtrip=path]
+int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  // Parse flags.
+  if (argc < 2 || argc > 4) {
+    fprintf(stderr, "Usage: ./validate_mesh input [--closed] [--roundtrip=path]\n");
+    std::exit(1);
+  }
+  const std::string input_path = argv[1];
+  bool require_closed = false;
+  std::string roundtrip_path;
+  for (int32_t k = 2; k < argc; k++) {
+    const std::string arg = argv[k];
+    if (arg == "--closed") {
+      require_closed = true;
+    } else if (arg.rfind("--roundtrip=", 0) == 0) {
+      roundtrip_path = arg.substr(12);
+    } else {
+      fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+      std::exit(1);
+    }
+  }
+
+  std::vector<glm::vec3> points;
+  std::vector<glm::ivec3> triangles;
+  ReadMeshFile(input_path, points, triangles);
+  const MeshReport report = ValidateMesh(points, triangles);
+  PrintMeshReport(report);
+  bool valid = report.Valid(require_closed);
+  if (require_closed && report.boundary_half_edges > 0) {
+    fprintf(stderr, "The mesh should be closed but has boundary edges.\n");
+  }
+
+  if (!roundtrip_path.empty()) {
+    WriteMeshFile(roundtrip_path, points, triangles);
+    std::vector<glm::vec3> new_points;
+    std::vector<glm::ivec3> new_triangles;
+    ReadMeshFile(roundtrip_path, new_points, new_triangles);
+    const uint64_t hash = MeshContentHash(points.data(), points.size(), triangles.data(), triangles.size());
+    const uint64_t new_hash =
+        MeshContentHash(new_points.data(), new_points.size(), new_triangles.data(), new_triangles.size());
+    fprintf(stderr, "roundtrip content hash: %016llx, read back %016llx\n", static_cast<unsigned long long>(hash),
+            static_cast<unsigned long long>(new_hash));
+    valid = valid && hash == new_hash;
+
+    // Everything but .mesh and .ply is STL, as in ReadMeshFile.
+    const auto format_of = [](const std::string &path) {
+      return HasExtension(path, ".mesh") ? MeshFormat::kMesh
+             : HasExtension(path, ".ply") ? MeshFormat::kPly
+                                          : MeshFormat::kStl;
+    };
+    if (format_of(input_path) == format_of(roundtrip_path)) {
+      const MappedFile input(input_path);
+      const MappedFile output(roundtrip_path);
+      const uint64_t file_hash = ParallelHashBytes(input.data(), input.size());
+      const uint64_t new_file_hash = ParallelHashBytes(output.data(), output.size());
+      fprintf(stderr, "roundtrip file hash: %016llx (%zu bytes), written %016llx (%zu bytes)\n",
+              static_cast<unsigned long long>(file_hash), input.size(),
+              static_cast<unsigned long long>(new_file_hash), output.size());
+      valid = valid && input.size() == output.size() && file_hash == new_file_hash;
+    }
+  }
+
+  fprintf(stderr, "%s is %s.\n", input_path.c_str(), valid ? "valid" : "NOT valid");
+  if (!valid) {
+    std::exit(1);
+  }
+}
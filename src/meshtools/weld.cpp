@@ -0,0 +1,435 @@
+#include "weld.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+#include "src/meshtools/grid.hpp"
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/radix_sort.hpp"
+#include "src/meshtools/stats.hpp"
+
+namespace {
+
+// Float bits used as the exact weld key. 0.0 and -0.0 compare equal, so they
+// must share a key.
+inline uint32_t KeyBits(const float f) {
+  if (f == 0.0f) {
+    return 0;
+  }
+  uint32_t bits;
+  memcpy(&bits, &f, 4);
+  return bits;
+}
+
+inline bool HasNan(const glm::vec3 &point) {
+  return std::isnan(point.x) || std::isnan(point.y) || std::isnan(point.z);
+}
+
+inline uint64_t HashKey(const uint32_t key[3]) {
+  uint64_t h = (static_cast<uint64_t>(key[0]) | static_cast<uint64_t>(key[1]) << 32) * 0x9e3779b97f4a7c15ull;
+  h ^= (static_cast<uint64_t>(key[2]) + (h >> 29)) * 0xc2b2ae3d27d4eb4full;
+  h ^= h >> 32;
+  h *= 0xd6e8feb86659fd93ull;
+  h ^= h >> 32;
+  return h;
+}
+
+// Append a welded vertex index per corner as triangles.
+void AppendTriangles(const std::vector<int32_t> &corner_indices, std::vector<glm::ivec3> *triangles) {
+  const uint64_t num_triangles = corner_indices.size() / 3;
+  const uint64_t offset = triangles->size();
+  triangles->resize(offset + num_triangles);
+  glm::ivec3 *out = triangles->data() + offset;
+  ParallelFor(num_triangles, 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t t = begin; t < end; t++) {
+      out[t] = {corner_indices[3 * t], corner_indices[3 * t + 1], corner_indices[3 * t + 2]};
+    }
+  });
+}
+
+// Exact float keys, for any mesh.
+struct FloatKeys {
+  using Table = VertexTable;
+  const CornerView &corners;
+
+  glm::vec3 Key(const uint64_t corner) const { return corners.Corner(corner); }
+  static uint64_t Hash(const glm::vec3 &point) {
+    const uint32_t key[3] = {KeyBits(point.x), KeyBits(point.y), KeyBits(point.z)};
+    return HashKey(key);
+  }
+};
+
+// Packed 64 bit keys, for corners that DetectGridLayout accepted.
+struct GridKeys {
+  using Table = GridVertexTable;
+  const CornerView &corners;
+  GridKeyLayout layout;
+
+  uint64_t Key(const uint64_t corner) const { return layout.Pack(corners.Corner(corner)); }
+  static uint64_t Hash(const uint64_t key) { return GridHash(key); }
+};
+
+template <typename Keys>
+void WeldHashTable(const Keys &keys, std::vector<glm::vec3> *points, std::vector<glm::ivec3> *triangles) {
+  const CornerView &corners = keys.corners;
+  // A heightmap mesh has about half as many vertices as triangles.
+  typename Keys::Table table(corners.num_triangles / 2);
+  triangles->reserve(triangles->size() + corners.num_triangles);
+  for (uint64_t t = 0; t < corners.num_triangles; t++) {
+    int32_t indices[3];
+    for (uint64_t k = 0; k < 3; k++) {
+      const glm::vec3 point = corners.Corner(3 * t + k);
+      bool inserted = false;
+      indices[k] = table.FindOrInsert(keys.Key(3 * t + k), static_cast<int32_t>(points->size()), &inserted);
+      if (inserted) {
+        points->push_back(point);
+      }
+    }
+    triangles->push_back({indices[0], indices[1], indices[2]});
+  }
+  StatsSet("weld_table_load_factor", table.LoadFactor());
+}
+
+struct SortEntry {
+  static constexpr uint32_t kKeyDigits = 6;
+  uint32_t key[3];
+  uint32_t corner;
+
+  // The 96 bit key is key[0] key[1] key[2], most significant first.
+  uint32_t Digit(const uint32_t pass) const {
+    const uint32_t word = key[2 - pass / 2];
+    return (pass % 2 == 0) ? (word & 0xffff) : (word >> 16);
+  }
+};
+
+void WeldSort(const CornerView &corners, std::vector<glm::vec3> *points, std::vector<glm::ivec3> *triangles) {
+  const uint64_t num_corners = corners.NumCorners();
+  std::vector<SortEntry> entries(num_corners);
+  ParallelFor(num_corners, 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t c = begin; c < end; c++) {
+      const glm::vec3 point = corners.Corner(c);
+      SortEntry &entry = entries[c];
+      entry.corner = static_cast<uint32_t>(c);
+      if (HasNan(point)) {
+        // No finite float has these bits, so each NaN corner gets its own run.
+        entry.key[0] = 0xffffffff;
+        entry.key[1] = 0xffffffff;
+        entry.key[2] = static_cast<uint32_t>(c);
+      } else {
+        entry.key[0] = KeyBits(point.x);
+        entry.key[1] = KeyBits(point.y);
+        entry.key[2] = KeyBits(point.z);
+      }
+    }
+  });
+  RadixSortByKey(&entries);
+
+  // The sort is stable, so the first entry of each run of equal keys is the
+  // first-seen corner of that vertex.
+  std::vector<int32_t> leader(num_corners);
+  for (uint64_t begin = 0; begin < num_corners;) {
+    uint64_t end = begin + 1;
+    while (end < num_corners && memcmp(entries[end].key, entries[begin].key, 12) == 0) {
+      end++;
+    }
+    for (uint64_t i = begin; i < end; i++) {
+      leader[entries[i].corner] = static_cast<int32_t>(entries[begin].corner);
+    }
+    begin = end;
+  }
+  entries.clear();
+  entries.shrink_to_fit();
+
+  // Number vertices in first-seen order. A leader always precedes the corners
+  // that reference it, so its slot already holds the vertex index.
+  int32_t next_index = static_cast<int32_t>(points->size());
+  for (uint64_t c = 0; c < num_corners; c++) {
+    if (leader[c] == static_cast<int32_t>(c)) {
+      points->push_back(corners.Corner(c));
+      leader[c] = next_index++;
+    } else {
+      leader[c] = leader[static_cast<uint64_t>(leader[c])];
+    }
+  }
+  AppendTriangles(leader, triangles);
+}
+
+template <typename Keys>
+void WeldParallel(const Keys &keys, std::vector<glm::vec3> *points, std::vector<glm::ivec3> *triangles) {
+  const CornerView &corners = keys.corners;
+  const uint64_t num_corners = corners.NumCorners();
+  const uint32_t num_shards = std::min(NumThreads(), 255u);
+
+  // Phase 1: assign every corner to a shard by hash, and bucket the corners
+  // by shard with a counting sort. Bucket s holds shard s's corners chunk by
+  // chunk, so within it they are in increasing order.
+  const uint32_t num_chunks = NumThreads();
+  std::vector<uint8_t> shard_of(num_corners);
+  std::vector<uint64_t> bucket_offsets(num_shards * num_chunks + 1, 0);
+  ParallelForChunks(num_corners, num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    std::vector<uint64_t> counts(num_shards, 0);
+    for (uint64_t c = begin; c < end; c++) {
+      const uint8_t shard = static_cast<uint8_t>(((Keys::Hash(keys.Key(c)) >> 32) * num_shards) >> 32);
+      shard_of[c] = shard;
+      counts[shard]++;
+    }
+    for (uint32_t shard = 0; shard < num_shards; shard++) {
+      bucket_offsets[shard * num_chunks + chunk + 1] = counts[shard];
+    }
+  });
+  for (uint64_t i = 1; i < bucket_offsets.size(); i++) {
+    bucket_offsets[i] += bucket_offsets[i - 1];
+  }
+  std::vector<int32_t> bucketed(num_corners);
+  ParallelForChunks(num_corners, num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    std::vector<uint64_t> cursors(num_shards);
+    for (uint32_t shard = 0; shard < num_shards; shard++) {
+      cursors[shard] = bucket_offsets[shard * num_chunks + chunk];
+    }
+    for (uint64_t c = begin; c < end; c++) {
+      bucketed[cursors[shard_of[c]]++] = static_cast<int32_t>(c);
+    }
+  });
+  shard_of = std::vector<uint8_t>();
+
+  // Phase 2: each shard welds its own corners in corner order, which maps
+  // every corner to the first-seen corner with the same position.
+  std::vector<int32_t> leader(num_corners);
+  std::vector<double> load_factors(num_shards);
+  ParallelForChunks(num_shards, num_shards, [&](uint64_t, uint64_t, const uint32_t shard) {
+    typename Keys::Table table(corners.num_triangles / 2 / num_shards);
+    for (uint64_t i = bucket_offsets[shard * num_chunks]; i < bucket_offsets[(shard + 1) * num_chunks]; i++) {
+      const uint64_t c = static_cast<uint64_t>(bucketed[i]);
+      bool inserted = false;
+      leader[c] = table.FindOrInsert(keys.Key(c), static_cast<int32_t>(c), &inserted);
+    }
+    load_factors[shard] = table.LoadFactor();
+  });
+  StatsSet("weld_table_load_factor", *std::max_element(load_factors.begin(), load_factors.end()));
+  bucketed = std::vector<int32_t>();
+
+  // Phase 3: rank the first-seen corners with a chunked prefix sum.
+  std::vector<int32_t> chunk_counts(num_chunks + 1, 0);
+  ParallelForChunks(num_corners, num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    int32_t count = 0;
+    for (uint64_t c = begin; c < end; c++) {
+      count += (leader[c] == static_cast<int32_t>(c));
+    }
+    chunk_counts[chunk + 1] = count;
+  });
+  const int32_t first_index = static_cast<int32_t>(points->size());
+  chunk_counts[0] = first_index;
+  for (uint32_t chunk = 0; chunk < num_chunks; chunk++) {
+    chunk_counts[chunk + 1] += chunk_counts[chunk];
+  }
+  points->resize(static_cast<uint64_t>(chunk_counts[num_chunks]));
+
+  std::vector<int32_t> vertex_of(num_corners);
+  ParallelForChunks(num_corners, num_chunks, [&](const uint64_t begin, const uint64_t end, const uint32_t chunk) {
+    int32_t next_index = chunk_counts[chunk];
+    for (uint64_t c = begin; c < end; c++) {
+      if (leader[c] == static_cast<int32_t>(c)) {
+        (*points)[static_cast<uint64_t>(next_index)] = corners.Corner(c);
+        vertex_of[c] = next_index++;
+      }
+    }
+  });
+
+  // Phase 4: resolve every corner through its leader.
+  ParallelFor(num_corners, 1 << 16, [&](const uint64_t begin, const uint64_t end, uint32_t) {
+    for (uint64_t c = begin; c < end; c++) {
+      leader[c] = vertex_of[static_cast<uint64_t>(leader[c])];
+    }
+  });
+  AppendTriangles(leader, triangles);
+}
+
+}  // namespace
+
+VertexTable::VertexTable(const uint64_t expected_size) {
+  uint64_t capacity = 16;
+  while (capacity < 2 * expected_size) {
+    capacity *= 2;
+  }
+  slots_.assign(capacity, Slot{{0, 0, 0}, -1});
+  mask_ = capacity - 1;
+}
+
+void VertexTable::Grow() {
+  std::vector<Slot> old_slots(2 * slots_.size(), Slot{{0, 0, 0}, -1});
+  old_slots.swap(slots_);
+  mask_ = slots_.size() - 1;
+  for (const Slot &slot : old_slots) {
+    if (slot.index < 0) {
+      continue;
+    }
+    uint64_t i = HashKey(slot.key) & mask_;
+    while (slots_[i].index >= 0) {
+      i = (i + 1) & mask_;
+    }
+    slots_[i] = slot;
+  }
+}
+
+int32_t VertexTable::FindOrInsert(const glm::vec3 &point, const int32_t index, bool *inserted) {
+  // NaN never compares equal, so it is never welded.
+  if (HasNan(point)) {
+    *inserted = true;
+    return index;
+  }
+  const uint32_t key[3] = {KeyBits(point.x), KeyBits(point.y), KeyBits(point.z)};
+  return *FindOrInsertKey(key, index, inserted);
+}
+
+int32_t *VertexTable::FindOrInsertKey(const uint32_t key[3], const int32_t index, bool *inserted) {
+  uint64_t i = HashKey(key) & mask_;
+  while (slots_[i].index >= 0) {
+    if (slots_[i].key[0] == key[0] && slots_[i].key[1] == key[1] && slots_[i].key[2] == key[2]) {
+      *inserted = false;
+      return &slots_[i].index;
+    }
+    i = (i + 1) & mask_;
+  }
+  // Keep the load factor at or below 1/2 so probe sequences stay short.
+  if (2 * (size_ + 1) > slots_.size()) {
+    Grow();
+    i = HashKey(key) & mask_;
+    while (slots_[i].index >= 0) {
+      i = (i + 1) & mask_;
+    }
+  }
+  slots_[i] = Slot{{key[0], key[1], key[2]}, index};
+  size_++;
+  *inserted = true;
+  return &slots_[i].index;
+}
+
+const int32_t *VertexTable::FindKey(const uint32_t key[3]) const {
+  uint64_t i = HashKey(key) & mask_;
+  while (slots_[i].index >= 0) {
+    if (slots_[i].key[0] == key[0] && slots_[i].key[1] == key[1] && slots_[i].key[2] == key[2]) {
+      return &slots_[i].index;
+    }
+    i = (i + 1) & mask_;
+  }
+  return nullptr;
+}
+
+void WeldVertices(const CornerView &corners,
+                  const WeldMethod method,
+                  std::vector<glm::vec3> *points,
+                  std::vector<glm::ivec3> *triangles) {
+  const ScopedStage stage("weld");
+  const uint64_t first_vertex = points->size();
+  // The sort and parallel welders number corners with int32.
+  const bool fits_int32 = corners.NumCorners() <= static_cast<uint64_t>(std::numeric_limits<int32_t>::max());
+  const bool parallel = fits_int32 && NumThreads() > 1 && corners.num_triangles >= (1 << 16);
+  GridKeyLayout layout;
+  if (method == WeldMethod::kGrid && DetectGridLayout(corners, &layout)) {
+    const GridKeys keys{corners, layout};
+    if (parallel) {
+      WeldParallel(keys, points, triangles);
+    } else {
+      WeldHashTable(keys, points, triangles);
+    }
+    StatsAdd("grid_weld_corners", corners.NumCorners());
+  } else if (method == WeldMethod::kSort && fits_int32) {
+    WeldSort(corners, points, triangles);
+  } else if ((method == WeldMethod::kParallel || method == WeldMethod::kGrid) && parallel) {
+    WeldParallel(FloatKeys{corners}, points, triangles);
+  } else {
+    WeldHashTable(FloatKeys{corners}, points, triangles);
+  }
+  StatsAdd("weld_corners", corners.NumCorners());
+  StatsAdd("unique_vertices", points->size() - first_vertex);
+}
+
+void WeldVerticesWithTolerance(const CornerView &corners,
+                               const float epsilon,
+                               std::vector<glm::vec3> *points,
+                               std::vector<glm::ivec3> *triangles) {
+  if (!(epsilon > 0.0f)) {
+    fprintf(stderr, "Weld tolerance must be positive, got %f.\n", static_cast<double>(epsilon));
+    std::exit(1);
+  }
+  const ScopedStage stage("weld_with_tolerance");
+  // Cells are 2 * epsilon wide, so along each axis a point within epsilon is
+  // either in the same cell or the neighbor on the nearer side: 8 lookups.
+  const float inv_cell = 0.5f / epsilon;
+  const float epsilon2 = epsilon * epsilon;
+  // Cells are clamped to the largest floats inside int32 less one, so the
+  // cast and the neighbor offset stay in range for any coordinate and
+  // epsilon. Far out cells merge, which only costs extra distance checks.
+  auto cell = [inv_cell](const float x, const int32_t dx) {
+    constexpr float kMaxCell = 2147483520.0f;
+    return static_cast<uint32_t>(
+        static_cast<int32_t>(std::fmin(std::fmax(std::floor(x * inv_cell), -kMaxCell), kMaxCell)) + dx);
+  };
+  auto cell_of = [&cell](const glm::vec3 &point, const int32_t dx, const int32_t dy, const int32_t dz) {
+    return std::array<uint32_t, 3>{cell(point.x, dx), cell(point.y, dy), cell(point.z, dz)};
+  };
+  auto nearer_side = [inv_cell](const float x) {
+    const float scaled = x * inv_cell;
+    return (scaled - std::floor(scaled) < 0.5f) ? -1 : 1;
+  };
+
+  // Each grid cell maps to the newest vertex inside it, older ones are
+  // chained through `next_in_cell`.
+  VertexTable cell_heads(corners.num_triangles / 2);
+  std::vector<int32_t> next_in_cell;
+  const uint64_t first_vertex = points->size();
+  next_in_cell.reserve(corners.num_triangles / 2);
+  triangles->reserve(triangles->size() + corners.num_triangles);
+
+  for (uint64_t t = 0; t < corners.num_triangles; t++) {
+    int32_t indices[3];
+    for (uint64_t k = 0; k < 3; k++) {
+      const glm::vec3 point = corners.Corner(3 * t + k);
+      const bool has_nan = HasNan(point);
+
+      // Closest match is not required, just the first-seen one in range.
+      int32_t match = -1;
+      const int32_t sx = has_nan ? 0 : nearer_side(point.x);
+      const int32_t sy = has_nan ? 0 : nearer_side(point.y);
+      const int32_t sz = has_nan ? 0 : nearer_side(point.z);
+      for (int32_t ix = 0; ix < 2 && !has_nan; ix++) {
+        for (int32_t iy = 0; iy < 2; iy++) {
+          for (int32_t iz = 0; iz < 2; iz++) {
+            const int32_t *head = cell_heads.FindKey(cell_of(point, ix * sx, iy * sy, iz * sz).data());
+            for (int32_t v = head ? *head : -1; v >= 0; v = next_in_cell[static_cast<uint64_t>(v) - first_vertex]) {
+              const glm::vec3 delta = (*points)[static_cast<uint64_t>(v)] - point;
+              if (glm::dot(delta, delta) <= epsilon2 && (match < 0 || v < match)) {
+                match = v;
+              }
+            }
+          }
+        }
+      }
+      if (match >= 0) {
+        indices[k] = match;
+        continue;
+      }
+
+      const int32_t new_index = static_cast<int32_t>(points->size());
+      indices[k] = new_index;
+      points->push_back(point);
+      next_in_cell.push_back(-1);
+      if (!has_nan) {
+        bool inserted = false;
+        int32_t *head = cell_heads.FindOrInsertKey(cell_of(point, 0, 0, 0).data(), new_index, &inserted);
+        if (!inserted) {
+          next_in_cell.back() = *head;
+          *head = new_index;
+        }
+      }
+    }
+    triangles->push_back({indices[0], indices[1], indices[2]});
+  }
+  StatsAdd("weld_corners", corners.NumCorners());
+  StatsAdd("unique_vertices", points->size() - first_vertex);
+  StatsSet("weld_table_load_factor", cell_heads.LoadFactor());
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Read-only view of triangle corner positions in memory. Corner k of triangle
+// t lives at base + t * triangle_stride + 12 * k, which covers both the 50 byte
+// records of a binary STL and a plain array of 3 * num_triangles glm::vec3.
+struct CornerView {
+  const uint8_t *base = nullptr;
+  uint64_t num_triangles = 0;
+  uint64_t triangle_stride = 36;
+
+  uint64_t NumCorners() const { return 3 * num_triangles; }
+  glm::vec3 Corner(const uint64_t corner) const {
+    glm::vec3 point;
+    memcpy(&point, base + (corner / 3) * triangle_stride + 12 * (corner % 3), 12);
+    return point;
+  }
+};
+
+enum class WeldMethod {
+  // Serial open-addressing table keyed on the raw float bits.
+  kHashTable,
+  // Radix sort of packed (key, corner) pairs, then a first-seen ranking.
+  kSort,
+  // Hash-sharded tables, one per thread. Falls back to kHashTable for small
+  // inputs or a single thread.
+  kParallel,
+  // kParallel on packed 64 bit keys, for unscaled heightmap meshes, see
+  // grid.hpp. Checks the corners first and falls back to kParallel if they
+  // are not on a grid.
+  kGrid,
+};
+
+// Exact vertex welding. Corners whose coordinates compare equal (so 0.0 and
+// -0.0 weld, NaN never does) share one vertex. Unique vertices are appended to
+// `points` in first-seen order and each triangle is appended to `triangles`.
+// Every method produces identical output.
+void WeldVertices(const CornerView &corners,
+                  WeldMethod method,
+                  std::vector<glm::vec3> *points,
+                  std::vector<glm::ivec3> *triangles);
+
+// Tolerance welding for meshes that went through a float transform. A corner
+// joins the first-seen vertex within `epsilon` (euclidean) of it, found with a
+// uniform grid of 2 * `epsilon` sized cells. Output is appended as above.
+void WeldVerticesWithTolerance(const CornerView &corners,
+                               float epsilon,
+                               std::vector<glm::vec3> *points,
+                               std::vector<glm::ivec3> *triangles);
+
+// Open-addressing hash table from exact vertex position to vertex index, used
+// by the welders. Exposed for tools that weld incrementally.
+class VertexTable {
+ public:
+  explicit VertexTable(uint64_t expected_size = 0);
+
+  // Return the index of `point`, inserting it with `index` if it is new.
+  // `inserted` is set to whether the point was new.
+  int32_t FindOrInsert(const glm::vec3 &point, int32_t index, bool *inserted);
+
+  // Same as above on a raw 96 bit key, returning the stored index so the
+  // caller may update it. The pointer is valid until the next insertion.
+  int32_t *FindOrInsertKey(const uint32_t key[3], int32_t index, bool *inserted);
+
+  // Stored index for a raw key, or nullptr if absent.
+  const int32_t *FindKey(const uint32_t key[3]) const;
+
+  uint64_t size() const { return size_; }
+  uint64_t capacity() const { return slots_.size(); }
+  double LoadFactor() const { return slots_.empty() ? 0.0 : static_cast<double>(size_) / static_cast<double>(slots_.size()); }
+
+ private:
+  struct Slot {
+    uint32_t key[3];
+    int32_t index;
+  };
+  void Grow();
+
+  std::vector<Slot> slots_;
+  uint64_t mask_ = 0;
+  uint64_t size_ = 0;
+};
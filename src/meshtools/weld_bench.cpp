@@ -0,0 +1,174 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <glm/glm.hpp>
+#include <random>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "src/meshtools/hash.hpp"
+#include "src/meshtools/mapped_file.hpp"
+#include "src/meshtools/parallel.hpp"
+#include "src/meshtools/stats.hpp"
+#include "src/meshtools/stl.hpp"
+#include "src/meshtools/weld.hpp"
+
+// Compare vertex welders on an STL file or a synthetic heightmap mesh.
+// Every welder runs in its own forked process so peak RSS is measured per
+// method. Usage: ./weld_bench (input.stl | --synthetic num_triangles)
+
+// Read a "VmXXX:   1234 kB" line from /proc/self/status, in bytes.
+static uint64_t ReadProcStatus(const std::string &field) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind(field + ":", 0) == 0) {
+      return 1024 * std::stoull(line.substr(field.size() + 1));
+    }
+  }
+  return 0;
+}
+
+// Reset the peak RSS high water mark to the current RSS.
+static void ResetPeakRss() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+}
+
+// Grid heightmap with shuffled triangles, like hmm output.
+static std::vector<glm::vec3> SyntheticCorners(const uint64_t num_triangles) {
+  const uint64_t n = static_cast<uint64_t>(std::sqrt(static_cast<double>(num_triangles / 2))) + 1;
+  std::mt19937_64 rng(0);
+  std::uniform_real_distribution<float> height(0.0f, 1.0f);
+  std::vector<float> heights(n * n);
+  for (float &h : heights) {
+    h = height(rng);
+  }
+  auto vertex = [&](const uint64_t x, const uint64_t y) {
+    return glm::vec3(static_cast<float>(x), static_cast<float>(y), heights[y * n + x]);
+  };
+  std::vector<glm::vec3> corners;
+  corners.reserve(6 * (n - 1) * (n - 1));
+  for (uint64_t y = 0; y + 1 < n; y++) {
+    for (uint64_t x = 0; x + 1 < n; x++) {
+      corners.insert(corners.end(), {vertex(x, y), vertex(x + 1, y), vertex(x + 1, y + 1)});
+      corners.insert(corners.end(), {vertex(x, y), vertex(x + 1, y + 1), vertex(x, y + 1)});
+    }
+  }
+  const uint64_t num_generated = corners.size() / 3;
+  for (uint64_t t = num_generated - 1; t > 0; t--) {
+    const uint64_t other = rng() % (t + 1);
+    for (uint64_t k = 0; k < 3; k++) {
+      std::swap(corners[3 * t + k], corners[3 * other + k]);
+    }
+  }
+  return corners;
+}
+
+// The welder ReadBinarySTL used before the flat table.
+static void WeldUnorderedMap(const CornerView &corners,
+                             std::vector<glm::vec3> *points,
+                             std::vector<glm::ivec3> *triangles) {
+  std::unordered_map<glm::vec3, int32_t> point_map;
+  // A heightmap mesh has about half as many vertices as triangles.
+  point_map.reserve(corners.num_triangles / 2);
+  for (uint64_t t = 0; t < corners.num_triangles; t++) {
+    int32_t point_indices[3];
+    for (uint64_t k = 0; k < 3; k++) {
+      const glm::vec3 point = corners.Corner(3 * t + k);
+      if (point_map.find(point) != point_map.end()) {
+        point_indices[k] = point_map.at(point);
+      } else {
+        const int32_t new_index = static_cast<int32_t>(points->size());
+        point_indices[k] = new_index;
+        points->push_back(point);
+        point_map.insert({point, new_index});
+      }
+    }
+    triangles->push_back({point_indices[0], point_indices[1], point_indices[2]});
+  }
+}
+
+static uint64_t Fnv1a(const void *data, const uint64_t size, uint64_t hash) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (uint64_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+struct Method {
+  const char *name;
+  void (*weld)(const CornerView &, std::vector<glm::vec3> *, std::vector<glm::ivec3> *);
+};
+
+int32_t main(int32_t argc, char *argv[]) {
+  InitStats(&argc, argv);
+  if (argc != 2 && !(argc == 3 && std::string(argv[1]) == "--synthetic")) {
+    fprintf(stderr, "Usage: ./weld_bench (input.stl | --synthetic num_triangles)\n");
+    std::exit(1);
+  }
+
+  std::vector<glm::vec3> synthetic;
+  std::unique_ptr<MappedFile> file;
+  CornerView corners;
+  if (argc == 3) {
+    synthetic = SyntheticCorners(std::stoull(argv[2]));
+    corners.base = reinterpret_cast<const uint8_t *>(synthetic.data());
+    corners.num_triangles = synthetic.size() / 3;
+  } else {
+    file = std::make_unique<MappedFile>(argv[1]);
+    corners = ParseBinaryStl(file->data(), file->size()).Corners();
+  }
+
+  const Method methods[] = {
+      {"unordered_map", WeldUnorderedMap},
+      {"hash_table", [](const CornerView &c, std::vector<glm::vec3> *p, std::vector<glm::ivec3> *t) {
+         WeldVertices(c, WeldMethod::kHashTable, p, t);
+       }},
+      {"sort", [](const CornerView &c, std::vector<glm::vec3> *p, std::vector<glm::ivec3> *t) {
+         WeldVertices(c, WeldMethod::kSort, p, t);
+       }},
+      {"parallel", [](const CornerView &c, std::vector<glm::vec3> *p, std::vector<glm::ivec3> *t) {
+         WeldVertices(c, WeldMethod::kParallel, p, t);
+       }},
+      {"grid", [](const CornerView &c, std::vector<glm::vec3> *p, std::vector<glm::ivec3> *t) {
+         WeldVertices(c, WeldMethod::kGrid, p, t);
+       }},
+      {"tolerance_1e-4", [](const CornerView &c, std::vector<glm::vec3> *p, std::vector<glm::ivec3> *t) {
+         WeldVerticesWithTolerance(c, 1e-4f, p, t);
+       }},
+  };
+
+  printf("%llu triangles, %u threads\n", static_cast<unsigned long long>(corners.num_triangles), NumThreads());
+  printf("%-16s %10s %12s %14s %18s\n", "method", "seconds", "Mtri/s", "peak RSS MB", "output hash");
+  for (const Method &method : methods) {
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid == 0) {
+      ResetPeakRss();
+      const uint64_t rss_before = ReadProcStatus("VmRSS");
+      const auto start = std::chrono::steady_clock::now();
+      std::vector<glm::vec3> points;
+      std::vector<glm::ivec3> triangles;
+      method.weld(corners, &points, &triangles);
+      const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      const uint64_t peak_rss = ReadProcStatus("VmHWM") - rss_before;
+      uint64_t hash = Fnv1a(points.data(), points.size() * sizeof(glm::vec3), 0xcbf29ce484222325ull);
+      hash = Fnv1a(triangles.data(), triangles.size() * sizeof(glm::ivec3), hash);
+      printf("%-16s %10.3f %12.2f %14.1f %18llx\n", method.name, seconds,
+             static_cast<double>(corners.num_triangles) / seconds * 1e-6,
+             static_cast<double>(peak_rss) / (1024.0 * 1024.0), static_cast<unsigned long long>(hash));
+      fflush(stdout);
+      std::_Exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+  }
+}
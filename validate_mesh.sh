@@ -0,0 +1,16 @@
+#!/usr/bin/env bash
+
+set -e
+
+# command line args, anything after the mesh is passed on, e.g. --closed
+validate_mesh_binary=$1
+test_mesh=$2
+shift 2
+
+# temporary mesh for roundtripping
+tmp_output_mesh=$TEST_TMPDIR/mesh.stl
+
+# check the mesh for defects and that writing it back out gives the same file
+$validate_mesh_binary $test_mesh --roundtrip=$tmp_output_mesh "$@"
+
+echo "Mesh validation finished with no errors."